@@ -0,0 +1,75 @@
+/// \file
+///
+/// Neighbor-sweep benchmark of trees with 64-bit and 32-bit node indices
+///
+/// Usage: benchmark.hm3.tree.neighbor_sweep [level] [no_sweeps]
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <hm3/tree/algorithm/dfs_sort.hpp>
+#include <hm3/tree/algorithm/node_level.hpp>
+#include <hm3/tree/algorithm/node_neighbors.hpp>
+#include <hm3/tree/tree.hpp>
+#include <hm3/utility/fmt.hpp>
+
+using namespace hm3;
+using namespace hm3::tree;
+
+template <uint_t Nd, typename Idx>
+using tree_t = hm3::tree::tree<Nd, Idx>;
+
+/// Tree uniformly refined up to \p level (depth-first order)
+template <uint_t Nd, typename Idx>
+tree_t<Nd, Idx> uniform_tree(uint_t level) {
+  tree_t<Nd, Idx> t(no_nodes_until_uniform_level(Nd, level));
+  RANGES_FOR (auto&& n, t.nodes() | t.leaf()) {
+    if (node_level(t, n) < level) { t.refine(n); }
+  }
+  dfs_sort(t);
+  return t;
+}
+
+/// Sweeps over all neighbors of all nodes of the tree \p t \p no_sweeps times
+///
+/// \returns (checksum of the neighbor indices, time in seconds)
+template <typename Tree>
+std::pair<idx_t, double> neighbor_sweep(Tree const& t, uint_t no_sweeps) {
+  idx_t checksum = 0;
+  auto start     = std::chrono::steady_clock::now();
+  for (uint_t i = 0; i != no_sweeps; ++i) {
+    RANGES_FOR (auto&& n, t.nodes()) {
+      for (auto&& m : node_neighbors(t, n)) { checksum += *m; }
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  return {checksum, std::chrono::duration<double>(end - start).count()};
+}
+
+/// Memory footprint of the tree \p t in bytes
+template <typename Tree> uint_t memory(Tree const& t) {
+  using stored_t = typename Tree::stored_node_idx;
+  return sizeof(stored_t) * (*t.capacity() + *t.sibling_group_capacity());
+}
+
+int main(int argc, char* argv[]) {
+  const uint_t level     = argc > 1 ? std::atoi(argv[1]) : 6;
+  const uint_t no_sweeps = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  auto a = uniform_tree<3, idx_t>(level);
+  auto b = uniform_tree<3, std::uint32_t>(level);
+
+  auto r64 = neighbor_sweep(a, no_sweeps);
+  auto r32 = neighbor_sweep(b, no_sweeps);
+  if (r64.first != r32.first) {
+    fmt::print("error: the neighbors of both trees differ\n");
+    return 1;
+  }
+
+  fmt::print("neighbor sweep (3D, level {}, {} nodes, {} sweeps):\n", level,
+             a.size(), no_sweeps);
+  fmt::print("  64-bit indices: {} bytes, {} s\n", memory(a), r64.second);
+  fmt::print("  32-bit indices: {} bytes, {} s\n", memory(b), r32.second);
+  fmt::print("  speed-up: {}\n", r64.second / r32.second);
+  return 0;
+}
@@ -16,6 +16,7 @@ option(HM3_ENABLE_RESTRICT "Enables restrict hint (HM3_RESTRICT macro)." ON)
 option(HM3_ENABLE_WERROR "Fail and stop if a warning is triggered." OFF)
 option(HM3_ENABLE_PARAVIEW_PLUGINS "Builds ParaView plugins." ON)
 option(HM3_ENABLE_VTK "Builds with VTK libraries." OFF)
+option(HM3_ENABLE_OPENMP "Enables OpenMP parallel algorithms." OFF)
 option(HM3_VERBOSE_CONFIGURE "Prints helpful debug information about CMake scripts." OFF)
 
 # Enable verbose configure when passing -Wdev to CMake
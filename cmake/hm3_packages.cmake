@@ -53,6 +53,12 @@ set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${MPI_COMPILE_FLAGS}")
 set(CMAKE_CXX_LINK_FLAGS "${CMAKE_CXX_LINK_FLAGS} ${MPI_LINK_FLAGS}")
 include_directories(SYSTEM ${MPI_INCLUDE_PATH})
 
+# OpenMP:
+if (HM3_ENABLE_OPENMP)
+  find_package(OpenMP REQUIRED)
+  set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${OpenMP_CXX_FLAGS}")
+endif()
+
 # Boost:
 set(Boost_USE_STATIC_LIBS OFF)
 find_package(Boost REQUIRED)
@@ -131,5 +137,11 @@ if(HM3_VERBOSE_CONFIGURE)
   else()
     message(" * VTK: disabled")
   endif()
+  if (HM3_ENABLE_OPENMP)
+    message(" * OpenMP: enabled")
+    message("   - flags: ${OpenMP_CXX_FLAGS}")
+  else()
+    message(" * OpenMP: disabled")
+  endif()
   message(" * HM3_LIBS: ${HM3_LIBS}")
 endif()
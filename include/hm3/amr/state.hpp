@@ -202,6 +202,9 @@ template <typename Target> struct state {
   }
 
   /// Applies the refinement and coarsening to the target's grid
+  ///
+  /// The nodes to coarsen and to refine are collected and passed to the
+  /// target at once (see refine_nodes and coarsen_siblings_of_nodes).
   auto apply() {
     struct {
       bool target_changed;
@@ -210,21 +213,26 @@ template <typename Target> struct state {
     } result{false, 0, 0};
 
     // Coarse nodes
+    std::vector<amr_node_idx> nodes;
     for (auto&& n : nodes_ | to_coarsen{}()) {
       // coarse nodes only once
       for_each(siblings(n), [&](auto&& s) { s.action = action::none; });
-
-      // coarsen node to its parent
-      t_.coarsen_siblings_of(n);
-      result.no_nodes_coarsened++;
-      result.target_changed = true;
+      nodes.push_back(n);
+    }
+    if (!nodes.empty()) {
+      // coarsen nodes to their parents
+      coarsen_siblings_of_nodes(t_, nodes);
+      result.no_nodes_coarsened = nodes.size();
+      result.target_changed     = true;
     }
 
     // Refine nodes
-    for (auto&& n : nodes_ | to_refine{}()) {
-      t_.refine(n);
-      result.no_nodes_refined++;
-      result.target_changed = true;
+    nodes.clear();
+    for (auto&& n : nodes_ | to_refine{}()) { nodes.push_back(n); }
+    if (!nodes.empty()) {
+      refine_nodes(t_, nodes);
+      result.no_nodes_refined = nodes.size();
+      result.target_changed   = true;
     }
 
     return result;
@@ -260,6 +268,7 @@ template <typename Target> struct state {
            result.target_changed, no_nodes_before, no_nodes_after,
            result.no_nodes_refined, result.no_nodes_coarsened,
            no_amr_iterations);
+    if (result.target_changed) { after_adapt(t_); }
     return result.target_changed;
   }
 };
@@ -13,5 +13,29 @@ struct non_loggable {
   template <typename... Args> static void log(Args&&...) noexcept {}
 };
 
+/// Called after the target has been adapted (does nothing by default)
+///
+/// Targets can customize it by providing an overload in their namespace.
+template <typename Target> void after_adapt(Target&) noexcept {}
+
+/// Refines the nodes \p ns of the target \p t (one by one by default)
+///
+/// Targets can refine all nodes at once by providing an overload in their
+/// namespace.
+template <typename Target, typename Nodes>
+void refine_nodes(Target& t, Nodes const& ns) {
+  for (auto&& n : ns) { t.refine(n); }
+}
+
+/// Coarsens the siblings of the nodes \p ns of the target \p t (one sibling
+/// group by one by default)
+///
+/// Targets can coarsen all sibling groups at once by providing an overload in
+/// their namespace.
+template <typename Target, typename Nodes>
+void coarsen_siblings_of_nodes(Target& t, Nodes const& ns) {
+  for (auto&& n : ns) { t.coarsen_siblings_of(n); }
+}
+
 }  // namespace amr
 }  // namespace hm3
@@ -0,0 +1,110 @@
+#pragma once
+/// \file
+///
+/// Dense grid membership layout
+#include <hm3/grid/types.hpp>
+#include <hm3/utility/compact_optional.hpp>
+#include <hm3/utility/matrix.hpp>
+
+namespace hm3 {
+namespace grid {
+namespace adaptor {
+
+/// Dense grid membership layout: (tree_node_idx, grid_idx) -> grid_node_idx
+///
+/// Stores a node capacity x grid capacity matrix of grid node indices in
+/// column-major order, that is, one contiguous array of grid node indices per
+/// grid.
+///
+/// Memory requirements: one grid node index per node and grid independently
+/// of the number of nodes in each grid. Best suited for a small number of
+/// grids that cover most of the tree (see sparse_membership otherwise).
+///
+/// The grid node indices are stored using the index type \p Idx.
+template <typename Idx>  //
+struct dense_membership {
+  /// Grid node index as stored in memory
+  using stored_grid_node_idx = grid_node_idx_storage<Idx>;
+  /// Mutable reference to a grid node index
+  using reference
+   = compact_optional_ref_t<grid_node_idx, stored_grid_node_idx>;
+
+  using data_t
+   = dense::matrix<stored_grid_node_idx, dense::dynamic, dense::dynamic,
+                   tree_node_idx, grid_idx, dense::col_major_t>;
+  data_t grids_;
+
+  dense_membership() : grids_(0, 0) {}
+  dense_membership(dense_membership const&) = default;
+  dense_membership(dense_membership&&) = default;
+  dense_membership& operator=(dense_membership const&) = default;
+  dense_membership& operator=(dense_membership&&) = default;
+
+  dense_membership(tree_node_idx node_capacity, grid_idx grid_capacity)
+   : grids_(*node_capacity, *grid_capacity) {}
+
+  /// Number of grids
+  grid_idx no_grids() const noexcept { return grid_idx{grids_().cols()}; }
+
+  /// Index of node \p n within grid \p g
+  grid_node_idx operator()(tree_node_idx n, grid_idx g) const noexcept {
+    return compact_optional_cast<grid_node_idx>(grids_(*n, *g));
+  }
+  /// Index of node \p n within grid \p g
+  reference operator()(tree_node_idx n, grid_idx g) noexcept {
+    return grids_(*n, *g);
+  }
+
+  /// Is node \p n part of grid \p g?
+  bool contains(tree_node_idx n, grid_idx g) const noexcept {
+    return static_cast<bool>(grids_(*n, *g));
+  }
+
+  /// Is node \p n part of no grid?
+  ///
+  /// Time complexity: O(no_grids)
+  bool empty(tree_node_idx n) const noexcept {
+    for (idx_t g = 0, e = *no_grids(); g != e; ++g) {
+      if (grids_(*n, g)) { return false; }
+    }
+    return true;
+  }
+
+  /// Swaps the grid node indices of the nodes \p a and \p b
+  ///
+  /// Time complexity: O(no_grids) (strided memory accesses)
+  void swap(tree_node_idx a, tree_node_idx b) noexcept {
+    grids_.row(a).swap(grids_.row(b));
+  }
+
+  /// Contiguous array of the grid node indices of grid \p g
+  stored_grid_node_idx const* column(grid_idx g) const noexcept {
+    return &grids_(0_n, g);
+  }
+
+  /// Memory used by the first \p no_nodes nodes (bytes)
+  uint_t memory_used(tree_node_idx no_nodes) const noexcept {
+    return *no_nodes * *no_grids() * sizeof(stored_grid_node_idx);
+  }
+
+  /// Memory reserved (bytes)
+  uint_t memory_reserved() const noexcept {
+    return grids_().rows() * *no_grids() * sizeof(stored_grid_node_idx);
+  }
+};
+
+template <typename Idx>
+bool operator==(dense_membership<Idx> const& a,
+                dense_membership<Idx> const& b) noexcept {
+  return a.grids_() == b.grids_();
+}
+
+template <typename Idx>
+bool operator!=(dense_membership<Idx> const& a,
+                dense_membership<Idx> const& b) noexcept {
+  return !(a == b);
+}
+
+}  // namespace adaptor
+}  // namespace grid
+}  // namespace hm3
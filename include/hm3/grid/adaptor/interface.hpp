@@ -0,0 +1,298 @@
+#pragma once
+/// \file
+///
+/// Interfaces between the grids of a multi grid
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <hm3/grid/types.hpp>
+#include <hm3/tree/algorithm/node_location.hpp>
+#include <hm3/tree/algorithm/node_neighbors.hpp>
+#include <hm3/tree/relations/neighbor.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/parallel.hpp>
+#include <hm3/utility/range.hpp>
+#include <hm3/utility/stack_vector.hpp>
+
+namespace hm3 {
+namespace grid {
+namespace adaptor {
+
+/// Pairs of nodes of two grids a and b (stored as a structure of arrays)
+struct node_pairs {
+  /// Tree nodes of the pairs in grid a and b
+  std::vector<tree_node_idx> tree_nodes_a, tree_nodes_b;
+  /// Grid nodes of the pairs in grid a and b
+  std::vector<grid_node_idx> grid_nodes_a, grid_nodes_b;
+  /// Rank of the manifold between the nodes: 1 (faces), ..., Nd (corners),
+  /// or 0 if the nodes overlap
+  std::vector<std::uint8_t> manifolds;
+
+  /// Number of pairs
+  idx_t size() const noexcept { return tree_nodes_a.size(); }
+  bool empty() const noexcept { return tree_nodes_a.empty(); }
+
+  void clear() noexcept {
+    tree_nodes_a.clear();
+    tree_nodes_b.clear();
+    grid_nodes_a.clear();
+    grid_nodes_b.clear();
+    manifolds.clear();
+  }
+
+  void push_back(tree_node_idx t_a, tree_node_idx t_b, grid_node_idx g_a,
+                 grid_node_idx g_b, uint_t manifold) {
+    tree_nodes_a.push_back(t_a);
+    tree_nodes_b.push_back(t_b);
+    grid_nodes_a.push_back(g_a);
+    grid_nodes_b.push_back(g_b);
+    manifolds.push_back(static_cast<std::uint8_t>(manifold));
+  }
+
+  /// Appends the pairs \p o
+  void append(node_pairs const& o) {
+    auto app = [](auto& to, auto const& from) {
+      to.insert(end(to), begin(from), end(from));
+    };
+    app(tree_nodes_a, o.tree_nodes_a);
+    app(tree_nodes_b, o.tree_nodes_b);
+    app(grid_nodes_a, o.grid_nodes_a);
+    app(grid_nodes_b, o.grid_nodes_b);
+    app(manifolds, o.manifolds);
+  }
+
+  /// Removes the pairs \p i for which \p pred(i) is true (keeping the order
+  /// of the remaining pairs)
+  template <typename Pred> void remove_if(Pred&& pred) {
+    idx_t j = 0;
+    for (idx_t i = 0, e = size(); i != e; ++i) {
+      if (pred(i)) { continue; }
+      tree_nodes_a[j] = tree_nodes_a[i];
+      tree_nodes_b[j] = tree_nodes_b[i];
+      grid_nodes_a[j] = grid_nodes_a[i];
+      grid_nodes_b[j] = grid_nodes_b[i];
+      manifolds[j]    = manifolds[i];
+      ++j;
+    }
+    tree_nodes_a.resize(j);
+    tree_nodes_b.resize(j);
+    grid_nodes_a.resize(j);
+    grid_nodes_b.resize(j);
+    manifolds.resize(j);
+  }
+};
+
+/// Interface between the grids \p a and \p b of the multi grid \p Multi
+///
+/// Contains:
+/// - adjacent: the pairs of nodes of grid a and grid b that are neighbors
+///   across a manifold (each pair once, across the manifold of lowest rank,
+///   i.e., faces before edges before corners), and
+/// - overlapping: the pairs of nodes of grid a and grid b that overlap (that
+///   is, the same node, or nodes one of which is an ancestor of the other).
+///
+/// It is built in one parallel pass over the nodes of both grids, and updated
+/// incrementally after the grids are adapted (see update).
+///
+/// \warning Sorting the tree changes the tree node indices, the interface must
+/// be rebuilt afterwards.
+template <typename Multi> struct interface {
+  grid_idx a, b;
+  node_pairs adjacent;
+  node_pairs overlapping;
+
+  interface() = default;
+  interface(Multi const& m, grid_idx a_, grid_idx b_) : a(a_), b(b_) {
+    HM3_ASSERT(a != b, "interface of grid {} with itself", a);
+    rebuild(m);
+  }
+
+  /// Rebuilds the interface from scratch
+  ///
+  /// Time complexity: O((size(a) + size(b)) / no_threads * log(N))
+  void rebuild(Multi const& m) {
+    const auto nodes_a = to_vector(m.nodes(a));
+    const auto nodes_b = to_vector(m.nodes(b));
+    adjacent           = pairs(nodes_a, [&](tree_node_idx n, node_pairs& o) {
+      adjacent_nodes(m, n, o);
+    });
+    overlapping = pairs(nodes_a, [&](tree_node_idx n, node_pairs& o) {
+      overlapping_ancestors(m, n, a, true, o);
+    });
+    overlapping.append(pairs(nodes_b, [&](tree_node_idx n, node_pairs& o) {
+      overlapping_ancestors(m, n, b, false, o);
+    }));
+  }
+
+  /// Updates the interface after the \p dirty_nodes of the tree have changed
+  ///
+  /// The dirty nodes are the nodes that have been added to or removed from
+  /// the grids a or b, and the nodes that have been refined or coarsened
+  /// (including the nodes removed from the tree).
+  ///
+  /// The pairs of the dirty nodes and of the nodes of grid a adjacent to them
+  /// are removed and recomputed (and appended).
+  ///
+  /// Time complexity: O(size(interface) + no_dirty_nodes * log(N)).
+  template <typename Rng> void update(Multi const& m, Rng&& dirty_nodes) {
+    auto dirty = to_vector(std::forward<Rng>(dirty_nodes));
+    sort_unique(dirty);
+    auto is_dirty = [&](tree_node_idx n) {
+      return std::binary_search(begin(dirty), end(dirty), n);
+    };
+
+    // Adjacent pairs: the nodes of grid a whose pairs must be recomputed
+    std::vector<tree_node_idx> affected;
+    for (auto&& d : dirty) {
+      if (!m.is_in_use(d)) { continue; }
+      if (m.in_grid(d, a)) { affected.push_back(d); }
+      for (auto&& n : tree::node_neighbors(
+            m, tree::node_location(m, d),
+            [&](tree_node_idx i) { return m.in_grid(i, a); })) {
+        affected.push_back(n);
+      }
+    }
+    for (idx_t i = 0, e = adjacent.size(); i != e; ++i) {
+      if (is_dirty(adjacent.tree_nodes_a[i])
+          or is_dirty(adjacent.tree_nodes_b[i])) {
+        affected.push_back(adjacent.tree_nodes_a[i]);
+      }
+    }
+    sort_unique(affected);
+    adjacent.remove_if([&](idx_t i) {
+      return std::binary_search(begin(affected), end(affected),
+                                adjacent.tree_nodes_a[i]);
+    });
+    affected.erase(std::remove_if(begin(affected), end(affected),
+                                  [&](tree_node_idx n) {
+                                    return !m.is_in_use(n) or !m.in_grid(n, a);
+                                  }),
+                   end(affected));
+    adjacent.append(pairs(affected, [&](tree_node_idx n, node_pairs& o) {
+      adjacent_nodes(m, n, o);
+    }));
+
+    // Overlapping pairs: all pairs containing a dirty node are recomputed
+    overlapping.remove_if([&](idx_t i) {
+      return is_dirty(overlapping.tree_nodes_a[i])
+             or is_dirty(overlapping.tree_nodes_b[i]);
+    });
+    for (auto&& d : dirty) {
+      if (!m.is_in_use(d)) { continue; }
+      if (m.in_grid(d, a)) {
+        overlapping_ancestors(m, d, a, true, overlapping);
+        overlapping_descendants(m, d, a, overlapping, [](tree_node_idx) {
+          return true;
+        });
+      }
+      if (m.in_grid(d, b)) {
+        // the pairs with dirty nodes of grid a have been found above
+        auto not_dirty = [&](tree_node_idx n) { return !is_dirty(n); };
+        overlapping_ancestors(m, d, b, false, overlapping, not_dirty);
+        overlapping_descendants(m, d, b, overlapping, not_dirty);
+      }
+    }
+  }
+
+ private:
+  template <typename Rng> static std::vector<tree_node_idx> to_vector(Rng&& r) {
+    std::vector<tree_node_idx> v;
+    RANGES_FOR (auto&& n, r) { v.push_back(n); }
+    return v;
+  }
+
+  static void sort_unique(std::vector<tree_node_idx>& v) {
+    std::sort(begin(v), end(v));
+    v.erase(std::unique(begin(v), end(v)), end(v));
+  }
+
+  /// Pairs \p f(n, pairs) of the \p nodes computed in parallel
+  template <typename F>
+  static node_pairs pairs(std::vector<tree_node_idx> const& nodes, F&& f) {
+    constexpr idx_t block_size = 1024;
+    const idx_t no_nodes       = nodes.size();
+    const idx_t no_blocks      = (no_nodes + block_size - 1) / block_size;
+    std::vector<node_pairs> block_pairs(no_blocks);
+    parallel::for_each(0, no_blocks, [&](int_t i) {
+      for (idx_t j = i * block_size, e = std::min(j + block_size, no_nodes);
+           j != e; ++j) {
+        f(nodes[j], block_pairs[i]);
+      }
+    });
+    node_pairs result;
+    for (auto&& p : block_pairs) { result.append(p); }
+    return result;
+  }
+
+  /// Appends the pairs of node \p n of grid a with its neighbors in grid b
+  void adjacent_nodes(Multi const& m, tree_node_idx n, node_pairs& o) const {
+    constexpr int nd = Multi::dimension();
+    stack::vector<std::pair<tree_node_idx, uint_t>, tree::max_no_neighbors(nd)>
+     neighbors;
+    const auto loc = tree::node_location(m, n);
+    using manifold_rng = meta::as_list<meta::integer_range<int, 1, nd + 1>>;
+    meta::for_each(manifold_rng{}, [&](auto m_) {
+      using manifold = tree::manifold_neighbors<nd, decltype(m_){}>;
+      for (auto&& i : tree::node_neighbors(
+            manifold{}, m, loc,
+            [&](tree_node_idx j) { return m.in_grid(j, b); })) {
+        neighbors.push_back(std::make_pair(i, uint_t(decltype(m_){})));
+      }
+    });
+    // keep each neighbor once (across its lowest rank manifold):
+    ranges::sort(neighbors);
+    tree_node_idx last{};
+    for (auto&& i : neighbors) {
+      if (i.first == last) { continue; }
+      last = i.first;
+      o.push_back(n, i.first, m.node(n, a), m.node(i.first, b), i.second);
+    }
+  }
+
+  struct always_true {
+    constexpr bool operator()(tree_node_idx) const noexcept { return true; }
+  };
+
+  /// Appends the pairs of node \p n of grid \p g with its ancestors in the
+  /// other grid (including \p n itself if \p inclusive) that satisfy \p pred
+  template <typename Pred = always_true>
+  void overlapping_ancestors(Multi const& m, tree_node_idx n, grid_idx g,
+                             bool inclusive, node_pairs& o,
+                             Pred&& pred = Pred{}) const {
+    const grid_idx other = g == a ? b : a;
+    if (!inclusive and m.is_root(n)) { return; }
+    for (auto p = inclusive ? n : m.parent(n);; p = m.parent(p)) {
+      if (m.in_grid(p, other) and pred(p)) { push_pair(m, n, p, g, o); }
+      if (m.is_root(p)) { break; }
+    }
+  }
+
+  /// Appends the pairs of node \p n of grid \p g with its descendants in the
+  /// other grid that satisfy \p pred
+  template <typename Pred>
+  void overlapping_descendants(Multi const& m, tree_node_idx n, grid_idx g,
+                               node_pairs& o, Pred&& pred) const {
+    const grid_idx other = g == a ? b : a;
+    auto descend = [&](auto&& self, tree_node_idx p) -> void {
+      for (auto&& c : m.children(p)) {
+        if (m.in_grid(c, other) and pred(c)) { push_pair(m, n, c, g, o); }
+        self(self, c);
+      }
+    };
+    descend(descend, n);
+  }
+
+  /// Appends the overlapping pair of node \p n of grid \p g and node \p p of
+  /// the other grid
+  void push_pair(Multi const& m, tree_node_idx n, tree_node_idx p, grid_idx g,
+                 node_pairs& o) const {
+    const auto n_a = g == a ? n : p;
+    const auto n_b = g == a ? p : n;
+    o.push_back(n_a, n_b, m.node(n_a, a), m.node(n_b, b), 0);
+  }
+};
+
+}  // namespace adaptor
+}  // namespace grid
+}  // namespace hm3
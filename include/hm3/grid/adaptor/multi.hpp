@@ -2,14 +2,21 @@
 /// \file
 ///
 /// Adapts a grid to store multiple solver grids inside
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <hm3/grid/adaptor/dense_membership.hpp>
+#include <hm3/grid/adaptor/sparse_membership.hpp>
 #include <hm3/grid/types.hpp>
 #include <hm3/tree/algorithm/balanced_coarsen.hpp>
 #include <hm3/tree/algorithm/balanced_refine.hpp>
 #include <hm3/tree/algorithm/dfs_sort.hpp>
+#include <hm3/tree/algorithm/node_level.hpp>
 #include <hm3/tree/algorithm/node_location.hpp>
 #include <hm3/tree/algorithm/node_neighbors.hpp>
+#include <hm3/tree/algorithm/stats.hpp>
 #include <hm3/utility/assert.hpp>
-#include <hm3/utility/matrix.hpp>
+#include <hm3/utility/parallel.hpp>
 
 namespace hm3 {
 namespace grid {
@@ -17,12 +24,66 @@ namespace grid {
 namespace adaptor {
 
 /// Stores multiple grids inside a tree-like grid
-template <typename TreeGrid>  //
+///
+/// The map (tree_node_idx, grid_idx) -> grid_node_idx is stored using the
+/// layout \p Membership:
+/// - dense_membership (default): one grid node index per node and grid, best
+///   suited for a small number of grids,
+/// - sparse_membership: a grid bitmask per node plus the indices of the grid
+///   nodes only, best suited for many grids that cover a small part of the
+///   tree each.
+///
+/// For each grid, a list of its tree nodes in memory order (depth-first order
+/// if the tree is sorted) is maintained while nodes are added to and removed
+/// from the grid, such that iterating over the nodes of a grid is O(grid
+/// size) instead of O(tree size) (see nodes(g)).
+///
+/// The grid node indices are stored using the index type of the tree grid.
+template <typename TreeGrid,
+          typename Membership
+          = dense_membership<typename TreeGrid::index_type>>  //
 struct multi : TreeGrid {
+  using membership_t = Membership;
+  /// Grid node index as stored in memory
+  using stored_grid_node_idx = typename membership_t::stored_grid_node_idx;
+  /// Tree node index as stored in the node lists
+  using node_list_t = std::vector<typename TreeGrid::index_type>;
+
+  /// Mutable reference to a grid node index
+  ///
+  /// Assigning through it keeps the node lists up-to-date.
+  struct grid_node_ref {
+    multi& m_;
+    tree_node_idx n_;
+    grid_idx g_;
+
+    operator grid_node_idx() const noexcept {
+      return static_cast<multi const&>(m_).node(n_, g_);
+    }
+    explicit operator bool() const noexcept { return m_.in_grid(n_, g_); }
+    idx_t operator*() const noexcept {
+      return *static_cast<grid_node_idx>(*this);
+    }
+    grid_node_ref& operator=(grid_node_idx v) noexcept {
+      m_.set_node(n_, g_, v);
+      return *this;
+    }
+    grid_node_ref& operator=(grid_node_ref const& o) noexcept {
+      return (*this) = static_cast<grid_node_idx>(o);
+    }
+  };
+
   /// Multi grid indices
-  using data_t = dense::matrix<grid_node_idx, dense::dynamic, dense::dynamic,
-                               tree_node_idx, grid_idx, dense::col_major_t>;
-  data_t grids_;
+  membership_t grids_;
+  /// Tree nodes of each grid in memory order
+  std::vector<node_list_t> node_lists_;
+  /// Is the node list of each grid up-to-date?
+  std::vector<bool> has_node_list_;
+  /// Has the node list of each grid pending changes (unsorted nodes or
+  /// removed nodes)?
+  std::vector<bool> has_pending_nodes_;
+  /// Tree nodes removed from each grid that are still in its node list
+  std::vector<node_list_t> removed_nodes_;
 
   using TreeGrid::assert_node_in_use;
   using TreeGrid::nodes;
@@ -31,7 +92,7 @@ struct multi : TreeGrid {
   using TreeGrid::neighbors;
   using TreeGrid::node;
 
-  multi() : grids_(0, 0) {}
+  multi() = default;
   multi(multi const&) = default;
   multi(multi&&) = default;
   multi& operator=(multi const&) = default;
@@ -41,25 +102,36 @@ struct multi : TreeGrid {
   explicit multi(tree_node_idx node_capacity, grid_idx grid_capacity,
                  Args&&... args)
    : TreeGrid(node_capacity, std::forward<Args>(args)...)
-   , grids_(*node_capacity, *grid_capacity) {}
+   , grids_(node_capacity, grid_capacity)
+   , node_lists_(*grid_capacity)
+   , has_node_list_(*grid_capacity, true)
+   , has_pending_nodes_(*grid_capacity, false)
+   , removed_nodes_(*grid_capacity) {}
   explicit multi(grid_idx grid_capacity, TreeGrid tree_grid)
    : TreeGrid(std::move(tree_grid))
-   , grids_(*TreeGrid::capacity(), *grid_capacity) {}
+   , grids_(TreeGrid::capacity(), grid_capacity)
+   , node_lists_(*grid_capacity)
+   , has_node_list_(*grid_capacity, true)
+   , has_pending_nodes_(*grid_capacity, false)
+   , removed_nodes_(*grid_capacity) {}
 
   /// Number of grids
-  inline grid_idx no_grids() const noexcept {
-    return grid_idx{grids_().cols()};
-  }
+  inline grid_idx no_grids() const noexcept { return grids_.no_grids(); }
 
   /// Range of all grid ids.
   inline auto grids() const noexcept {
     return boxed_ints<grid_idx>(0_g, no_grids());
   }
 
+  /// Is node \p n in use (that is, not part of a free sibling group)?
+  inline bool is_in_use(tree_node_idx n) const noexcept {
+    return n and n < TreeGrid::capacity() and !TreeGrid::is_free(n);
+  }
+
   /// How to swap the connectivity between two nodes \p i and \p j
   inline auto data_swap() noexcept {
     return [this](tree_node_idx i, tree_node_idx j) {
-      this->grids_.row(i).swap(this->grids_.row(j));
+      this->grids_.swap(i, j);
     };
   }
 
@@ -70,7 +142,136 @@ struct multi : TreeGrid {
   }
 
   /// Sorts the grid using dfs
-  void sort() noexcept { tree::dfs_sort(*this, data_swap()); }
+  ///
+  /// The node lists are rebuilt in depth-first order.
+  void sort() {
+    tree::dfs_sort(*this, data_swap());
+    invalidate_node_lists();
+    update_node_lists();
+  }
+
+  /// \name Node lists
+  ///
+  /// The node list of a grid is kept up-to-date while nodes are added to the
+  /// grid in memory order (e.g. when pushing the nodes of a sorted tree into
+  /// a solver grid). Other modifications of the grid are recorded in O(1):
+  /// nodes added out of memory order (e.g. the children of a refined node)
+  /// are appended to the list, and removed nodes are recorded as pending
+  /// removals. The next call to update_node_lists sorts the list and merges
+  /// the removals in O(G log(G)), where G is the grid size. Lists that have
+  /// been invalidated (see invalidate_node_lists) are rebuilt in O(N) by
+  /// update_node_lists (or sort). Meanwhile, nodes(g) scans the whole tree.
+  ///
+  ///@{
+
+  /// Is the node list of grid \p g up-to-date?
+  bool has_node_list(grid_idx g) const noexcept {
+    assert_grid_in_bounds(g, HM3_AT_);
+    return has_node_list_[*g] and !has_pending_nodes_[*g];
+  }
+
+  /// Tree nodes of grid \p g in memory order
+  ///
+  /// The list is contiguous, such that loops over it can be split across
+  /// threads (e.g. using parallel::for_each).
+  ///
+  /// \pre has_node_list(g)
+  node_list_t const& node_list(grid_idx g) const noexcept {
+    HM3_ASSERT(has_node_list(g), "node list of grid {} is not up-to-date", g);
+    return node_lists_[*g];
+  }
+
+  /// Marks the node lists of all grids as out-of-date
+  void invalidate_node_lists() noexcept {
+    for (auto&& g : grids()) { has_node_list_[*g] = false; }
+  }
+
+  /// Rebuilds the out-of-date node lists and merges the pending changes
+  /// into the others
+  ///
+  /// Time complexity: O(N * M / no_threads) where M is the number of
+  /// out-of-date node lists (O(G log(G)) for lists with pending changes).
+  void update_node_lists() {
+    std::vector<grid_idx> gs;
+    for (auto&& g : grids()) {
+      if (!has_node_list(g)) { gs.push_back(g); }
+    }
+    parallel::for_each(0, gs.size(), [&](int_t i) {
+      const auto g = gs[i];
+      auto& l      = node_lists_[*g];
+      auto& r      = removed_nodes_[*g];
+      if (has_node_list_[*g]) {  // merge pending changes:
+        std::sort(begin(l), end(l));
+        std::sort(begin(r), end(r));
+        // note: a node removed and added again is twice in the list but
+        // only once in the removals, so it is kept once
+        std::size_t o = 0, j = 0;
+        for (std::size_t k = 0, e = l.size(); k != e; ++k) {
+          while (j != r.size() and r[j] < l[k]) { ++j; }
+          if (j != r.size() and r[j] == l[k]) {
+            ++j;
+            continue;
+          }
+          l[o++] = l[k];
+        }
+        l.resize(o);
+      } else {  // rebuild:
+        l.clear();
+        RANGES_FOR (auto&& n, TreeGrid::nodes()) {
+          if (grids_.contains(n, g)) { l.push_back(*n); }
+        }
+      }
+      r.clear();
+    });
+    for (auto&& g : gs) {
+      has_node_list_[*g]     = true;
+      has_pending_nodes_[*g] = false;
+    }
+  }
+
+ private:
+  /// Sets the index of node \p n within grid \p g to \p v
+  void set_node(tree_node_idx n, grid_idx g, grid_node_idx v) noexcept {
+    const bool was_in_grid = grids_.contains(n, g);
+    grids_(n, g)           = v;
+    if (!has_node_list_[*g] or was_in_grid == static_cast<bool>(v)) {
+      return;
+    }
+    auto& l = node_lists_[*g];
+    if (v) {
+      // nodes out of memory order are sorted in update_node_lists:
+      if (!l.empty() and !(l.back() < *n)) { has_pending_nodes_[*g] = true; }
+      l.push_back(*n);
+    } else {  // removed nodes are merged in update_node_lists:
+      removed_nodes_[*g].push_back(*n);
+      has_pending_nodes_[*g] = true;
+    }
+  }
+
+ public:
+  ///@}  // Node lists
+
+  /// Structure statistics of the tree grid including the memory of the grid
+  /// node indices (see tree::stats)
+  tree::statistics stats() const {
+    auto s            = tree::stats(static_cast<TreeGrid const&>(*this));
+    const uint_t size = *TreeGrid::size();
+    const uint_t cap  = *TreeGrid::capacity();
+    s.memory.push_back({"grids", grids_.memory_used(TreeGrid::size()),
+                        grids_.memory_reserved()});
+    uint_t lists_used = 0, lists_reserved = 0;
+    for (auto&& l : node_lists_) {
+      lists_used += l.size() * sizeof(typename node_list_t::value_type);
+      lists_reserved += l.capacity() * sizeof(typename node_list_t::value_type);
+    }
+    s.memory.push_back({"node_lists", lists_used, lists_reserved});
+    if (TreeGrid::has_geometry_cache()) {
+      const uint_t node_bytes = TreeGrid::dimension() * sizeof(num_t) + 1;
+      s.memory.push_back(
+       {"geometry_cache", size * node_bytes, cap * node_bytes});
+    }
+    return s;
+  }
 
   /// Refines node \p n and return the tree_node_idx of its children
   ///
@@ -90,20 +291,74 @@ struct multi : TreeGrid {
   auto remove(tree_node_idx n, grid_idx g) noexcept {
     assert_node_in_use(n, HM3_AT_);
     assert_grid_in_bounds(g, HM3_AT_);
-    HM3_ASSERT(node(n, g), "node(node: {}, grid: {}) is already invalid", n, g);
+    HM3_ASSERT(in_grid(n, g), "node(node: {}, grid: {}) is already invalid", n,
+               g);
     node(n, g) = grid_node_idx{};
     auto p     = TreeGrid::parent(n);
     if (TreeGrid::is_leaf(n) and !TreeGrid::is_root(n)) {
-      if (all_of(TreeGrid::siblings(n), [&](tree_node_idx m) {
-            return all_of(grid_nodes(m), [&](grid_node_idx i) { return !i; });
-          })) {
+      if (all_of(TreeGrid::siblings(n),
+                 [&](tree_node_idx m) { return grids_.empty(m); })) {
         // TreeGrid::coarsen(p);
+        // note: the removed siblings are in no grid, so the node lists are
+        // not affected
         tree::balanced_coarsen(static_cast<TreeGrid&>(*this), p);
       }
     }
     return p;
   }
 
+  /// Remove the grid nodes of grid \p g at the nodes \p ns
+  ///
+  /// Equivalent to calling remove(n, g) for each node, but the nodes are
+  /// erased from the node list of grid \p g in a single pass (if it has no
+  /// pending changes; otherwise they are recorded as pending removals), and
+  /// the parents whose children no longer contain grid nodes of any grid are
+  /// coarsened in a single pass at the end (from the finest to the coarsest
+  /// level).
+  template <typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  void remove(Rng&& ns, grid_idx g) {
+    assert_grid_in_bounds(g, HM3_AT_);
+    std::vector<std::pair<tree::level_idx, tree_node_idx>> parents;
+    node_list_t removed;
+    for (auto&& n : ns) {
+      assert_node_in_use(n, HM3_AT_);
+      HM3_ASSERT(in_grid(n, g), "node(node: {}, grid: {}) is already invalid",
+                 n, g);
+      grids_(n, g) = grid_node_idx{};
+      removed.push_back(*n);
+      if (TreeGrid::is_leaf(n) and !TreeGrid::is_root(n)) {
+        const auto p = TreeGrid::parent(n);
+        parents.push_back(std::make_pair(tree::node_level(*this, p), p));
+      }
+    }
+    std::sort(begin(parents), end(parents),
+              [](auto&& a, auto&& b) { return a > b; });
+    parents.erase(std::unique(begin(parents), end(parents)), end(parents));
+    if (has_node_list_[*g] and has_pending_nodes_[*g]) {
+      auto& r = removed_nodes_[*g];
+      r.insert(end(r), begin(removed), end(removed));
+    } else if (has_node_list_[*g]) {
+      std::sort(begin(removed), end(removed));
+      auto& l = node_lists_[*g];
+      l.erase(std::remove_if(begin(l), end(l),
+                             [&](auto&& n) {
+                               return std::binary_search(begin(removed),
+                                                         end(removed), n);
+                             }),
+              end(l));
+    }
+    // note: the coarsened children are in no grid, so the node lists are not
+    // affected
+    for (auto&& lp : parents) {
+      const auto p = lp.second;
+      if (all_of(TreeGrid::children(p), [&](tree_node_idx m) {
+            return TreeGrid::is_leaf(m) and grids_.empty(m);
+          })) {
+        tree::balanced_coarsen(static_cast<TreeGrid&>(*this), p);
+      }
+    }
+  }
+
   /// \name Tree-Node-to-Grid-Node map: (tree_node_idx, grid_idx) ->
   /// grid_node_idx
   /// transform
@@ -113,20 +368,20 @@ struct multi : TreeGrid {
   inline grid_node_idx node(tree_node_idx n, grid_idx g) const noexcept {
     assert_grid_in_bounds(g, HM3_AT_);
     assert_node_in_use(n, HM3_AT_);
-    return grids_(*n, *g);
+    return grids_(n, g);
   }
   /// Index of node \p n within grid \p g
-  inline grid_node_idx& node(tree_node_idx n, grid_idx g) noexcept {
+  inline grid_node_ref node(tree_node_idx n, grid_idx g) noexcept {
     assert_grid_in_bounds(g, HM3_AT_);
     assert_node_in_use(n, HM3_AT_);
-    return grids_(*n, *g);
+    return grid_node_ref{*this, n, g};
   }
 
   /// Is the node \p n part of grid \p g ?
   inline bool in_grid(tree_node_idx n, grid_idx g) const noexcept {
     assert_grid_in_bounds(g, HM3_AT_);
     assert_node_in_use(n, HM3_AT_);
-    return n ? (node(n, g) != grid_node_idx{}) : false;
+    return n ? grids_.contains(n, g) : false;
   }
 
   /// Filters nodes that belong to the grid \p g
@@ -148,10 +403,21 @@ struct multi : TreeGrid {
      [&, g](tree_node_idx n) { return n ? node(n, g) : grid_node_idx{}; });
   }
 
-  /// All nodes in grid \p g
+  /// All nodes in grid \p g (in memory order)
+  ///
+  /// Time complexity: O(grid size) if has_node_list(g), O(N) otherwise.
   inline auto nodes(grid_idx g) const noexcept {
     assert_grid_in_bounds(g, HM3_AT_);
-    return TreeGrid::nodes() | in_grid(g);
+    const bool listed = has_node_list(g);
+    const idx_t size  = listed ? static_cast<idx_t>(node_lists_[*g].size())
+                               : *TreeGrid::capacity();
+    return view::ints(idx_t{0}, size)
+           | view::transform([&, g, listed](idx_t i) {
+               return tree_node_idx{listed ? node_lists_[*g][i] : i};
+             })
+           | view::filter([&, g, listed](tree_node_idx n) {
+               return listed or (!TreeGrid::is_free(n) and in_grid(n, g));
+             });
   }
 
   /// All grid nodes in grid \p g
@@ -207,23 +473,29 @@ struct multi : TreeGrid {
   ///@}  // Node-to-Grid-Node map
 };
 
-template <typename TreeGrid>
-bool operator==(multi<TreeGrid> const& a, multi<TreeGrid> const& b) noexcept {
+template <typename TreeGrid, typename Membership>
+bool operator==(multi<TreeGrid, Membership> const& a,
+                multi<TreeGrid, Membership> const& b) noexcept {
   using tree_grid_t = TreeGrid const&;
   return static_cast<tree_grid_t>(a) == static_cast<tree_grid_t>(b)
-         && a.grids_() == b.grids_();
+         && a.grids_ == b.grids_;
 }
 
-template <typename TreeGrid>
-bool operator!=(multi<TreeGrid> const& a, multi<TreeGrid> const& b) noexcept {
+template <typename TreeGrid, typename Membership>
+bool operator!=(multi<TreeGrid, Membership> const& a,
+                multi<TreeGrid, Membership> const& b) noexcept {
   return !(a == b);
 }
 
-template <typename TreeGrid> string type(multi<TreeGrid> const&) {
+/// The type does not depend on the membership layout (the layouts share the
+/// same file format)
+template <typename TreeGrid, typename Membership>
+string type(multi<TreeGrid, Membership> const&) {
   return "multi_" + type(TreeGrid{});
 }
 
-template <typename TreeGrid> string name(multi<TreeGrid> const&) {
+template <typename TreeGrid, typename Membership>
+string name(multi<TreeGrid, Membership> const&) {
   return "multi_" + name(TreeGrid{});
 }
 
@@ -9,25 +9,52 @@ namespace hm3 {
 namespace grid {
 namespace adaptor {
 
+/// Maps the grid node indices of grid \p g of the first \p size nodes to the
+/// array \p field_name of the file descriptor \p f
+///
+/// The grid node indices of each grid are contiguous in memory.
+template <typename Idx>
+void map_grid(io::file& f, string const& field_name,
+              dense_membership<Idx> const& m, grid_idx g,
+              tree_node_idx size) {
+  f.index_field<idx_t>(field_name, m.column(g), *size);
+}
+
+/// Maps the grid node indices of grid \p g of the first \p size nodes to the
+/// array \p field_name of the file descriptor \p f
+///
+/// The grid node indices are gathered into (scattered from) a temporary
+/// buffer. Since scattering happens after reading, \p m must not be moved
+/// before the arrays of \p f are read.
+template <typename Idx>
+void map_grid(io::file& f, string const& field_name,
+              sparse_membership<Idx> const& m, grid_idx g,
+              tree_node_idx size) {
+  auto& m_ = const_cast<sparse_membership<Idx>&>(m);
+  f.gathered_index_field<idx_t>(
+   field_name, *size,
+   [&m, g](std::size_t i) { return m(tree_node_idx{idx_t(i)}, g); },
+   [&m_, g](std::size_t i, grid_node_idx v) {
+     m_.set(tree_node_idx{idx_t(i)}, g, v);
+   });
+}
+
 /// Maps arrays in the file descriptor to memory addresses
-template <typename TreeGrid>
-void map_arrays(io::file& f, multi<TreeGrid> const& t) {
+template <typename TreeGrid, typename Membership>
+void map_arrays(io::file& f, multi<TreeGrid, Membership> const& t) {
   // Support reading a number of grids smaller than grid capacity:
   grid_idx no_grids = f.has_field("no_grids")
                        ? grid_idx{f.constant("no_grids", int64_t{})}
                        : t.no_grids();
 
   for (auto&& g = 0_g; g != no_grids; ++g) {
-    auto field_name       = "grid_" + std::to_string(*g);
-    const idx_t* data_ptr = reinterpret_cast<const idx_t*>(&t.grids_(0_n, g));
-    f.field(field_name, data_ptr, *t.size());
+    auto field_name = "grid_" + std::to_string(*g);
+    map_grid(f, field_name, t.grids_, g, t.size());
   }
 }
 
-template <typename TreeGrid>
-multi<TreeGrid> from_file_unread(multi<TreeGrid> const&, io::file& f,
-                                 tree_node_idx node_capacity,
-                                 grid_idx grid_capacity) {
+/// Grid capacity of a multi grid read from the file descriptor \p f
+inline grid_idx read_grid_capacity(io::file& f, grid_idx grid_capacity) {
   int64_t no_grids = f.constant("no_grids", int64_t{});
   no_grids
    = grid_capacity ? *grid_capacity : f.constant("no_grids", uint64_t{});
@@ -37,34 +64,56 @@ multi<TreeGrid> from_file_unread(multi<TreeGrid> const&, io::file& f,
       HM3_FATAL_ERROR("The number of grids {} is smaller than in the file {}",
                       grid_capacity, no_grids);
     }
-    no_grids = *grid_capacity;
   }
+  return grid_capacity;
+}
 
-  multi<TreeGrid> t(grid_capacity,
-                    from_file_unread(TreeGrid{}, f, node_capacity));
+/// \warning The grid node indices of a multi grid with a sparse_membership
+/// layout are only written to their memory location after reading, that is,
+/// it must be read with from_file. The node lists must be updated after
+/// reading (see multi::update_node_lists).
+template <typename TreeGrid, typename Membership>
+multi<TreeGrid, Membership> from_file_unread(
+ multi<TreeGrid, Membership> const&, io::file& f, tree_node_idx node_capacity,
+ grid_idx grid_capacity) {
+  static_assert(std::is_same<Membership, dense_membership<
+                                          typename TreeGrid::index_type>>{},
+                "the membership layout must be read with from_file");
+  multi<TreeGrid, Membership> t(
+   read_grid_capacity(f, grid_capacity),
+   from_file_unread(TreeGrid{}, f, node_capacity));
   map_arrays(f, t);
+  // the arrays are not read yet, so the node lists are out-of-date:
+  t.invalidate_node_lists();
 
   // Move the hierarchical cartesian grid out of the function:
-  static_assert(std::is_move_constructible<multi<TreeGrid>>{},
+  static_assert(std::is_move_constructible<multi<TreeGrid, Membership>>{},
                 "if hc::multi is not move constructible mapping the arrays "
                 "fails (they will be mapped to the wrong addresses in memory)");
   return t;
 }
 
 /// Reads hc::multi from file descriptor \p f
-template <typename TreeGrid>
-multi<TreeGrid> from_file(multi<TreeGrid> const&, io::file& f,
-                          tree_node_idx node_capacity = tree_node_idx{},
-                          grid_idx grid_capacity = grid_idx{}) {
-  auto&& t
-   = from_file_unread(multi<TreeGrid>{}, f, node_capacity, grid_capacity);
+///
+/// The multi grid is read in place (see from_file_unread).
+template <typename TreeGrid, typename Membership>
+multi<TreeGrid, Membership> from_file(
+ multi<TreeGrid, Membership> const&, io::file& f,
+ tree_node_idx node_capacity = tree_node_idx{},
+ grid_idx grid_capacity = grid_idx{}) {
+  multi<TreeGrid, Membership> t(
+   read_grid_capacity(f, grid_capacity),
+   from_file_unread(TreeGrid{}, f, node_capacity));
+  map_arrays(f, t);
   f.read_arrays();
+  t.invalidate_node_lists();
+  t.update_node_lists();
   return t;
 }
 
 /// Appends constants and map arrays to file \p f
-template <typename TreeGrid>
-void to_file_unwritten(io::file& f, multi<TreeGrid> const& t) {
+template <typename TreeGrid, typename Membership>
+void to_file_unwritten(io::file& f, multi<TreeGrid, Membership> const& t) {
   to_file_unwritten(f, static_cast<TreeGrid const&>(t));
   f.field("no_grids", *t.no_grids());
   map_arrays(f, t);
@@ -0,0 +1,278 @@
+#pragma once
+/// \file
+///
+/// Sparse grid membership layout
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <hm3/grid/types.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/bit.hpp>
+#include <hm3/utility/compact_optional.hpp>
+
+namespace hm3 {
+namespace grid {
+namespace adaptor {
+
+/// Sparse grid membership layout: (tree_node_idx, grid_idx) -> grid_node_idx
+///
+/// Stores per node:
+/// - a bitmask of the grids the node belongs to, and
+/// - the offset of the node's row within a pool of grid node indices.
+///
+/// The row of a node contains the grid node indices of the grids the node
+/// belongs to ordered by grid index, such that the index of node n within grid
+/// g is at position rank(mask(n), g) of its row, where rank is the number of
+/// bits of the mask below bit g. Rows have a capacity of 2^k indices and are
+/// recycled through per-capacity free lists.
+///
+/// Memory requirements: one mask and one offset per node plus one grid node
+/// index per grid node (plus the slack of the rows). Best suited for a large
+/// number of grids that cover a small part of the tree each (see
+/// dense_membership otherwise).
+///
+/// Time complexity:
+/// - access, membership test: O(1)
+/// - insertion/removal of a node from a grid: O(no_grids)
+/// - swapping the membership of two nodes: O(1)
+///
+/// The grid node indices and row offsets are stored using the index type
+/// \p Idx. The maximum number of grids is max_no_grids.
+template <typename Idx>  //
+struct sparse_membership {
+  /// Grid node index as stored in memory
+  using stored_grid_node_idx = grid_node_idx_storage<Idx>;
+  /// Bitmask of grids
+  using mask_t = std::uint64_t;
+
+  /// Maximum number of grids
+  static constexpr idx_t max_no_grids = bit::width<mask_t>;
+  /// Number of row capacities: 2^0, ..., 2^(no_row_classes - 1)
+  static constexpr uint_t no_row_classes = 7;
+
+  /// Mutable reference to a grid node index
+  struct reference {
+    sparse_membership& m_;
+    tree_node_idx n_;
+    grid_idx g_;
+
+    operator grid_node_idx() const noexcept {
+      return static_cast<sparse_membership const&>(m_)(n_, g_);
+    }
+    explicit operator bool() const noexcept { return m_.contains(n_, g_); }
+    idx_t operator*() const noexcept {
+      return *static_cast<grid_node_idx>(*this);
+    }
+    reference& operator=(grid_node_idx v) noexcept {
+      m_.set(n_, g_, v);
+      return *this;
+    }
+    reference& operator=(reference const& o) noexcept {
+      return (*this) = static_cast<grid_node_idx>(o);
+    }
+  };
+
+  /// Grid bitmask of each node
+  std::vector<mask_t> masks_;
+  /// Offset of the row of each node within the pool (if the node belongs to
+  /// a grid)
+  std::vector<Idx> rows_;
+  /// Pool of rows of grid node indices
+  std::vector<stored_grid_node_idx> values_;
+  /// Offsets of the free rows of each capacity
+  std::array<std::vector<Idx>, no_row_classes> free_rows_;
+  /// Number of grid node indices in use
+  idx_t no_values_ = 0;
+  idx_t no_grids_  = 0;
+
+  sparse_membership()                         = default;
+  sparse_membership(sparse_membership const&) = default;
+  sparse_membership(sparse_membership&&)      = default;
+  sparse_membership& operator=(sparse_membership const&) = default;
+  sparse_membership& operator=(sparse_membership&&) = default;
+
+  sparse_membership(tree_node_idx node_capacity, grid_idx grid_capacity)
+   : masks_(*node_capacity, mask_t{0})
+   , rows_(*node_capacity, Idx{0})
+   , no_grids_(*grid_capacity) {
+    HM3_ASSERT(*grid_capacity <= max_no_grids,
+               "grid capacity {} exceeds the maximum number of grids {}",
+               grid_capacity, max_no_grids);
+  }
+
+ private:
+  /// Bit of grid \p g
+  static mask_t bit_of(grid_idx g) noexcept { return mask_t{1} << *g; }
+
+  /// Position of grid \p g within a row of grids \p m
+  static uint_t rank(mask_t m, grid_idx g) noexcept {
+    return bit::popcount(m & (bit_of(g) - 1));
+  }
+
+  /// Capacity class of a row containing \p k > 0 indices
+  static uint_t row_class(uint_t k) noexcept {
+    uint_t c = 0;
+    while ((uint_t{1} << c) < k) { ++c; }
+    return c;
+  }
+
+  /// Allocates a row of capacity class \p c
+  idx_t allocate_row(uint_t c) {
+    auto& free = free_rows_[c];
+    if (!free.empty()) {
+      const idx_t r = free.back();
+      free.pop_back();
+      return r;
+    }
+    const idx_t r = values_.size();
+    HM3_ASSERT(r + (idx_t{1} << c) <= std::numeric_limits<Idx>::max(),
+               "row offset {} overflows the index type", r);
+    values_.resize(r + (idx_t{1} << c));
+    return r;
+  }
+
+  /// Releases the row at offset \p r of capacity class \p c
+  void release_row(idx_t r, uint_t c) { free_rows_[c].push_back(r); }
+
+  /// Adds node \p n to grid \p g with index \p v
+  void insert(tree_node_idx n, grid_idx g, grid_node_idx v) {
+    const mask_t m   = masks_[*n];
+    const uint_t k   = bit::popcount(m);
+    const uint_t pos = rank(m, g);
+    const auto val   = compact_optional_cast<stored_grid_node_idx>(v);
+    if (k == 0 or (k & (k - 1)) == 0) {  // row is full: move to a larger one
+      const idx_t r = allocate_row(row_class(k + 1));
+      if (k > 0) {
+        const idx_t o = rows_[*n];
+        std::copy_n(begin(values_) + o, pos, begin(values_) + r);
+        std::copy_n(begin(values_) + o + pos, k - pos,
+                    begin(values_) + r + pos + 1);
+        release_row(o, row_class(k));
+      }
+      rows_[*n] = r;
+    } else {
+      const auto row = begin(values_) + rows_[*n];
+      std::copy_backward(row + pos, row + k, row + k + 1);
+    }
+    values_[rows_[*n] + pos] = val;
+    masks_[*n]               = m | bit_of(g);
+    ++no_values_;
+  }
+
+  /// Removes node \p n from grid \p g
+  void erase(tree_node_idx n, grid_idx g) {
+    const mask_t m   = masks_[*n];
+    const uint_t k   = bit::popcount(m);
+    const uint_t pos = rank(m, g);
+    const idx_t o    = rows_[*n];
+    if (k == 1) {
+      release_row(o, 0);
+    } else if (((k - 1) & (k - 2)) == 0) {  // row too large: move it
+      const idx_t r = allocate_row(row_class(k - 1));
+      std::copy_n(begin(values_) + o, pos, begin(values_) + r);
+      std::copy_n(begin(values_) + o + pos + 1, k - pos - 1,
+                  begin(values_) + r + pos);
+      release_row(o, row_class(k));
+      rows_[*n] = r;
+    } else {
+      const auto row = begin(values_) + o;
+      std::copy(row + pos + 1, row + k, row + pos);
+    }
+    masks_[*n] = m & ~bit_of(g);
+    --no_values_;
+  }
+
+ public:
+  /// Number of grids
+  grid_idx no_grids() const noexcept { return grid_idx{no_grids_}; }
+
+  /// Index of node \p n within grid \p g
+  grid_node_idx operator()(tree_node_idx n, grid_idx g) const noexcept {
+    const mask_t m = masks_[*n];
+    if (!(m & bit_of(g))) { return grid_node_idx{}; }
+    return compact_optional_cast<grid_node_idx>(
+     values_[rows_[*n] + rank(m, g)]);
+  }
+  /// Index of node \p n within grid \p g
+  reference operator()(tree_node_idx n, grid_idx g) noexcept {
+    return reference{*this, n, g};
+  }
+
+  /// Sets the index of node \p n within grid \p g to \p v (removes the node
+  /// from the grid if \p v is invalid)
+  void set(tree_node_idx n, grid_idx g, grid_node_idx v) {
+    if (contains(n, g)) {
+      if (v) {
+        values_[rows_[*n] + rank(masks_[*n], g)]
+         = compact_optional_cast<stored_grid_node_idx>(v);
+      } else {
+        erase(n, g);
+      }
+    } else if (v) {
+      insert(n, g, v);
+    }
+  }
+
+  /// Is node \p n part of grid \p g?
+  bool contains(tree_node_idx n, grid_idx g) const noexcept {
+    return masks_[*n] & bit_of(g);
+  }
+
+  /// Is node \p n part of no grid?
+  bool empty(tree_node_idx n) const noexcept { return masks_[*n] == 0; }
+
+  /// Grid bitmask of node \p n
+  mask_t mask(tree_node_idx n) const noexcept { return masks_[*n]; }
+
+  /// Swaps the grid node indices of the nodes \p a and \p b
+  ///
+  /// Time complexity: O(1)
+  void swap(tree_node_idx a, tree_node_idx b) noexcept {
+    using std::swap;
+    swap(masks_[*a], masks_[*b]);
+    swap(rows_[*a], rows_[*b]);
+  }
+
+  /// Memory used by the first \p no_nodes nodes (bytes)
+  uint_t memory_used(tree_node_idx no_nodes) const noexcept {
+    return *no_nodes * (sizeof(mask_t) + sizeof(Idx))
+           + no_values_ * sizeof(stored_grid_node_idx);
+  }
+
+  /// Memory reserved (bytes)
+  uint_t memory_reserved() const noexcept {
+    uint_t r = masks_.capacity() * sizeof(mask_t)
+               + rows_.capacity() * sizeof(Idx)
+               + values_.capacity() * sizeof(stored_grid_node_idx);
+    for (auto&& f : free_rows_) { r += f.capacity() * sizeof(Idx); }
+    return r;
+  }
+};
+
+template <typename Idx>
+bool operator==(sparse_membership<Idx> const& a,
+                sparse_membership<Idx> const& b) noexcept {
+  if (a.no_grids() != b.no_grids() or a.masks_.size() != b.masks_.size()) {
+    return false;
+  }
+  for (idx_t i = 0, e = a.masks_.size(); i != e; ++i) {
+    const tree_node_idx n{i};
+    if (a.mask(n) != b.mask(n)) { return false; }
+    for (idx_t g = 0, ge = *a.no_grids(); g != ge; ++g) {
+      if (a(n, grid_idx{g}) != b(n, grid_idx{g})) { return false; }
+    }
+  }
+  return true;
+}
+
+template <typename Idx>
+bool operator!=(sparse_membership<Idx> const& a,
+                sparse_membership<Idx> const& b) noexcept {
+  return !(a == b);
+}
+
+}  // namespace adaptor
+}  // namespace grid
+}  // namespace hm3
@@ -0,0 +1,279 @@
+#pragma once
+/// \file
+///
+/// Bottom-up tree construction from point clouds
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <hm3/geometry/point.hpp>
+#include <hm3/geometry/square.hpp>
+#include <hm3/grid/types.hpp>
+#include <hm3/tree/algorithm/balance.hpp>
+#include <hm3/tree/algorithm/dfs_sort.hpp>
+#include <hm3/tree/location/default.hpp>
+#include <hm3/tree/tree.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/bit.hpp>
+#include <hm3/utility/math.hpp>
+#include <hm3/utility/parallel.hpp>
+#include <hm3/utility/radix_sort.hpp>
+
+namespace hm3 {
+namespace grid {
+namespace generation {
+
+/// Morton key of a leaf node (or point) of an Nd-dimensional tree
+using morton_key_t = std::uint64_t;
+
+/// Number of levels encoded in the Morton keys of an Nd-dimensional tree
+///
+/// The keys encode the position of the nodes at this level: the digit of a key
+/// at level l (its Nd bits at level l) is the position of the node at level l
+/// within its parent.
+template <uint_t Nd> constexpr uint_t morton_key_levels() noexcept {
+  return tree::loc_t<Nd>::no_levels() - 1;
+}
+
+/// Morton key of the point \p x within the bounding box \p bounding_box
+///
+/// \pre \p x is inside \p bounding_box
+template <int_t Nd>
+morton_key_t morton_key(geometry::point<Nd> const& x,
+                        geometry::square<Nd> const& bounding_box) noexcept {
+  constexpr uint_t levels      = morton_key_levels<Nd>();
+  constexpr morton_key_t max_x = (morton_key_t{1} << levels) - 1;
+  const num_t scale = (max_x + num_t{1}) / geometry::length(bounding_box);
+  const auto x_min  = geometry::x_min(bounding_box);
+  std::array<morton_key_t, Nd> xs;
+  for (auto&& d : dimensions(Nd)) {
+    const num_t v = (x(d) - x_min(d)) * scale;
+    HM3_ASSERT(v >= 0. and v <= max_x + num_t{1},
+               "point outside of the bounding box along dimension {}", d);
+    xs[d] = std::min(static_cast<morton_key_t>(v), max_x);
+  }
+  return bit::morton::encode(xs);
+}
+
+/// Tree built from a point cloud
+template <uint_t Nd> struct point_cloud_tree {
+  /// DFS-sorted 2:1 balanced tree
+  ::hm3::tree::tree<Nd> tree;
+  /// Leaf node containing each point
+  std::vector<::hm3::tree::node_idx> leafs;
+};
+
+namespace point_cloud_detail {
+
+/// Builds the tree of the sorted Morton \p keys
+///
+/// A node is a range [b, e) of the sorted keys: the keys with the same digits
+/// up to its level. Its children ranges are found by binary search.
+template <uint_t Nd> struct builder {
+  static constexpr uint_t key_levels  = morton_key_levels<Nd>();
+  static constexpr uint_t no_children = tree::tree<Nd>::no_children();
+  using child_pos = typename tree::tree<Nd>::child_pos;
+
+  std::vector<morton_key_t> const& keys;
+  idx_t max_points_per_leaf;
+  uint_t max_level;
+
+  /// Position at level \p l of the node containing key \p k
+  static uint_t digit(morton_key_t k, uint_t l) noexcept {
+    return (k >> (Nd * (key_levels - l))) & (no_children - 1);
+  }
+
+  /// Is the node [b, e) at level \p l refined?
+  bool is_refined(idx_t b, idx_t e, uint_t l) const noexcept {
+    return e - b > max_points_per_leaf and l < max_level;
+  }
+
+  /// Calls \p f(b_c, e_c) on the children of the node [b, e) at level \p l
+  template <typename F>
+  void for_each_child(idx_t b, idx_t e, uint_t l, F&& f) const {
+    const auto first = begin(keys);
+    for (uint_t c = 0; c != no_children; ++c) {
+      const idx_t e_c
+       = std::partition_point(first + b, first + e,
+                              [&](morton_key_t k) {
+                                return digit(k, l + 1) <= c;
+                              })
+         - first;
+      f(b, e_c);
+      b = e_c;
+    }
+  }
+
+  /// Number of refined nodes in the sub-tree of the node [b, e) at level \p l
+  idx_t no_refined(idx_t b, idx_t e, uint_t l) const {
+    if (!is_refined(b, e, l)) { return 0; }
+    idx_t r = 1;
+    for_each_child(b, e, l, [&](idx_t b_c, idx_t e_c) {
+      r += no_refined(b_c, e_c, l + 1);
+    });
+    return r;
+  }
+
+  /// Refines the sub-tree of the node \p n = [b, e) at level \p l in DFS
+  /// order into the reserved sibling groups starting at \p s
+  void write(tree::tree<Nd>& t, tree::node_idx n, idx_t b, idx_t e, uint_t l,
+             idx_t& s) const {
+    if (!is_refined(b, e, l)) { return; }
+    t.refine_into(n, tree::siblings_idx{s++});
+    uint_t c = 0;
+    for_each_child(b, e, l, [&](idx_t b_c, idx_t e_c) {
+      write(t, t.child(n, child_pos{c++}), b_c, e_c, l + 1, s);
+    });
+  }
+
+  /// Leaf node of \p t containing key \p k
+  static tree::node_idx leaf(tree::tree<Nd> const& t, morton_key_t k) noexcept {
+    tree::node_idx n{0};
+    for (uint_t l = 1; !t.is_leaf(n); ++l) {
+      n = t.child(n, child_pos{digit(k, l)});
+    }
+    return n;
+  }
+};
+
+}  // namespace point_cloud_detail
+
+/// Builds the minimal 2:1 balanced tree with at most \p max_points_per_leaf
+/// points per leaf node (or leaf nodes at \p max_level) from the Morton
+/// \p keys of the points (see morton_key)
+///
+/// Algorithm:
+/// 1. the keys are sorted with a parallel radix sort,
+/// 2. the leaf boundaries (key ranges of the nodes) are found by binary search
+///    within the sorted keys, and the number of sibling groups of each
+///    sub-tree below a split level is counted in parallel,
+/// 3. the sibling groups are reserved and written directly in DFS order (see
+///    tree::refine_into), the sub-trees below the split level in parallel,
+/// 4. the tree is 2:1 balanced (see tree::balance), and sorted again if this
+///    refined nodes,
+/// 5. each point is assigned to its leaf node in parallel.
+///
+/// Time complexity: O(P / no_threads * levels) for P points.
+///
+/// \returns the tree (of capacity \p node_capacity), and the leaf node of
+/// each key.
+template <uint_t Nd>
+point_cloud_tree<Nd> point_cloud(tree::node_idx node_capacity,
+                                 std::vector<morton_key_t> keys,
+                                 uint_t max_points_per_leaf,
+                                 uint_t max_level = morton_key_levels<Nd>()) {
+  using builder_t = point_cloud_detail::builder<Nd>;
+  HM3_ASSERT(max_level <= morton_key_levels<Nd>(),
+             "max level {} exceeds the levels of the keys {}", max_level,
+             morton_key_levels<Nd>());
+  constexpr uint_t nc = builder_t::no_children;
+  const idx_t no_keys = keys.size();
+
+  // 1. Sort the keys:
+  std::vector<idx_t> order(no_keys);
+  parallel::for_each_static(0, no_keys, [&](int_t i) { order[i] = i; });
+  parallel::radix_sort(keys, order, Nd * morton_key_levels<Nd>());
+
+  // 2. Split the tree at the first level with enough nodes to keep all
+  // threads busy, and count the refined nodes of each sub-tree below it:
+  const builder_t b{keys, idx_t(max_points_per_leaf), max_level};
+  uint_t split = 0;
+  while (split < max_level
+         and math::ipow(nc, split) < 8 * parallel::no_threads()) {
+    ++split;
+  }
+  struct sub_tree {
+    idx_t b, e;
+    tree::node_idx n;
+    idx_t first_sg;
+  };
+  std::vector<sub_tree> sub_trees;
+  idx_t no_sgs = 0;  // refined nodes above the split level
+  auto collect = [&](auto&& self, idx_t first, idx_t last, uint_t l) -> void {
+    if (!b.is_refined(first, last, l)) { return; }
+    if (l == split) {
+      sub_trees.push_back(sub_tree{first, last, tree::node_idx{}, 0});
+      return;
+    }
+    ++no_sgs;
+    b.for_each_child(first, last, l, [&](idx_t b_c, idx_t e_c) {
+      self(self, b_c, e_c, l + 1);
+    });
+  };
+  collect(collect, 0, no_keys, 0);
+
+  const idx_t no_sub_trees = sub_trees.size();
+  std::vector<idx_t> sub_tree_sgs(no_sub_trees);
+  parallel::for_each(0, no_sub_trees, [&](int_t i) {
+    sub_tree_sgs[i] = b.no_refined(sub_trees[i].b, sub_trees[i].e, split);
+  });
+  for (auto&& c : sub_tree_sgs) { no_sgs += c; }
+
+  // 3. Reserve the sibling groups and write the tree in DFS order:
+  if (1 + no_sgs * nc > *node_capacity) {
+    HM3_FATAL_ERROR("the tree requires {} nodes but its capacity is {}",
+                    1 + no_sgs * nc, node_capacity);
+  }
+  point_cloud_tree<Nd> r{tree::tree<Nd>(*node_capacity), {}};
+  auto& t = r.tree;
+  idx_t s = *t.reserve_sibling_groups(no_sgs);
+  idx_t i = 0;
+  auto write_top = [&](auto&& self, tree::node_idx n, idx_t first,
+                       idx_t last, uint_t l) -> void {
+    if (!b.is_refined(first, last, l)) { return; }
+    if (l == split) {
+      sub_trees[i].n        = n;
+      sub_trees[i].first_sg = s;
+      s += sub_tree_sgs[i++];
+      return;
+    }
+    t.refine_into(n, tree::siblings_idx{s++});
+    uint_t c = 0;
+    b.for_each_child(first, last, l, [&](idx_t b_c, idx_t e_c) {
+      self(self, t.child(n, typename builder_t::child_pos{c++}), b_c, e_c,
+           l + 1);
+    });
+  };
+  write_top(write_top, tree::node_idx{0}, 0, no_keys, 0);
+  parallel::for_each(0, no_sub_trees, [&](int_t j) {
+    auto& st = sub_trees[j];
+    idx_t sg = st.first_sg;
+    b.write(t, st.n, st.b, st.e, split, sg);
+  });
+  HM3_ASSERT(t.is_compact(), "the tree is not compact");
+
+  // 4. Balance the tree:
+  const auto unbalanced_size = t.size();
+  if (!tree::balance(t)) {
+    HM3_FATAL_ERROR("cannot balance the tree: node capacity {} exhausted",
+                    node_capacity);
+  }
+  if (t.size() != unbalanced_size) { tree::dfs_sort(t); }
+
+  // 5. Assign the points to their leaf nodes:
+  r.leafs.resize(no_keys);
+  parallel::for_each_static(0, no_keys, [&](int_t j) {
+    r.leafs[order[j]] = builder_t::leaf(t, keys[j]);
+  });
+  return r;
+}
+
+/// Builds the minimal 2:1 balanced tree with at most \p max_points_per_leaf
+/// points per leaf node from the \p points within \p bounding_box (see
+/// point_cloud from Morton keys)
+template <int_t Nd>
+point_cloud_tree<Nd> point_cloud(
+ tree::node_idx node_capacity, std::vector<geometry::point<Nd>> const& points,
+ geometry::square<Nd> const& bounding_box, uint_t max_points_per_leaf,
+ uint_t max_level = morton_key_levels<Nd>()) {
+  std::vector<morton_key_t> keys(points.size());
+  parallel::for_each_static(0, points.size(), [&](int_t i) {
+    keys[i] = morton_key(points[i], bounding_box);
+  });
+  return point_cloud<Nd>(node_capacity, std::move(keys), max_points_per_leaf,
+                         max_level);
+}
+
+}  // namespace generation
+}  // namespace grid
+}  // namespace hm3
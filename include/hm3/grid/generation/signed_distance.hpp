@@ -0,0 +1,210 @@
+#pragma once
+/// \file
+///
+/// Grid generation from signed-distance functions
+#include <cmath>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+#include <hm3/geometry/point.hpp>
+#include <hm3/grid/types.hpp>
+#include <hm3/tree/algorithm/balance.hpp>
+#include <hm3/tree/relations/tree.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/parallel.hpp>
+#include <hm3/utility/range.hpp>
+#include <hm3/utility/static_const.hpp>
+
+namespace hm3 {
+namespace grid {
+namespace generation {
+
+/// Nodes closer than \p distance to the surface are refined up to \p level
+struct distance_band {
+  num_t distance;
+  uint_t level;
+};
+
+/// Nodes within \p no_cells cells of level \p level from the surface are
+/// refined up to \p level
+struct cell_band {
+  uint_t no_cells;
+  uint_t level;
+};
+
+/// Distance bands of the cell bands \p bands of the grid \p g
+///
+/// The bands are stacked from the finest to the coarsest level, that is, the
+/// resulting distance bands are the same as those of
+/// amr::criterion::level_till_cell_distances.
+template <typename Grid>
+std::vector<distance_band> cell_distance_bands(
+ Grid const& g, std::initializer_list<cell_band> bands) {
+  std::vector<cell_band> cells{bands};
+  sort(cells, std::greater<>{}, &cell_band::level);
+  std::vector<distance_band> result;
+  num_t distance = 0.;
+  for (auto&& b : cells) {
+    distance += b.no_cells * g.length(level_idx{static_cast<suint_t>(b.level)});
+    result.push_back(distance_band{distance, b.level});
+  }
+  return result;
+}
+
+/// Refines the grid top-down around the surface of a signed-distance function
+///
+/// A node is refined if it is coarser than the level of a band that the node
+/// might intersect, that is, if for any band:
+///
+///   level(n) < band.level and
+///   |sd(x_n)| - lipschitz * half_diagonal(n) < band.distance
+///
+/// where x_n is the center of the node, and lipschitz is an upper bound of
+/// the Lipschitz constant of the signed-distance function (1 for an exact
+/// signed-distance function). With lipschitz = 0 the node centers are tested
+/// only, and the result is the grid to which adapting the grid with
+/// amr::criterion::level_till_cell_distances (using the same bands)
+/// converges.
+///
+/// Algorithm:
+/// 1. the leaf nodes are refined level by level until there are enough
+///    sub-trees to refine to keep all threads busy,
+/// 2. the refinement of each sub-tree is decided in parallel, without
+///    modifying the grid,
+/// 3. each sub-tree reserves the sibling groups it needs (see
+///    tree::reserve_sibling_groups), and is written in parallel (see
+///    tree::refine_into),
+/// 4. the grid is 2:1 balanced in a single pass (see tree::balance).
+///
+/// Time complexity: O(N / no_threads) evaluations of \p sd (plus O(N log(N))
+/// for the balancing).
+///
+/// \pre the grid is compact (e.g. a newly constructed or a sorted grid)
+/// \pre \p sd can be called concurrently
+/// \pre grid.refine does not balance the grid by itself (i.e. to generate a
+/// multi grid, generate its tree grid and construct the multi grid from it)
+struct signed_distance_fn {
+ private:
+  /// Appends the refinement decisions of the sub-tree of the node at \p x and
+  /// level \p l to \p decisions in depth-first order
+  template <typename Grid, typename Pred, typename Point>
+  static void decide(Grid const& g, Pred const& refine_node, Point const& x,
+                     level_idx l, std::vector<bool>& decisions) {
+    const bool refine = refine_node(x, l);
+    decisions.push_back(refine);
+    if (!refine) { return; }
+    const auto l_c = level_idx{*l + 1};
+    const auto d_c = g.length(l_c) * num_t{0.5};
+    for (auto&& p : Grid::child_positions()) {
+      const auto rcp = tree::relative_child_position<Grid::dimension()>(p);
+      Point x_c      = x;
+      for (auto&& d : g.dimensions()) { x_c(d) += rcp[d] * d_c; }
+      decide(g, refine_node, x_c, l_c, decisions);
+    }
+  }
+
+  /// Balances the grid \p g (see tree::balance)
+  template <typename Grid> static void balance(Grid& g) {
+    if (!tree::balance(g)) {
+      HM3_FATAL_ERROR("cannot balance the grid: grid capacity {} exhausted",
+                      g.capacity());
+    }
+  }
+
+  /// Refines the sub-tree of node \p n from its refinement \p decisions into
+  /// the reserved sibling groups starting at \p s
+  template <typename Grid>
+  static void write(Grid& g, tree_node_idx n,
+                    std::vector<bool> const& decisions, std::size_t& i,
+                    idx_t& s) {
+    if (!decisions[i++]) { return; }
+    g.refine_into(n, siblings_idx{s++});
+    for (auto&& c : g.children(n)) { write(g, c, decisions, i, s); }
+  }
+
+ public:
+  template <typename Grid, typename SD>
+  void operator()(Grid& g, SD const& sd,
+                  std::vector<distance_band> const& bands,
+                  num_t lipschitz) const {
+    constexpr uint_t nd = Grid::dimension();
+    using point_t       = geometry::point<nd>;
+    HM3_ASSERT(g.is_compact(), "the grid must be compact");
+
+    auto refine_node = [&](point_t const& x, level_idx l) {
+      const num_t half_diagonal
+       = num_t{0.5} * std::sqrt(num_t(nd)) * g.length(l);
+      const num_t distance = std::abs(sd(x)) - lipschitz * half_diagonal;
+      return any_of(bands, [&](auto&& b) {
+        return *l < b.level and distance < b.distance;
+      });
+    };
+    auto refine_leaf = [&](tree_node_idx n) {
+      return refine_node(g.coordinates(n), g.level(n));
+    };
+    auto assert_refined = [&](tree_node_idx n) {
+      if (g.is_leaf(n)) {
+        HM3_FATAL_ERROR("cannot refine node {}: grid capacity {} exhausted", n,
+                        g.capacity());
+      }
+    };
+
+    // 1. Refine level by level until there are enough sub-trees:
+    std::vector<tree_node_idx> sub_trees;
+    RANGES_FOR (auto&& n, g.nodes() | g.leaf()) {
+      if (refine_leaf(n)) { sub_trees.push_back(n); }
+    }
+    const std::size_t min_no_sub_trees = 8 * parallel::no_threads();
+    while (!sub_trees.empty() and sub_trees.size() < min_no_sub_trees) {
+      std::vector<tree_node_idx> next;
+      for (auto&& n : sub_trees) {
+        g.refine(n);
+        assert_refined(n);
+        for (auto&& c : g.children(n)) {
+          if (refine_leaf(c)) { next.push_back(c); }
+        }
+      }
+      sub_trees = std::move(next);
+    }
+    if (sub_trees.empty()) { return balance(g); }
+
+    // 2. Decide the refinement of each sub-tree in parallel:
+    const idx_t no_sub_trees = sub_trees.size();
+    std::vector<std::vector<bool>> decisions(no_sub_trees);
+    parallel::for_each(0, no_sub_trees, [&](int_t i) {
+      const auto n = sub_trees[i];
+      decide(g, refine_node, g.coordinates(n), g.level(n), decisions[i]);
+    });
+
+    // 3. Reserve the sibling groups of each sub-tree:
+    std::vector<idx_t> first_sg(no_sub_trees + 1, 0);
+    for (idx_t i = 0; i != no_sub_trees; ++i) {
+      first_sg[i + 1] = first_sg[i] + count(decisions[i], true);
+    }
+    const idx_t no_sgs = first_sg.back();
+    if (*g.size() + no_sgs * g.no_children() > *g.capacity()) {
+      HM3_FATAL_ERROR("cannot refine {} nodes: grid size {}, capacity {}",
+                      no_sgs, g.size(), g.capacity());
+    }
+    const idx_t s = *g.reserve_sibling_groups(no_sgs);
+
+    // ... and write them in parallel:
+    parallel::for_each(0, no_sub_trees, [&](int_t i) {
+      std::size_t d = 0;
+      idx_t sg      = s + first_sg[i];
+      write(g, sub_trees[i], decisions[i], d, sg);
+    });
+    if (g.has_hashes()) { g.enable_hashes(); }  // recompute the hashes
+
+    // 4. Balance the grid:
+    balance(g);
+  }
+};
+
+namespace {
+auto&& signed_distance = static_const<signed_distance_fn>::value;
+}  // namespace
+
+}  // namespace generation
+}  // namespace grid
+}  // namespace hm3
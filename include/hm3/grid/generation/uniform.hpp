@@ -12,9 +12,17 @@ namespace grid {
 namespace generation {
 
 /// Refines the grid until all the leaf nodes are at the target level
+///
+/// If the grid only contains its root node, the uniform grid is constructed
+/// directly (see tree::refine_uniformly), and is compact and sorted.
+/// Otherwise, the leaf nodes are refined level by level.
 struct uniform_fn {
   template <typename TreeGrid>
   auto operator()(TreeGrid& tree, const uint_t target_level) const noexcept {
+    if (tree.size() == tree_node_idx{1}) {
+      tree.refine_uniformly(level_idx{static_cast<suint_t>(target_level)});
+      return;
+    }
     uint_t level = 0;
     generic(
      [&]() {
@@ -9,7 +9,12 @@ namespace hm3 {
 namespace grid {
 
 /// Multi hierarchical Cartesian Grid
-template <uint_t Nd> using mhc = hc::multi<Nd>;
+template <uint_t Nd, typename Idx = idx_t> using mhc = hc::multi<Nd, Idx>;
+
+/// Multi hierarchical Cartesian forest (see hc::forest)
+template <uint_t Nd, typename Idx = idx_t>
+using mhc_forest
+ = hc::multi<Nd, Idx, adaptor::dense_membership<Idx>, hc::forest<Nd, Idx>>;
 
 }  // namespace grid
 }  // namespace hm3
@@ -47,6 +47,11 @@ multi_amr_target<Nd> make_amr_target(multi<Nd>& g) noexcept {
   return multi_amr_target<Nd>(g);
 };
 
+/// Logs the structure statistics of the grid after it has been adapted
+template <uint_t Nd> void after_adapt(multi_amr_target<Nd>& t) {
+  t.g_->log_stats();
+}
+
 }  // namespace hc
 
 }  // namespace grid
@@ -0,0 +1,290 @@
+#pragma once
+/// \file
+///
+/// Forest of hierarchical Cartesian grids
+#include <algorithm>
+#include <array>
+#include <hm3/grid/hc/single.hpp>
+#include <hm3/tree/algorithm/node_level.hpp>
+#include <hm3/tree/algorithm/node_location.hpp>
+#include <hm3/tree/algorithm/node_neighbors.hpp>
+
+namespace hm3 {
+namespace grid {
+namespace hc {
+
+/// Forest of hierarchical Cartesian grids
+///
+/// A brick of no_roots[0] x ... x no_roots[Nd - 1] root nodes of equal length
+/// that share a single node pool. This covers non-cubic domains (e.g. a
+/// channel with aspect ratio 8:1:1) without the root cube of a single grid,
+/// most of which would lie outside the domain.
+///
+/// The roots are the nodes at root_level() of a single tree whose root cube
+/// covers the brick. The nodes above the roots (and their children outside
+/// the brick) are created once on construction, and are never refined nor
+/// coarsened. That is, the number of wasted nodes is at most
+/// O(no_children * root_level * no_roots) and does not grow with refinement.
+///
+/// Since the brick is embedded in a single tree:
+/// - neighbor queries cross the boundaries between the roots (the root
+///   connectivity follows from the location of the roots within the tree),
+/// - depth-first sorting orders the nodes of the whole forest along the
+///   Morton space-filling curve (the roots are sorted in Morton order).
+///
+/// Levels are those of the shared tree (the roots are at root_level()).
+///
+/// The node indices are stored using the integer type \p Idx (see
+/// tree::tree).
+template <uint_t Nd, typename Idx = idx_t>  //
+struct forest : single<Nd, Idx> {
+  using single_t           = single<Nd, Idx>;
+  using tree_t             = typename single_t::tree_t;
+  using point_t            = typename single_t::point_t;
+  using root_coordinates_t = std::array<uint_t, Nd>;
+  using neighbor_offset_t  = std::array<int_t, Nd>;
+
+  /// Number of roots along each spatial dimension
+  root_coordinates_t no_roots_{};
+
+  using single_t::dimension;
+  using single_t::dimensions;
+  using single_t::bounding_box;
+
+  forest() = default;
+  forest(forest const&) = default;
+  forest(forest&&) = default;
+  forest& operator=(forest const&) = default;
+  forest& operator=(forest&&) = default;
+
+  /// Forest with \p no_roots roots of length \p root_length whose minimum
+  /// corner is at \p x_min
+  forest(tree_node_idx node_capacity, point_t x_min, num_t root_length,
+         root_coordinates_t no_roots)
+   : single_t(node_capacity, root_cube(x_min, root_length, no_roots))
+   , no_roots_(no_roots) {
+    initialize_roots(0_n, root_coordinates_t{}, 0_l);
+  }
+
+  /// Forest with \p no_roots roots from a grid \p g whose nodes above the
+  /// roots have already been refined (e.g. read from a file)
+  forest(root_coordinates_t no_roots, single_t g)
+   : single_t(std::move(g)), no_roots_(no_roots) {}
+
+ private:
+  /// Level of the roots of the brick \p no_roots
+  static level_idx root_level(root_coordinates_t const& no_roots) noexcept {
+    const uint_t n = *std::max_element(begin(no_roots), end(no_roots));
+    uint_t l       = 0;
+    while ((uint_t{1} << l) < n) { ++l; }
+    return level_idx{l};
+  }
+
+  /// Root node geometry of the tree containing the brick
+  static geometry::square<Nd> root_cube(point_t x_min, num_t root_length,
+                                        root_coordinates_t no_roots) {
+    const num_t length = root_length * (uint_t{1} << *root_level(no_roots));
+    return {point_t{x_min() + point_t::c(0.5 * length)}, length};
+  }
+
+  /// Does the node at level \p l with coordinates \p x (at level \p l)
+  /// intersect the brick?
+  bool intersects_brick(root_coordinates_t const& x, level_idx l) const
+   noexcept {
+    const auto shift = *(root_level() - l);
+    for (auto&& d : dimensions()) {
+      if ((x[d] << shift) >= no_roots_[d]) { return false; }
+    }
+    return true;
+  }
+
+  /// Refines the nodes above the roots that intersect the brick
+  void initialize_roots(tree_node_idx n, root_coordinates_t x, level_idx l) {
+    if (l == root_level() or !intersects_brick(x, l)) { return; }
+    auto s = single_t::refine(n);
+    HM3_ASSERT(s, "node capacity {} is too small for a forest of {} roots",
+               tree_t::capacity(), no_total_roots());
+    for (auto&& p : tree_t::child_positions()) {
+      root_coordinates_t xc;
+      for (auto&& d : dimensions()) { xc[d] = 2 * x[d] + ((*p >> d) & 1); }
+      initialize_roots(tree_t::child(n, p), xc, l + 1);
+    }
+  }
+
+ public:
+  /// Number of roots along each spatial dimension
+  root_coordinates_t no_roots() const noexcept { return no_roots_; }
+
+  /// Total number of roots
+  uint_t no_total_roots() const noexcept {
+    uint_t r = 1;
+    for (auto&& d : dimensions()) { r *= no_roots_[d]; }
+    return r;
+  }
+
+  /// Level of the roots within the tree
+  level_idx root_level() const noexcept { return root_level(no_roots_); }
+
+  /// Length of the roots
+  num_t root_length() const noexcept {
+    return single_t::length(root_level());
+  }
+
+  /// Minimum corner of the brick
+  point_t x_min() const noexcept {
+    return geometry::bounds(bounding_box()).min;
+  }
+
+  /// Maximum corner of the brick
+  point_t x_max() const noexcept {
+    point_t x = x_min();
+    for (auto&& d : dimensions()) { x(d) += no_roots_[d] * root_length(); }
+    return x;
+  }
+
+  /// Coordinates within the brick of the root of node \p n
+  ///
+  /// \pre level(n) >= root_level()
+  root_coordinates_t root_coordinates(tree_node_idx n) const noexcept {
+    HM3_ASSERT(single_t::level(n) >= root_level(),
+               "node {} is above the roots of the forest", n);
+    const auto loc = tree::node_location(*this, n);
+    root_coordinates_t x{};
+    for (level_idx l = 1_l; l <= root_level(); ++l) {
+      const uint_t p = loc[l];
+      for (auto&& d : dimensions()) { x[d] = 2 * x[d] + ((p >> d) & 1); }
+    }
+    return x;
+  }
+
+  /// Is node \p n inside the brick? (That is, is it a root or a descendant of
+  /// a root?)
+  bool in_domain(tree_node_idx n) const noexcept {
+    if (single_t::level(n) < root_level()) { return false; }
+    return intersects_brick(root_coordinates(n), root_level());
+  }
+
+  /// Range filter that selects nodes inside the brick
+  auto in_domain() const noexcept {
+    return view::filter([&](tree_node_idx n) { return in_domain(n); });
+  }
+
+  /// Is node \p n a root of the forest?
+  bool is_tree_root(tree_node_idx n) const noexcept {
+    return single_t::level(n) == root_level() and in_domain(n);
+  }
+
+  /// Root of node \p n
+  ///
+  /// \pre in_domain(n)
+  tree_node_idx root(tree_node_idx n) const noexcept {
+    HM3_ASSERT(in_domain(n), "node {} is outside the forest", n);
+    for (auto l = *single_t::level(n); l != *root_level(); --l) {
+      n = tree_t::parent(n);
+    }
+    return n;
+  }
+
+  /// Root at coordinates \p x within the brick (invalid if \p x is outside the
+  /// brick)
+  tree_node_idx root_at(root_coordinates_t const& x) const noexcept {
+    if (!intersects_brick(x, root_level())) { return tree_node_idx{}; }
+    tree_node_idx n = 0_n;
+    for (auto l = *root_level(); l > 0; --l) {
+      uint_t p = 0;
+      for (auto&& d : dimensions()) { p |= ((x[d] >> (l - 1)) & 1) << d; }
+      n = tree_t::child(n, typename tree_t::child_pos{p});
+    }
+    return n;
+  }
+
+  /// Root at offset \p o from the root \p r (invalid if it lies outside the
+  /// brick)
+  ///
+  /// \pre is_tree_root(r)
+  tree_node_idx root_neighbor(tree_node_idx r, neighbor_offset_t o) const
+   noexcept {
+    HM3_ASSERT(is_tree_root(r), "node {} is not a root", r);
+    auto x = root_coordinates(r);
+    for (auto&& d : dimensions()) {
+      const int_t xd = static_cast<int_t>(x[d]) + o[d];
+      if (xd < 0) { return tree_node_idx{}; }
+      x[d] = xd;
+    }
+    return root_at(x);
+  }
+
+  /// Roots of the forest (in memory order, i.e., in Morton order if the
+  /// forest is sorted)
+  auto roots() const noexcept {
+    return tree_t::nodes()
+           | view::filter([&](tree_node_idx n) { return is_tree_root(n); });
+  }
+
+  /// Refines node \p n (if it is inside the brick)
+  ///
+  /// \returns sibling group of the children (empty if \p n is outside of the
+  /// brick or if refinement failed).
+  siblings_idx refine(tree_node_idx n) noexcept {
+    this->assert_node_in_use(n, HM3_AT_);
+    return in_domain(n) ? single_t::refine(n) : siblings_idx{};
+  }
+
+  /// Refines node \p n into the reserved sibling group \p s (see
+  /// single::refine_into)
+  ///
+  /// \pre \p n is inside the brick
+  void refine_into(tree_node_idx n, siblings_idx s) noexcept {
+    HM3_ASSERT(in_domain(n), "node {} is outside of the brick", n);
+    single_t::refine_into(n, s);
+  }
+
+  /// Coarsens node \p n (if it is inside the brick)
+  ///
+  /// The nodes above the roots are never coarsened.
+  void coarsen(tree_node_idx n) noexcept {
+    this->assert_node_in_use(n, HM3_AT_);
+    if (in_domain(n)) { single_t::coarsen(n); }
+  }
+
+  /// All neighbors (across all manifolds) of node \p n inside the brick
+  inline auto neighbors(tree_node_idx n) const noexcept {
+    this->assert_node_in_use(n, HM3_AT_);
+    return tree::node_neighbors(
+     *this, tree::node_location(*this, n),
+     [&](tree_node_idx i) { return in_domain(i); });
+  }
+
+  /// All neighbors across \p manifold of node \p n inside the brick
+  template <typename Manifold>
+  inline auto neighbors(tree_node_idx n, Manifold manifold) const noexcept {
+    this->assert_node_in_use(n, HM3_AT_);
+    return tree::node_neighbors(
+     manifold, *this, tree::node_location(*this, n),
+     [&](tree_node_idx i) { return in_domain(i); });
+  }
+};
+
+template <uint_t Nd, typename Idx>
+bool operator==(forest<Nd, Idx> const& a, forest<Nd, Idx> const& b) noexcept {
+  using single_t = single<Nd, Idx> const&;
+  return a.no_roots() == b.no_roots()
+         && static_cast<single_t>(a) == static_cast<single_t>(b);
+}
+
+template <uint_t Nd, typename Idx>
+bool operator!=(forest<Nd, Idx> const& a, forest<Nd, Idx> const& b) noexcept {
+  return !(a == b);
+}
+
+template <uint_t Nd, typename Idx> string type(forest<Nd, Idx> const&) {
+  return "hierarchical_cartesian_forest";
+}
+
+template <uint_t Nd, typename Idx> string name(forest<Nd, Idx> const&) {
+  return type(forest<Nd, Idx>{}) + "_" + std::to_string(Nd) + "D";
+}
+
+}  // namespace hc
+}  // namespace grid
+}  // namespace hm3
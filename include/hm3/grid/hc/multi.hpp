@@ -2,7 +2,9 @@
 /// \file
 ///
 /// Multiple hierarchical Cartesian Grids
+#include <hm3/grid/hc/forest.hpp>
 #include <hm3/grid/hc/single.hpp>
+#include <hm3/grid/hc/serialization/forest_fio.hpp>
 #include <hm3/grid/hc/serialization/single_fio.hpp>
 #include <hm3/grid/adaptor/multi.hpp>
 #include <hm3/grid/adaptor/serialization/multi_fio.hpp>
@@ -14,9 +16,17 @@ namespace hc {
 
 /// Multiple hierarchical Cartesian Grids
 ///
+/// The node indices are stored using the integer type \p Idx (see
+/// tree::tree), and the grid membership of the nodes using the layout
+/// \p Membership (see adaptor::multi).
 ///
-template <uint_t Nd> struct multi : adaptor::multi<single<Nd>> {
-  using base_t = adaptor::multi<single<Nd>>;
+/// The grids are stored in the tree grid \p TreeGrid: a single hierarchical
+/// Cartesian grid (default), or a forest of them (see hc::forest).
+template <uint_t Nd, typename Idx = idx_t,
+          typename Membership = adaptor::dense_membership<Idx>,
+          typename TreeGrid   = single<Nd, Idx>>
+struct multi : adaptor::multi<TreeGrid, Membership> {
+  using base_t = adaptor::multi<TreeGrid, Membership>;
   io::client io_;
   hm3::log::serial log;
 
@@ -32,40 +42,68 @@ template <uint_t Nd> struct multi : adaptor::multi<single<Nd>> {
         this->capacity(), this->no_grids(), this->bounding_box(), this->size());
   }
   multi(io::session& s, tree_node_idx node_capacity, grid_idx grid_capacity,
-        geometry::square<Nd> bounding_box)
-   : multi(s, base_t(node_capacity, grid_capacity, std::move(bounding_box))) {}
+        geometry::square<Nd> bounding_box,
+        std::array<bool, Nd> periodicity = std::array<bool, Nd>{})
+   : multi(s, base_t(node_capacity, grid_capacity, std::move(bounding_box),
+                     periodicity)) {}
 
   bool is_sorted() const noexcept { return ::hm3::tree::dfs_sort.is(*this); }
 
-  auto write() {
+  /// Logs the structure statistics \p s of the grid (see stats)
+  void log_stats(tree::statistics const& s) const {
+    log("Structure statistics:\n{}\n", to_json(s).dump(2));
+  }
+
+  /// Logs the structure statistics of the grid
+  void log_stats() const { log_stats(this->stats()); }
+
+  /// File containing the grid (not written yet, see solver::write)
+  io::file unwritten_file() const {
     HM3_ASSERT(is_sorted(), "cannot write unsorted grid");
     auto f = io_.new_file();
     to_file_unwritten(f, static_cast<base_t const&>(*this));
+    return f;
+  }
+
+  auto write() {
+    auto f = unwritten_file();
     io_.write(f);
   }
 
-  static multi<Nd> from_session(io::session& s, string const& type_,
-                                string const& name_,
-                                io::file::index_t i = io::file::index_t{},
-                                tree_node_idx node_capacity = tree_node_idx{},
-                                grid_idx grid_capacity = grid_idx{}) {
+  /// Single grid spanning the unit cube from the tree \p t
+  static single<Nd, Idx> from_tree(single<Nd, Idx> const&,
+                                   tree::tree<Nd, Idx>&& t) {
+    return single<Nd, Idx>{geometry::square<Nd>::unit(), std::move(t)};
+  }
+
+  /// A tree does not store the roots of a forest
+  template <typename G>
+  static G from_tree(G const& g, tree::tree<Nd, Idx>&&) {
+    HM3_FATAL_ERROR("Cannot read a tree into a grid::hc::multi of {}",
+                    type(g));
+  }
+
+  static multi from_session(io::session& s, string const& type_,
+                            string const& name_,
+                            io::file::index_t i = io::file::index_t{},
+                            tree_node_idx node_capacity = tree_node_idx{},
+                            grid_idx grid_capacity = grid_idx{}) {
     io::client c(s, name_, type_);
     auto f = c.get_file(i);
 
     if (type_ == type(base_t{})) {
       auto d = from_file(base_t{}, f, node_capacity, grid_capacity);
-      return multi<Nd>{s, std::move(d)};
+      return multi{s, std::move(d)};
     }
 
-    if (type_ == type(single<Nd>{})) {
-      auto d = from_file(single<Nd>{}, f, node_capacity);
-      return multi<Nd>{s, base_t{0, std::move(d)}};
+    if (type_ == type(TreeGrid{})) {
+      auto d = from_file(TreeGrid{}, f, node_capacity);
+      return multi{s, base_t{0, std::move(d)}};
     }
 
-    if (type_ == type(tree::tree<Nd>{})) {
-      auto d = from_file(tree::tree<Nd>{}, f, node_capacity);
-      return multi<Nd>{
-       s, base_t{0, single<Nd>{geometry::square<Nd>::unit(), std::move(d)}}};
+    if (type_ == type(tree::tree<Nd, Idx>{})) {
+      auto d = from_file(tree::tree<Nd, Idx>{}, f, node_capacity);
+      return multi{s, base_t{0, from_tree(TreeGrid{}, std::move(d))}};
     }
 
     HM3_FATAL_ERROR(
@@ -74,22 +112,26 @@ template <uint_t Nd> struct multi : adaptor::multi<single<Nd>> {
   }
 };
 
-template <uint_t Nd> string name(multi<Nd>) {
-  return name(typename multi<Nd>::base_t{});
+template <uint_t Nd, typename Idx, typename Membership, typename TreeGrid>
+string name(multi<Nd, Idx, Membership, TreeGrid>) {
+  return name(typename multi<Nd, Idx, Membership, TreeGrid>::base_t{});
 }
 
-template <uint_t Nd> string type(multi<Nd>) {
-  return type(typename multi<Nd>::base_t{});
+template <uint_t Nd, typename Idx, typename Membership, typename TreeGrid>
+string type(multi<Nd, Idx, Membership, TreeGrid>) {
+  return type(typename multi<Nd, Idx, Membership, TreeGrid>::base_t{});
 }
 
-template <uint_t Nd>
-bool operator==(multi<Nd> const& a, multi<Nd> const& b) noexcept {
-  using base_t = typename multi<Nd>::base_t const&;
+template <uint_t Nd, typename Idx, typename Membership, typename TreeGrid>
+bool operator==(multi<Nd, Idx, Membership, TreeGrid> const& a,
+                multi<Nd, Idx, Membership, TreeGrid> const& b) noexcept {
+  using base_t = typename multi<Nd, Idx, Membership, TreeGrid>::base_t const&;
   return static_cast<base_t>(a) == static_cast<base_t>(b);
 }
 
-template <uint_t Nd>
-bool operator!=(multi<Nd> const& a, multi<Nd> const& b) noexcept {
+template <uint_t Nd, typename Idx, typename Membership, typename TreeGrid>
+bool operator!=(multi<Nd, Idx, Membership, TreeGrid> const& a,
+                multi<Nd, Idx, Membership, TreeGrid> const& b) noexcept {
   return !(a == b);
 }
 
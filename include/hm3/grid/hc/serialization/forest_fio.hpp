@@ -0,0 +1,52 @@
+#pragma once
+/// \file
+///
+/// Serialization of forest of hierarchical Cartesian grids to HM3's File I/O
+#include <hm3/grid/hc/forest.hpp>
+#include <hm3/grid/hc/serialization/single_fio.hpp>
+
+namespace hm3 {
+namespace grid {
+namespace hc {
+
+/// Returns a yet to be read forest from a file descriptor \p f
+template <uint_t Nd, typename Idx>
+forest<Nd, Idx> from_file_unread(forest<Nd, Idx> const&, io::file& f,
+                                 tree_node_idx node_capacity) {
+  using root_coordinates_t = typename forest<Nd, Idx>::root_coordinates_t;
+  const auto no_roots      = f.constant("no_roots", std::vector<uint_t>{});
+  HM3_ASSERT(no_roots.size() == Nd, "forest with {} dimensions in a file with "
+                                    "{} dimensions",
+             Nd, no_roots.size());
+  root_coordinates_t n;
+  for (auto&& d : dimensions(Nd)) { n[d] = no_roots[d]; }
+
+  forest<Nd, Idx> g(n,
+                    from_file_unread(single<Nd, Idx>{}, f, node_capacity));
+  // Move the forest out of the function:
+  static_assert(std::is_move_constructible<forest<Nd, Idx>>{},
+                "if the forest is not move constructible mapping the arrays "
+                "fails (they will be mapped to the wrong addresses in memory)");
+  return g;
+}
+
+/// Reads forest from file descriptor \p f
+template <uint_t Nd, typename Idx>
+forest<Nd, Idx> from_file(forest<Nd, Idx> const&, io::file& f,
+                          tree_node_idx node_capacity = tree_node_idx{}) {
+  auto&& g = from_file_unread(forest<Nd, Idx>{}, f, node_capacity);
+  f.read_arrays();
+  return g;
+}
+
+/// Appends constants and map arrays to file \p f
+template <uint_t Nd, typename Idx>
+void to_file_unwritten(io::file& f, forest<Nd, Idx> const& g) {
+  to_file_unwritten(f, static_cast<single<Nd, Idx> const&>(g));
+  const auto no_roots = g.no_roots();
+  f.field("no_roots", std::vector<uint_t>(begin(no_roots), end(no_roots)));
+}
+
+}  // namespace hc
+}  // namespace grid
+}  // namespace hm3
@@ -10,36 +10,49 @@ namespace grid {
 namespace hc {
 
 /// Returns a yet to be read grid from a file descriptor \p f
-template <uint_t Nd>
-single<Nd> from_file_unread(single<Nd> const&, io::file& f,
-                            tree_node_idx node_capacity) {
+template <uint_t Nd, typename Idx>
+single<Nd, Idx> from_file_unread(single<Nd, Idx> const&, io::file& f,
+                                 tree_node_idx node_capacity) {
   auto root_node
    = geometry::square<Nd>{f.constant("root_node_center", geometry::point<Nd>{}),
                           f.constant("root_node_length", num_t{})};
 
-  single<Nd> g(root_node,
-               from_file_unread<Nd>(tree::tree<Nd>{}, f, node_capacity));
+  // Grids written without periodicity are not periodic:
+  typename single<Nd, Idx>::periodicity_t periodicity{};
+  if (f.has_field("periodicity")) {
+    const auto p = f.constant("periodicity", std::vector<uint_t>{});
+    HM3_ASSERT(p.size() == Nd, "periodicity of {} dimensions in a {}D grid",
+               p.size(), Nd);
+    for (auto&& d : dimensions(Nd)) { periodicity[d] = p[d] != 0; }
+  }
+
+  single<Nd, Idx> g(
+   root_node, from_file_unread(tree::tree<Nd, Idx>{}, f, node_capacity),
+   periodicity);
   // Move the grid hierarchical Cartesian grid out of the function:
-  static_assert(std::is_move_constructible<single<Nd>>{},
+  static_assert(std::is_move_constructible<single<Nd, Idx>>{},
                 "if the grid is not move constructible mapping the arrays "
                 "fails (they will be mapped to the wrong addresses in memory)");
   return g;
 }
 
 /// Reads grid from file descriptor \p f
-template <uint_t Nd>
-single<Nd> from_file(single<Nd> const&, io::file& f,
-                     tree_node_idx node_capacity = tree_node_idx{}) {
-  auto&& g = from_file_unread<Nd>(single<Nd>{}, f, node_capacity);
+template <uint_t Nd, typename Idx>
+single<Nd, Idx> from_file(single<Nd, Idx> const&, io::file& f,
+                          tree_node_idx node_capacity = tree_node_idx{}) {
+  auto&& g = from_file_unread(single<Nd, Idx>{}, f, node_capacity);
   f.read_arrays();
   return g;
 }
 
 /// Appends constants and map arrays to file \p f
-template <uint_t Nd> void to_file_unwritten(io::file& f, single<Nd> const& g) {
-  to_file_unwritten(f, static_cast<tree::tree<Nd> const&>(g));
+template <uint_t Nd, typename Idx>
+void to_file_unwritten(io::file& f, single<Nd, Idx> const& g) {
+  to_file_unwritten(f, static_cast<tree::tree<Nd, Idx> const&>(g));
   f.field("root_node_center", geometry::point<Nd>{center(g.bounding_box())})
    .field("root_node_length", geometry::length(g.bounding_box()));
+  const auto p = g.periodicity();
+  f.field("periodicity", std::vector<uint_t>(begin(p), end(p)));
 }
 
 }  // namespace hc
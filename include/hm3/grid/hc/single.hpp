@@ -2,11 +2,17 @@
 /// \file
 ///
 /// Single hierarchical Cartesian grid
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
 #include <hm3/tree/tree.hpp>
 #include <hm3/tree/algorithm/node_level.hpp>
 #include <hm3/tree/algorithm/node_neighbors.hpp>
 #include <hm3/tree/algorithm/normalized_coordinates.hpp>
 #include <hm3/grid/hc/node.hpp>
+#include <hm3/utility/parallel.hpp>
 
 namespace hm3 {
 namespace grid {
@@ -15,13 +21,31 @@ namespace grid {
 namespace hc {
 
 /// Hierarchical Cartesian grid
-template <uint_t Nd>  //
-struct single : tree::tree<Nd> {
-  using tree_t                  = tree::tree<Nd>;
+///
+/// The grid can be periodic along any of its spatial dimensions: neighbor
+/// queries (and the 2:1 balancing of the refinement and coarsening
+/// algorithms) wrap around the periodic dimensions, such that the nodes at
+/// one boundary are the neighbors of the nodes at the opposite boundary.
+///
+/// The node geometry can (optionally) be cached (see enable_geometry_cache).
+///
+/// The tree node indices are stored using the integer type \p Idx (see
+/// tree::tree).
+template <uint_t Nd, typename Idx = idx_t>  //
+struct single : tree::tree<Nd, Idx> {
+  using tree_t                  = tree::tree<Nd, Idx>;
   using node_geometry_t         = geometry::square<Nd>;
   using point_t                 = geometry::point<Nd>;
   using node_t                  = node<Nd>;
+  using periodicity_t           = std::array<bool, Nd>;
   node_geometry_t bounding_box_ = {point_t::constant(0.5), 1.};
+  /// Is the grid periodic along each spatial dimension?
+  periodicity_t periodicity_{};
+  /// Cached center coordinates of each node (optional: one array of capacity
+  /// coordinates per spatial dimension, see enable_geometry_cache)
+  std::vector<num_t> cached_centers_;
+  /// Cached level of each node (optional: 1 byte / node)
+  std::vector<std::uint8_t> cached_levels_;
 
   using tree_t::dimension;
   using tree_t::dimensions;
@@ -32,14 +56,29 @@ struct single : tree::tree<Nd> {
   single& operator=(single const&) = default;
   single& operator=(single&&) = default;
 
-  single(tree_node_idx node_capacity, node_geometry_t bounding_box)
-   : tree_t(std::move(node_capacity)), bounding_box_(std::move(bounding_box)) {}
-  single(node_geometry_t bounding_box, tree_t tree_)
-   : tree_t(std::move(tree_)), bounding_box_(std::move(bounding_box)) {}
+  single(tree_node_idx node_capacity, node_geometry_t bounding_box,
+         periodicity_t periodicity = periodicity_t{})
+   : tree_t(std::move(node_capacity))
+   , bounding_box_(std::move(bounding_box))
+   , periodicity_(periodicity) {}
+  single(node_geometry_t bounding_box, tree_t tree_,
+         periodicity_t periodicity = periodicity_t{})
+   : tree_t(std::move(tree_))
+   , bounding_box_(std::move(bounding_box))
+   , periodicity_(periodicity) {}
 
   /// Bounding box of the grid (root node geometry)
   auto bounding_box() const noexcept { return bounding_box_; }
 
+  /// Is the grid periodic along each spatial dimension?
+  periodicity_t periodicity() const noexcept { return periodicity_; }
+
+  /// Is the grid periodic along the spatial dimension \p d?
+  bool is_periodic(uint_t d) const noexcept {
+    HM3_ASSERT(d < Nd, "dimension {} out-of-bounds [0, {})", d, Nd);
+    return periodicity_[d];
+  }
+
  protected:
   template <typename At>
   void assert_node_in_bounds(tree_node_idx n, At&& at) const noexcept {
@@ -55,6 +94,152 @@ struct single : tree::tree<Nd> {
   }
 
  public:
+  /// \name Geometry cache
+  ///
+  /// Stores the center coordinates and the level of each node in
+  /// structure-of-arrays form: one contiguous array of coordinates per spatial
+  /// dimension and one byte per node for the level. When enabled,
+  /// coordinates, length, level, node, and geometry are O(1) instead of
+  /// O(log(N)), and kernels can stream the arrays directly (see
+  /// cached_centers and cached_levels).
+  ///
+  /// The cache is kept valid on refine, coarsen, and swap (and thus sort).
+  ///
+  /// Memory requirements: Nd words + 1 byte per node.
+  ///
+  ///@{
+
+  /// Is the geometry cache enabled?
+  bool has_geometry_cache() const noexcept { return !cached_levels_.empty(); }
+
+  /// Enables the geometry cache and fills it in one parallel pass over the
+  /// nodes
+  ///
+  /// Time complexity: O(N log(N)) work, O(N log(N) / no_threads) time
+  void enable_geometry_cache() {
+    const idx_t cap = *tree_t::capacity();
+    cached_centers_.assign(Nd * cap, num_t{0});
+    cached_levels_.assign(cap, std::uint8_t{0});
+    parallel::for_each(0, cap, [&](idx_t i) {
+      const tree_node_idx n{i};
+      if (tree_t::is_free(n)) { return; }
+      cache_geometry(n, compute_coordinates(n), compute_level(n));
+    });
+  }
+
+  /// Disables the geometry cache (and releases its memory)
+  void disable_geometry_cache() noexcept {
+    std::vector<num_t>{}.swap(cached_centers_);
+    std::vector<std::uint8_t>{}.swap(cached_levels_);
+  }
+
+  /// Contiguous array of the center coordinates along dimension \p d of all
+  /// nodes (the values of free nodes are unspecified)
+  ///
+  /// \pre has_geometry_cache()
+  num_t const* cached_centers(uint_t d) const noexcept {
+    HM3_ASSERT(has_geometry_cache(), "the geometry cache is not enabled");
+    HM3_ASSERT(d < Nd, "dimension {} out-of-bounds [0, {})", d, Nd);
+    return cached_centers_.data() + d * *tree_t::capacity();
+  }
+
+  /// Contiguous array of the level of all nodes (the values of free nodes are
+  /// unspecified)
+  ///
+  /// \pre has_geometry_cache()
+  std::uint8_t const* cached_levels() const noexcept {
+    HM3_ASSERT(has_geometry_cache(), "the geometry cache is not enabled");
+    return cached_levels_.data();
+  }
+
+ private:
+  /// Stores the center coordinates \p x and the level \p l of node \p n in
+  /// the cache
+  void cache_geometry(tree_node_idx n, point_t const& x, level_idx l) noexcept {
+    const idx_t cap = *tree_t::capacity();
+    for (auto&& d : dimensions()) { cached_centers_[d * cap + *n] = x(d); }
+    HM3_ASSERT(*l <= std::numeric_limits<std::uint8_t>::max(),
+               "level {} does not fit in the geometry cache", l);
+    cached_levels_[*n] = static_cast<std::uint8_t>(*l);
+  }
+
+  /// Center coordinates of node \p n (uncached)
+  point_t compute_coordinates(tree_node_idx n) const noexcept {
+    auto xs = tree::normalized_coordinates(*this, n);
+    return point_t{geometry::length(bounding_box()) * xs()};
+  }
+
+  /// Level of node \p n (uncached)
+  level_idx compute_level(tree_node_idx n) const noexcept {
+    return tree::node_level(*this, n);
+  }
+
+ public:
+  /// Refines node \p n (see tree::refine) updating the geometry cache
+  siblings_idx refine(tree_node_idx n) noexcept {
+    const auto s = tree_t::refine(n);
+    if (!s or !has_geometry_cache()) { return s; }
+    const auto x_p = coordinates(n);
+    const auto l_c = level_idx{*level(n) + 1};
+    const auto d_c = length(l_c) * num_t{0.5};
+    for (auto&& p : tree_t::child_positions()) {
+      const auto rcp = tree::relative_child_position<Nd>(p);
+      point_t x_c    = x_p;
+      for (auto&& d : dimensions()) { x_c(d) += rcp[d] * d_c; }
+      cache_geometry(tree_t::child(n, p), x_c, l_c);
+    }
+    return s;
+  }
+
+  /// Refines node \p n into the reserved sibling group \p s (see
+  /// tree::refine_into) updating the geometry cache of its children
+  ///
+  /// Thread-safe as long as each thread refines different nodes into
+  /// different sibling groups.
+  void refine_into(tree_node_idx n, siblings_idx s) noexcept {
+    tree_t::refine_into(n, s);
+    if (!has_geometry_cache()) { return; }
+    const auto x_p = coordinates(n);
+    const auto l_c = level_idx{*level(n) + 1};
+    const auto d_c = length(l_c) * num_t{0.5};
+    for (auto&& p : tree_t::child_positions()) {
+      const auto rcp = tree::relative_child_position<Nd>(p);
+      point_t x_c    = x_p;
+      for (auto&& d : dimensions()) { x_c(d) += rcp[d] * d_c; }
+      cache_geometry(tree_t::child(n, p), x_c, l_c);
+    }
+  }
+
+  /// Coarsens node \p n (see tree::coarsen)
+  ///
+  /// The cached geometry of the node is unchanged (and that of its children is
+  /// no longer used).
+  void coarsen(tree_node_idx n) noexcept { tree_t::coarsen(n); }
+
+  /// Refines the root node uniformly up to level \p l (see
+  /// tree::refine_uniformly) filling the geometry cache in one parallel pass
+  void refine_uniformly(level_idx l) {
+    tree_t::refine_uniformly(l);
+    if (has_geometry_cache()) { enable_geometry_cache(); }
+  }
+
+  /// Swaps the memory location of the sibling groups \p a and \p b (see
+  /// tree::swap) updating the geometry cache
+  void swap(siblings_idx a, siblings_idx b) noexcept {
+    tree_t::swap(a, b);
+    if (!has_geometry_cache()) { return; }
+    const idx_t cap = *tree_t::capacity();
+    for (auto n : view::zip(tree_t::nodes(a), tree_t::nodes(b))) {
+      const idx_t l = *get<0>(n), r = *get<1>(n);
+      for (auto&& d : dimensions()) {
+        std::swap(cached_centers_[d * cap + l], cached_centers_[d * cap + r]);
+      }
+      std::swap(cached_levels_[l], cached_levels_[r]);
+    }
+  }
+
+  ///@}  // Geometry cache
+
   /// Length of node at level \p l
   num_t length(level_idx l) const noexcept {
     return geometry::length(bounding_box()) * node_length_at_level(l);
@@ -69,8 +254,13 @@ struct single : tree::tree<Nd> {
   /// Center coordinates of node \p n
   point_t coordinates(tree_node_idx n) const noexcept {
     assert_node_in_use(n, HM3_AT_);
-    auto xs = tree::normalized_coordinates(*this, n);
-    return point_t{geometry::length(bounding_box()) * xs()};
+    if (has_geometry_cache()) {
+      point_t x;
+      const idx_t cap = *tree_t::capacity();
+      for (auto&& d : dimensions()) { x(d) = cached_centers_[d * cap + *n]; }
+      return x;
+    }
+    return compute_coordinates(n);
   }
 
   /// Node at index \p n
@@ -87,10 +277,13 @@ struct single : tree::tree<Nd> {
   /// Level of node \p n
   level_idx level(tree_node_idx n) const noexcept {
     assert_node_in_use(n, HM3_AT_);
-    return tree::node_level(*this, n);
+    return has_geometry_cache() ? level_idx{cached_levels_[*n]}
+                                : compute_level(n);
   }
 
   /// All neighbors (across all manifolds) of node \p n
+  ///
+  /// Wraps around the periodic dimensions of the grid.
   inline auto neighbors(tree_node_idx n) const noexcept {
     assert_node_in_use(n, HM3_AT_);
     return tree::node_neighbors(*this, tree::node_location(*this, n));
@@ -120,24 +313,25 @@ struct single : tree::tree<Nd> {
   }
 };
 
-template <uint_t Nd>
-bool operator==(single<Nd> const& a, single<Nd> const& b) noexcept {
-  using tree_t = tree::tree<Nd> const&;
+template <uint_t Nd, typename Idx>
+bool operator==(single<Nd, Idx> const& a, single<Nd, Idx> const& b) noexcept {
+  using tree_t = tree::tree<Nd, Idx> const&;
   return a.bounding_box() == b.bounding_box()
+         && a.periodicity() == b.periodicity()
          && static_cast<tree_t>(a) == static_cast<tree_t>(b);
 }
 
-template <uint_t Nd>
-bool operator!=(single<Nd> const& a, single<Nd> const& b) noexcept {
+template <uint_t Nd, typename Idx>
+bool operator!=(single<Nd, Idx> const& a, single<Nd, Idx> const& b) noexcept {
   return !(a == b);
 }
 
-template <uint_t Nd> string type(single<Nd> const&) {
+template <uint_t Nd, typename Idx> string type(single<Nd, Idx> const&) {
   return "hierarchical_cartesian_grid";
 }
 
-template <uint_t Nd> string name(single<Nd> const&) {
-  return type(single<Nd>{}) + "_" + std::to_string(Nd) + "D";
+template <uint_t Nd, typename Idx> string name(single<Nd, Idx> const&) {
+  return type(single<Nd, Idx>{}) + "_" + std::to_string(Nd) + "D";
 }
 
 }  // namespace hc
@@ -24,11 +24,17 @@ constexpr grid_idx operator"" _g(unsigned long long int i) {
   return grid_idx{static_cast<sidx_t>(i)};
 }
 
+struct node_idx_tag;
+
+/// Grid node index stored using the integer type \p Idx (see
+/// tree::node_idx_storage)
+template <typename Idx>
+using node_idx_storage
+ = compact_optional<empty_scalar_value<Idx, std::numeric_limits<Idx>::max()>,
+                    node_idx_tag>;
+
 /// Index of a node within a grid
-using node_idx
- = compact_optional<empty_scalar_value<idx_t,
-                                       std::numeric_limits<idx_t>::max()>,
-                    struct node_idx_tag>;
+using node_idx = node_idx_storage<idx_t>;
 
 constexpr node_idx operator"" _gn(unsigned long long int i) {
   return node_idx{static_cast<idx_t>(i)};
@@ -36,5 +42,12 @@ constexpr node_idx operator"" _gn(unsigned long long int i) {
 
 using grid_node_idx = node_idx;
 
+/// Grid node index stored using the integer type \p Idx
+template <typename Idx> using grid_node_idx_storage = node_idx_storage<Idx>;
+
+/// Tree node index stored using the integer type \p Idx
+template <typename Idx>
+using tree_node_idx_storage = tree::node_idx_storage<Idx>;
+
 }  // namespace grid
 }  // namespace hm3
@@ -10,7 +10,13 @@
 #include <hm3/utility/range.hpp>
 #include <hm3/utility/mpi.hpp>
 #include <hm3/utility/log.hpp>
+#include <algorithm>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <vector>
 
 namespace hm3 {
 namespace io {
@@ -74,6 +80,10 @@ struct file {
   std::map<string, std::pair<void*, void*>> in_memory_;
   /// Callbacks to execute before writing each field
   std::map<string, std::function<void()>> execute_before_write_;
+  /// Callbacks to execute after reading each field
+  std::map<string, std::function<void()>> execute_after_read_;
+  /// Temporary buffers of converted fields
+  std::map<string, std::shared_ptr<void>> buffers_;
 
   string dir_path_ = "";
 
@@ -267,6 +277,100 @@ struct file {
     return field(field_name, data, data + size);
   }
 
+  /// Add an array [begin, end) named \p field_name to the file that is stored
+  /// in the file with the value type \p FileT
+  ///
+  /// Writing: the array is converted into a temporary buffer using \p to_file
+  /// when the field is added.
+  ///
+  /// Reading: the array is read into a temporary buffer which is converted
+  /// into the array using \p from_file after reading.
+  template <typename FileT, typename T, typename ToFile, typename FromFile>
+  file& converted_field(string const& field_name, T* begin, T* end,
+                        ToFile&& to_file, FromFile&& from_file) {
+    using T_    = ranges::uncvref_t<T>;
+    auto mem    = const_cast<T_*>(begin);
+    auto size   = end - begin;
+    auto buffer = std::make_shared<std::vector<FileT>>(size);
+    buffers_[field_name] = buffer;
+    if (!has_field(field_name)) {
+      std::transform(mem, mem + size, buffer->begin(), to_file);
+    } else {
+      execute_after_read_[field_name]
+       = [ buffer, mem, from_file = std::forward<FromFile>(from_file) ]() {
+        std::transform(buffer->begin(), buffer->end(), mem, from_file);
+      };
+    }
+    return field(field_name, buffer->data(), buffer->data() + size);
+  }
+
+  /// Add an array [begin, end) of optional indices named \p field_name to the
+  /// file
+  ///
+  /// The indices are stored in the file using the integer type \p FileT
+  /// (empty indices are stored as the maximum value of idx_t) independently
+  /// of the width of the indices in memory. That is, files written with
+  /// 32-bit indices can be read into 64-bit indices and vice-versa.
+  template <typename FileT, typename T>
+  file& index_field(string const& field_name, T* begin, T* end) {
+    using T_         = ranges::uncvref_t<T>;
+    using value_t    = typename T_::value_type;
+    const auto empty = static_cast<FileT>(std::numeric_limits<idx_t>::max());
+    if (sizeof(T_) == sizeof(FileT)) {
+      return field(field_name, reinterpret_cast<FileT const*>(begin),
+                   reinterpret_cast<FileT const*>(end));
+    }
+    return converted_field<FileT>(
+     field_name, begin, end,
+     [empty](T_ const& i) { return i ? static_cast<FileT>(*i) : empty; },
+     [empty](FileT i) {
+       return i == empty ? T_{} : T_{static_cast<value_t>(i)};
+     });
+  }
+
+  /// Add an array [data, data + size) of optional indices named \p field_name
+  /// to the file
+  template <typename FileT, typename T>
+  file& index_field(string const& field_name, T* data, std::size_t size) {
+    return index_field<FileT>(field_name, data, data + size);
+  }
+
+  /// Add an array of \p size optional indices named \p field_name to the file
+  /// that is not stored contiguously in memory
+  ///
+  /// The indices are stored in the file using the integer type \p FileT (see
+  /// index_field).
+  ///
+  /// Writing: the indices get(0), ..., get(size - 1) are gathered into a
+  /// temporary buffer when the field is added.
+  ///
+  /// Reading: the array is read into a temporary buffer whose indices are
+  /// scattered using set(i, index) after reading.
+  template <typename FileT, typename Get, typename Set>
+  file& gathered_index_field(string const& field_name, std::size_t size,
+                             Get&& get, Set&& set) {
+    using T_         = ranges::uncvref_t<decltype(get(std::size_t{0}))>;
+    using value_t    = typename T_::value_type;
+    const auto empty = static_cast<FileT>(std::numeric_limits<idx_t>::max());
+    auto buffer      = std::make_shared<std::vector<FileT>>(size);
+    buffers_[field_name] = buffer;
+    if (!has_field(field_name)) {
+      for (std::size_t i = 0; i != size; ++i) {
+        const auto v = get(i);
+        (*buffer)[i] = v ? static_cast<FileT>(*v) : empty;
+      }
+    } else {
+      execute_after_read_[field_name]
+       = [ buffer, empty, set = std::forward<Set>(set) ]() {
+        for (std::size_t i = 0, e = buffer->size(); i != e; ++i) {
+          const FileT v = (*buffer)[i];
+          set(i, v == empty ? T_{} : T_{static_cast<value_t>(v)});
+        }
+      };
+    }
+    return field(field_name, buffer->data(), buffer->data() + size);
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   /// \name Read constant fields
   ///
@@ -363,7 +467,9 @@ struct file {
     return j;
   }
 
- private:
+ public:
+  /// Computes the location of the arrays within the file (must be called
+  /// before write_data_only / write_arrays)
   void prepare_write(mpi::comm const&) {
     int_t data_p   = 0;
     using byte_ptr = char const* const;
@@ -377,25 +483,44 @@ struct file {
     }
   }
 
- public:
-  void write_data_only(mpi::comm const&) const {
+  /// Logs the arrays that write_arrays writes
+  void log_write() const {
     log_("writing file \"{}\" arrays...", path());
     log_("- with header:\n\n{}\n", header().dump(2));
     log_("- field | mem: [from, to) | size:");
-    std::ofstream o(path());
     using byte_ptr = char const* const;
     for (auto&& f : in_memory_) {
-      const auto mb     = reinterpret_cast<byte_ptr>(f.second.first);
-      const auto me     = reinterpret_cast<byte_ptr>(f.second.second);
-      const auto m_size = me - mb;
+      const auto mb = reinterpret_cast<byte_ptr>(f.second.first);
+      const auto me = reinterpret_cast<byte_ptr>(f.second.second);
       log_("    {} | mem: [{}, {}) : {}", f.first,
            reinterpret_cast<void const*>(mb), reinterpret_cast<void const*>(me),
-           m_size);
-      o.write(mb, m_size);
+           me - mb);
     }
+  }
+
+  /// Writes the arrays to the file without logging (different files can be
+  /// written concurrently)
+  void write_arrays(mpi::comm const&) const {
+    std::ofstream o(path());
+    using byte_ptr = char const* const;
+    for (auto&& f : in_memory_) {
+      const auto mb = reinterpret_cast<byte_ptr>(f.second.first);
+      const auto me = reinterpret_cast<byte_ptr>(f.second.second);
+      o.write(mb, me - mb);
+    }
+  }
+
+  /// Logs that write_arrays is done
+  void log_write_done() const {
     log_("...writing file \"{}\" arrays done!", path());
   }
 
+  void write_data_only(mpi::comm const& c) const {
+    log_write();
+    write_arrays(c);
+    log_write_done();
+  }
+
   void write_data(mpi::comm const& c) {
     prepare_write(c);
     write_data_only(c);
@@ -430,6 +555,7 @@ struct file {
              reinterpret_cast<void*>(me), m_size, fh.fail() ? "false" : "true");
       }
     }
+    for (auto&& f : execute_after_read_) { f.second(); }
     log_("...reading file\"{}\" arrays done!", path());
   }
 };
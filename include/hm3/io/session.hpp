@@ -3,8 +3,10 @@
 ///
 /// IO session
 #include <type_traits>
+#include <vector>
 #include <hm3/io/file.hpp>
 #include <hm3/io/file_system.hpp>
+#include <hm3/utility/parallel.hpp>
 
 namespace hm3 {
 namespace io {
@@ -300,6 +302,62 @@ struct session {
     }
   }
 
+  /// Writes the files \p fs at once
+  ///
+  /// The files are indexed in order (such that a file can depend on a file
+  /// written before it in \p fs), their binary data is then written
+  /// concurrently, and only if writing succeeds they are registered in the
+  /// session and the session file is written once.
+  void write(std::vector<file>& fs) {
+    // index of the last file of the group \p name before \p it in \p fs
+    // (invalid if there is none):
+    auto last_in_fs = [&](auto it, string const& name) {
+      index_t i{};
+      for (auto jt = begin(fs); jt != it; ++jt) {
+        if (jt->group_name() == name) { i = jt->index(); }
+      }
+      return i;
+    };
+
+    for (auto it = begin(fs), e = end(fs); it != e; ++it) {
+      auto&& f = *it;
+      auto fg  = (*this)[f.group_name()];
+
+      HM3_ASSERT(!f.index(), "file index is not invalid but {}", f.index());
+      const auto l = last_in_fs(it, f.group_name());
+      f.index(l ? index_t{*l + 1} : fg.size());
+
+      HM3_ASSERT(f.dependency_group_name().empty(), "");
+      HM3_ASSERT(!f.dependency_index(),
+                 "dependency index is not invalid but {}",
+                 f.dependency_index());
+
+      if (fg.has_dependency()) {
+        const auto dl = last_in_fs(it, fg.dependency_name());
+        f.dependency_group_name(fg.dependency_name());
+        f.dependency_index(dl ? dl : fg.dependency().last().index());
+      }
+      f.prepare_write(comm_);
+      f.log_write();
+    }
+
+    /// Write binary data (the files are independent, and the loggers are not
+    /// thread-safe: nothing is logged within the parallel loop)
+    const int_t no_files = fs.size();
+    parallel::for_each(0, no_files,
+                       [&](int_t i) { fs[i].write_arrays(comm_); });
+    for (auto&& f : fs) { f.log_write_done(); }
+
+    // If writing data succeeds, modify the file groups:
+    for (auto&& f : fs) {
+      auto fg = (*this)[f.group_name()];
+      fg.push(f);
+      data_[f.group_name()] = static_cast<io::json>(fg);
+    }
+
+    write();  // write the session to a file
+  }
+
   template <typename OStream>
   friend OStream& operator<<(OStream& os, session const& s) {
     os << s.data_.dump(2);
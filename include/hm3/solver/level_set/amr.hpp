@@ -2,6 +2,7 @@
 /// \file
 ///
 /// Adaptive mesh refinement for the level-set solver
+#include <vector>
 #include <hm3/grid/types.hpp>
 #include <hm3/amr/amr.hpp>
 #include <hm3/solver/level_set/state.hpp>
@@ -11,12 +12,12 @@ namespace solver {
 namespace level_set {
 
 /// Adaptive mesh refinement target for the level set solver
-template <uint_t Nd> struct amr {
+template <uint_t Nd, typename TreeGrid = ::hm3::grid::mhc<Nd>> struct amr {
   using amr_node_idx = grid_node_idx;
 
-  state<Nd>* ls_;
+  state<Nd, TreeGrid>* ls_;
 
-  amr(state<Nd>& s) : ls_{&s} {}
+  amr(state<Nd, TreeGrid>& s) : ls_{&s} {}
 
   /// Siblings of node \p n within the solver grid
   auto siblings(amr_node_idx n) const { return ls_->g.siblings(n); }
@@ -53,10 +54,37 @@ template <uint_t Nd> struct amr {
   }
 };
 
+/// Refines the nodes \p ns of the level-set solver grid at once
+template <uint_t Nd, typename TreeGrid>
+void refine_nodes(amr<Nd, TreeGrid>& t, std::vector<grid_node_idx> const& ns) {
+  t.ls_->refine(ns);
+}
+
+/// Coarsens the siblings of the nodes \p ns of the level-set solver grid at
+/// once
+template <uint_t Nd, typename TreeGrid>
+void coarsen_siblings_of_nodes(amr<Nd, TreeGrid>& t,
+                               std::vector<grid_node_idx> const& ns) {
+  t.ls_->coarsen(ns);
+}
+
+/// Logs the structure statistics of the grid, including the memory of the
+/// level-set solver, after the target \p t has been adapted
+template <uint_t Nd, typename TreeGrid>
+void after_adapt(amr<Nd, TreeGrid>& t) {
+  auto&& ls = *t.ls_;
+  auto s    = ls.g.tree().stats();
+  ls.g.add_memory_stats(s);
+  ls.fields.add_memory_stats(s, ls.g.size());
+  ls.g.tree().log_stats(s);
+}
+
 /// Creates an adaptive mesh refinement handler for the level-set solver state
 /// \p s
-template <uint_t Nd>::hm3::amr::state<amr<Nd>> make_amr(state<Nd>& s) noexcept {
-  return amr<Nd>{s};
+template <uint_t Nd, typename TreeGrid>
+::hm3::amr::state<amr<Nd, TreeGrid>> make_amr(
+ state<Nd, TreeGrid>& s) noexcept {
+  return amr<Nd, TreeGrid>{s};
 }
 
 }  // namespace level_set
@@ -12,31 +12,35 @@ namespace level_set {
 /// \name Level-set  I/O
 ///@{
 
-template <uint_t Nd> void map_arrays(io::file& f, state<Nd> const& s) {
+template <uint_t Nd, typename TreeGrid>
+void map_arrays(io::file& f, state<Nd, TreeGrid> const& s) {
   auto no_nodes = grid_node_idx{f.constant("no_grid_nodes", idx_t{})};
   HM3_ASSERT(no_nodes == s.g.size(), "mismatching number of grid nodes");
-  f.field("signed_distance", s.signed_distance.data(), *no_nodes);
+  s.fields.map_arrays(f, no_nodes);
 }
 
-template <uint_t Nd, typename Tree = typename state<Nd>::tree_t>
-state<Nd> from_file_unread(state<Nd> const&, io::file& f, Tree& t,
-                           io::session& s_, grid_node_idx node_capacity) {
-  auto g
-   = from_file_unread(::hm3::solver::state::grid<Nd>{}, f, t, node_capacity);
-  state<Nd> s(std::move(g), s_);
+template <uint_t Nd, typename TreeGrid>
+state<Nd, TreeGrid> from_file_unread(state<Nd, TreeGrid> const&, io::file& f,
+                                     TreeGrid& t, io::session& s_,
+                                     grid_node_idx node_capacity) {
+  using grid_t = typename state<Nd, TreeGrid>::grid;
+  auto g       = from_file_unread(grid_t{}, f, t, node_capacity);
+  state<Nd, TreeGrid> s(std::move(g), s_);
   map_arrays(f, s);
   return s;
 }
 
-template <uint_t Nd> void to_file_unwritten(io::file& f, state<Nd> const& s) {
+template <uint_t Nd, typename TreeGrid>
+void to_file_unwritten(io::file& f, state<Nd, TreeGrid> const& s) {
   to_file_unwritten(f, s.g);
   map_arrays(f, s);
 }
 
-template <uint_t Nd, typename Tree = typename state<Nd>::tree_t>
-state<Nd> from_file(state<Nd> const&, io::file& f, Tree& t, io::session& s,
-                    grid_node_idx node_capacity = grid_node_idx{}) {
-  auto ls = from_file_unread(state<Nd>{}, f, t, s, node_capacity);
+template <uint_t Nd, typename TreeGrid>
+state<Nd, TreeGrid> from_file(state<Nd, TreeGrid> const&, io::file& f,
+                              TreeGrid& t, io::session& s,
+                              grid_node_idx node_capacity = grid_node_idx{}) {
+  auto ls = from_file_unread(state<Nd, TreeGrid>{}, f, t, s, node_capacity);
   f.read_arrays();
   return ls;
 }
@@ -3,6 +3,7 @@
 ///
 /// Forward declarations of level-set solver
 #include <hm3/types.hpp>
+#include <hm3/grid/grid.hpp>
 #include <hm3/grid/types.hpp>
 
 namespace hm3 {
@@ -15,7 +16,7 @@ using grid::grid_idx;
 using grid::grid_node_idx;
 using grid::tree_node_idx;
 
-template <uint_t Nd> struct state;
+template <uint_t Nd, typename TreeGrid = ::hm3::grid::mhc<Nd>> struct state;
 
 }  // namespace level_set
 }  // namespace solver
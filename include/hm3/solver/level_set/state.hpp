@@ -5,26 +5,34 @@
 #include <hm3/io/client.hpp>
 #include <hm3/solver/level_set/fwd.hpp>
 #include <hm3/solver/level_set/fio.hpp>
+#include <hm3/solver/state/fields.hpp>
 
 namespace hm3 {
 namespace solver {
 namespace level_set {
 
 /// Solver-state type-name
-template <uint_t Nd> string type(state<Nd> const&) { return "level_set"; }
+template <uint_t Nd, typename TreeGrid>
+string type(state<Nd, TreeGrid> const&) {
+  return "level_set";
+}
 
 /// Name of the level-set solver state
-template <uint_t Nd> string name(state<Nd> const& s, grid_idx idx) {
+template <uint_t Nd, typename TreeGrid>
+string name(state<Nd, TreeGrid> const& s, grid_idx idx) {
   using std::to_string;
   return type(s) + "_" + to_string(*idx);
 }
 
-template <uint_t Nd> string name(state<Nd> const& s) {
+template <uint_t Nd, typename TreeGrid>
+string name(state<Nd, TreeGrid> const& s) {
   return name(s, s.idx());
 }
 
-template <uint_t Nd> struct state {
-  using grid = ::hm3::solver::state::grid<Nd>;
+/// Level-set solver state stored in the multi tree grid \p TreeGrid (see
+/// solver::state::grid)
+template <uint_t Nd, typename TreeGrid> struct state {
+  using grid = ::hm3::solver::state::grid<Nd, idx_t, TreeGrid>;
 
   using tree_t   = typename grid::tree_t;
   using cell_idx = grid_node_idx;
@@ -34,7 +42,22 @@ template <uint_t Nd> struct state {
   grid g;
   io::client io_;
 
-  dense::vector<num_t, dense::dynamic, cell_idx> signed_distance;
+  /// Signed-distance field: the children take the value of their parent, and
+  /// the parent the average value of its children
+  using signed_distance_field
+   = ::hm3::solver::state::field<num_t,
+                                 ::hm3::solver::state::prolongation::copy,
+                                 ::hm3::solver::state::restriction::average>;
+  using fields_t = ::hm3::solver::state::fields<signed_distance_field>;
+
+  fields_t fields;
+
+  /// Signed-distance of cell \p n
+  num_t& signed_distance(cell_idx n) noexcept { return fields.get<0>()(n); }
+  /// Signed-distance of cell \p n
+  num_t signed_distance(cell_idx n) const noexcept {
+    return fields.get<0>()(n);
+  }
 
   state() = default;
 
@@ -43,7 +66,7 @@ template <uint_t Nd> struct state {
    : log(name(*this, gidx))
    , g(t, gidx, node_capacity, log)
    , io_(s, name(*this), type(*this), name(g.tree()))
-   , signed_distance(*node_capacity) {
+   , fields(signed_distance_field("signed_distance", node_capacity)) {
     reset();
   }
 
@@ -51,7 +74,7 @@ template <uint_t Nd> struct state {
    : log(name(*this, g_.idx()))
    , g(std::move(g_))
    , io_(s, name(*this), type(*this), name(g.tree()))
-   , signed_distance(*g.capacity()) {}
+   , fields(signed_distance_field("signed_distance", g.capacity())) {}
 
   state(state&&) = default;
   state& operator=(state&&) = default;
@@ -60,7 +83,7 @@ template <uint_t Nd> struct state {
 
   /// Reset level-set solver state
   void reset() noexcept {
-    for (auto&& i : signed_distance) { i = std::numeric_limits<num_t>::max(); }
+    fields.get<0>().fill(std::numeric_limits<num_t>::max());
     g.reset();
   }
 
@@ -73,39 +96,53 @@ template <uint_t Nd> struct state {
   template <typename ChildrenRange>
   void interpolate_from_parent_to_children(cell_idx parent,
                                            ChildrenRange&& children) noexcept {
-    for (auto&& child : children) {
-      signed_distance(child) = signed_distance(parent);
-    }
+    fields.interpolate_from_parent_to_children(
+     parent, std::forward<ChildrenRange>(children));
   }
 
   /// Refines the solver cell \p c
+  ///
+  /// Returns the newly created children.
   auto refine(const cell_idx i) noexcept {
+    stack::vector<cell_idx, tree_t::no_children()> children;
     // parent will be deleted at the end of this scope
-    auto guard = g.refine(i);
-    interpolate_from_parent_to_children(i, guard());
-    return guard();  // returns range of newly created children
+    auto r = g.refine(i);
+    fields.interpolate_from_parents_to_children(r);
+    for (auto&& c : r.children(0)) { children.push_back(c); }
+    return children;
   }
 
   template <typename ChildrenRange>
   void interpolate_from_children_to_parent(cell_idx parent,
                                            ChildrenRange&& children) noexcept {
-    uint_t count = 0;
-    signed_distance(parent) = 0;
-    for (auto&& child : children) {
-      signed_distance(parent) += signed_distance(child);
-      ++count;
-    }
-    HM3_ASSERT(count != 0, "count cannot be equal to zero");
-    signed_distance(parent) /= count;
+    fields.interpolate_from_children_to_parent(
+     parent, std::forward<ChildrenRange>(children));
   }
 
   /// Coarsens the sibling grid nodes of \p n
+  ///
+  /// Returns the new parent.
   cell_idx coarsen(const cell_idx n) noexcept {
     // children will be deleted at the end of this scope
-    auto guard = g.coarsen(n);
-    interpolate_from_children_to_parent(n, guard());
-    for (auto i : guard()) { signed_distance(i) = -1; }
-    return guard.parent_;  // retuns cell_idx of parent
+    auto c = g.coarsen(n);
+    fields.interpolate_from_children_to_parents(c);
+    return c.parent(0);
+  }
+
+  /// Refines the solver cells \p cells at once
+  template <typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  void refine(Rng&& cells) {
+    // parents will be deleted at the end of this scope
+    auto batch = g.refine(std::forward<Rng>(cells));
+    fields.interpolate_from_parents_to_children(batch);
+  }
+
+  /// Coarsens the sibling groups of the solver cells \p cells at once
+  template <typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  void coarsen(Rng&& cells) {
+    // children will be deleted at the end of this scope
+    auto batch = g.coarsen(std::forward<Rng>(cells));
+    fields.interpolate_from_children_to_parents(batch);
   }
 
   template <typename SD> void set_node_values(SD&& sd) noexcept {
@@ -114,44 +151,63 @@ template <uint_t Nd> struct state {
     }
   }
 
-  void write() {
+  /// Sets the node values of the solver cells \p cells only (e.g. the cells
+  /// created since a journal marker, see grid::created_since)
+  template <typename SD, typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  void set_node_values(SD&& sd, Rng&& cells) noexcept {
+    for (auto&& n : cells) { signed_distance(n) = sd(g.coordinates(n)); }
+  }
+
+  /// File containing the state (not written yet, see solver::write)
+  io::file unwritten_file() const {
     auto f = io_.new_file();
     to_file_unwritten(f, *this);
+    return f;
+  }
+
+  void write() {
+    auto f = unwritten_file();
     io_.write(f);
   }
 
   void sort() {
     HM3_ASSERT(g.tree().is_sorted(), "tree is not sorted!");
 
-    // update solver ids to point to the new tree nodes
-    g.update_from_tree();
-    g.sort([&](cell_idx i, cell_idx j) {
-      std::swap(signed_distance(i), signed_distance(j));
-    });
-    g.update_tree();
+    // permutes the solver cells and points them to the new tree nodes
+    g.sort([&](std::vector<cell_idx> const& p) { fields.permute(p); });
 
     HM3_ASSERT(g.is_compact(), "??");
   }
 
+  /// Sorts the state with the sort \p plan of its grid (see solver::sort)
+  void sort(typename grid::sort_plan_t&& plan) {
+    HM3_ASSERT(g.tree().is_sorted(), "tree is not sorted!");
+    g.sort(std::move(plan),
+           [&](std::vector<cell_idx> const& p) { fields.permute(p); });
+    HM3_ASSERT(g.is_compact(), "??");
+  }
+
   auto geometry(cell_idx n) const noexcept {
     return g.tree().geometry(g.tree_node(n));
   }
   auto bounding_box() const noexcept { return g.tree().bounding_box(); }
   auto dimensions() const noexcept { return g.tree().dimensions(); }
 
-  static state<Nd> from_session(io::session& s, tree_t& t, string name_,
-                                io::file::index_t i) {
-    io::client io_(s, name_, type(state<Nd>{}), name(t));
+  static state from_session(io::session& s, tree_t& t, string name_,
+                            io::file::index_t i) {
+    io::client io_(s, name_, type(state{}), name(t));
     auto f = io_.get_file(i);
-    return from_file(state<Nd>{}, f, t, s);
+    return from_file(state{}, f, t, s);
   }
 };
 
-template <uint_t Nd> bool operator==(state<Nd> const& a, state<Nd> const& b) {
-  return a.g == b.g and equal(a.signed_distance, b.signed_distance);
+template <uint_t Nd, typename TreeGrid>
+bool operator==(state<Nd, TreeGrid> const& a, state<Nd, TreeGrid> const& b) {
+  return a.g == b.g and a.fields == b.fields;
 }
 
-template <uint_t Nd> bool operator!=(state<Nd> const& a, state<Nd> const& b) {
+template <uint_t Nd, typename TreeGrid>
+bool operator!=(state<Nd, TreeGrid> const& a, state<Nd, TreeGrid> const& b) {
   return !(a == b);
 }
 
@@ -0,0 +1,285 @@
+#pragma once
+/// \file
+///
+/// Stores neighbors of solver grid cells in compressed sparse row format
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <hm3/solver/state/grid.hpp>
+#include <hm3/tree/relations/neighbor.hpp>
+#include <hm3/utility/parallel.hpp>
+#include <hm3/utility/stack_vector.hpp>
+
+namespace hm3 {
+namespace solver {
+namespace state {
+
+/// Stores the neighbors of solver grid cells in compressed sparse row (CSR)
+/// format
+///
+/// The neighbors of all grid nodes are stored contiguously in a single array:
+/// the row of node n starts at offset(n), contains size(n) neighbors, and has
+/// room for slack() more neighbors, such that neighbors can be pushed after
+/// AMR without moving the other rows. If a row runs out of room all rows are
+/// repacked (with slack() room each).
+///
+/// Optionally, the rank of the manifold shared with each neighbor is stored
+/// along with it: 1 (faces), ..., Nd (corners).
+///
+/// Compared to neighbors<capacity>, the memory is proportional to the actual
+/// number of neighbors (plus slack), and stencil loops over the nodes in order
+/// read a dense stream of neighbor indices.
+struct csr_neighbors {
+  /// Offset of the row of each node (the row of node n has room for
+  /// offsets_[n+1] - offsets_[n] neighbors)
+  std::vector<idx_t> offsets_;
+  /// Number of neighbors of each node
+  std::vector<idx_t> sizes_;
+  /// Neighbors of the nodes
+  std::vector<grid_node_idx> data_;
+  /// Manifold rank of each neighbor (empty if not stored)
+  std::vector<std::uint8_t> manifolds_;
+  /// Room for additional neighbors of each row (after build/repack)
+  idx_t slack_ = 0;
+  /// Are the manifold ranks stored?
+  bool with_manifolds_ = false;
+
+  csr_neighbors() = default;
+  csr_neighbors(grid_node_idx capacity_, idx_t slack = 0,
+                bool with_manifolds = false)
+   : offsets_(*capacity_ + 1)
+   , sizes_(*capacity_, 0)
+   , slack_(slack)
+   , with_manifolds_(with_manifolds) {
+    for (idx_t i = 0; i <= *capacity_; ++i) { offsets_[i] = i * slack_; }
+    data_.resize(offsets_.back());
+    if (with_manifolds_) { manifolds_.resize(data_.size()); }
+  }
+
+  /// Maximum number of nodes
+  grid_node_idx capacity() const noexcept { return sizes_.size(); }
+  /// Room for additional neighbors per row after build/repack
+  idx_t slack() const noexcept { return slack_; }
+  /// Are the manifold ranks of the neighbors stored?
+  bool with_manifolds() const noexcept { return with_manifolds_; }
+
+  template <typename At>
+  void assert_within_capacity(grid_node_idx n, At&& at) const noexcept {
+    HM3_ASSERT_AT(n, "invalid node", at);
+    HM3_ASSERT_AT(n < capacity(), "node {} is out-of-capacity-bounds [0, {})",
+                  at, n, capacity());
+  }
+
+  /// Offset of the neighbors of node \p n within the neighbor array
+  idx_t offset(grid_node_idx n) const noexcept {
+    assert_within_capacity(n, HM3_AT_);
+    return offsets_[*n];
+  }
+  /// Number of neighbors of node \p n
+  idx_t size(grid_node_idx n) const noexcept {
+    assert_within_capacity(n, HM3_AT_);
+    return sizes_[*n];
+  }
+  /// Neighbor array
+  grid_node_idx const* data() const noexcept { return data_.data(); }
+
+  /// Neighbors of node \p n
+  auto operator()(grid_node_idx n) const noexcept {
+    return view::counted(data_.data() + offset(n), size(n));
+  }
+
+  /// Manifold ranks of the neighbors of node \p n
+  auto manifolds(grid_node_idx n) const noexcept {
+    HM3_ASSERT(with_manifolds(), "manifold ranks are not stored");
+    return view::counted(manifolds_.data() + offset(n), size(n));
+  }
+
+  /// Does node \p n have node \p neighbor as neighbor?
+  bool has_neighbor(grid_node_idx node, grid_node_idx neighbor) const
+   noexcept {
+    assert_within_capacity(neighbor, HM3_AT_);
+    auto ns = (*this)(node);
+    return find(ns, neighbor) != end(ns);
+  }
+
+  /// Builds the neighbors of the nodes in use of the solver grid \p g (across
+  /// all manifolds) from the tree
+  ///
+  /// The rows are counted and then filled in parallel.
+  ///
+  /// Time complexity: O(size(g) / no_threads * log(N))
+  template <typename Grid> void build(Grid const& g) {
+    HM3_ASSERT(g.capacity() <= capacity(), "grid capacity {} > capacity {}",
+               g.capacity(), capacity());
+    constexpr uint_t nd = Grid::tree_t::dimension();
+    std::fill(begin(sizes_), end(sizes_), idx_t{0});
+
+    std::vector<grid_node_idx> nodes;
+    RANGES_FOR (auto&& n, g.in_use()) { nodes.push_back(n); }
+    const idx_t no_nodes = nodes.size();
+
+    auto for_each_neighbor = [&](grid_node_idx n, auto&& f) {
+      const auto tn = g.tree_node(n);
+      if (!tn) { return; }
+      stack::vector<std::pair<grid_node_idx, uint_t>,
+                    tree::max_no_neighbors(nd)>
+       ns;
+      using manifold_rng = meta::as_list<meta::integer_range<int, 1, nd + 1>>;
+      meta::for_each(manifold_rng{}, [&](auto m_) {
+        using manifold = tree::manifold_neighbors<nd, decltype(m_){}>;
+        for (auto&& i : g.tree().neighbors(tn, g.idx(), manifold{})) {
+          const grid_node_idx gi = g.in_tree(i);
+          if (find_if(ns, [&](auto&& p) { return p.first == gi; }) != end(ns)) {
+            continue;
+          }
+          ns.push_back(std::make_pair(gi, uint_t(decltype(m_){})));
+        }
+      });
+      for (auto&& p : ns) { f(p.first, p.second); }
+    };
+
+    parallel::for_each(0, no_nodes, [&](int_t i) {
+      idx_t c = 0;
+      for_each_neighbor(nodes[i], [&](grid_node_idx, uint_t) { ++c; });
+      sizes_[*nodes[i]] = c;
+    });
+    repack(slack_);
+    parallel::for_each(0, no_nodes, [&](int_t i) {
+      const auto n = nodes[i];
+      idx_t o      = offsets_[*n];
+      for_each_neighbor(n, [&](grid_node_idx j, uint_t m) {
+        data_[o] = j;
+        if (with_manifolds_) { manifolds_[o] = static_cast<std::uint8_t>(m); }
+        ++o;
+      });
+    });
+  }
+
+  /// Repacks the rows contiguously leaving room for \p slack additional
+  /// neighbors in each row
+  ///
+  /// Time complexity: O(capacity + no neighbors)
+  void repack(idx_t slack) {
+    slack_               = slack;
+    const idx_t no_nodes = sizes_.size();
+    std::vector<idx_t> offsets(no_nodes + 1);
+    offsets[0] = 0;
+    for (idx_t i = 0; i != no_nodes; ++i) {
+      offsets[i + 1] = offsets[i] + sizes_[i] + slack_;
+    }
+    std::vector<grid_node_idx> data(offsets.back());
+    std::vector<std::uint8_t> manifolds(with_manifolds_ ? data.size() : 0);
+    parallel::for_each_static(0, no_nodes, [&](int_t i) {
+      const idx_t from = offsets_[i], to = offsets[i];
+      for (idx_t j = 0; j != sizes_[i]; ++j) {
+        data[to + j] = data_[from + j];
+        if (with_manifolds_) { manifolds[to + j] = manifolds_[from + j]; }
+      }
+    });
+    offsets_   = std::move(offsets);
+    data_      = std::move(data);
+    manifolds_ = std::move(manifolds);
+  }
+
+ private:
+  /// Appends \p neighbor to the row of \p node
+  void push_back(grid_node_idx node, grid_node_idx neighbor, uint_t manifold) {
+    if (offsets_[*node] + sizes_[*node] == offsets_[*node + 1]) {
+      repack(std::max(slack_, idx_t{1}));
+    }
+    const idx_t o = offsets_[*node] + sizes_[*node]++;
+    data_[o]      = neighbor;
+    if (with_manifolds_) {
+      manifolds_[o] = static_cast<std::uint8_t>(manifold);
+    }
+  }
+
+  /// Removes \p neighbor from the row of \p node (keeping the order of the
+  /// other neighbors)
+  void erase(grid_node_idx node, grid_node_idx neighbor) noexcept {
+    const idx_t b = offsets_[*node], e = b + sizes_[*node];
+    idx_t j = b;
+    for (idx_t i = b; i != e; ++i) {
+      if (data_[i] == neighbor) { continue; }
+      data_[j] = data_[i];
+      if (with_manifolds_) { manifolds_[j] = manifolds_[i]; }
+      ++j;
+    }
+    sizes_[*node] = j - b;
+  }
+
+ public:
+  /// Adds neighbor \p neighbor across the manifold of rank \p manifold to node
+  /// \p node (and viceversa)
+  ///
+  /// Time complexity: O(1) if both rows have room left, O(capacity) otherwise.
+  void push(grid_node_idx node, grid_node_idx neighbor, uint_t manifold = 0) {
+    assert_within_capacity(node, HM3_AT_);
+    assert_within_capacity(neighbor, HM3_AT_);
+    HM3_ASSERT(!has_neighbor(node, neighbor),
+               "node {} already has {} as neighbor", node, neighbor);
+    HM3_ASSERT(!has_neighbor(neighbor, node),
+               "neighbor {} already has node {} as neighbor", neighbor, node);
+    push_back(node, neighbor, manifold);
+    push_back(neighbor, node, manifold);
+  }
+
+  /// Removes neighbor \p neighbor from node \p node (and viceversa)
+  void pop(grid_node_idx node, grid_node_idx neighbor) noexcept {
+    assert_within_capacity(node, HM3_AT_);
+    assert_within_capacity(neighbor, HM3_AT_);
+    HM3_ASSERT(has_neighbor(node, neighbor),
+               "node {} does not have {} as neighbor", node, neighbor);
+    HM3_ASSERT(has_neighbor(neighbor, node),
+               "neighbor {} does not have node {} as neighbor", neighbor, node);
+    erase(node, neighbor);
+    erase(neighbor, node);
+  }
+
+  /// Removes all neighbors of node \p node (and \p node from their neighbors)
+  void pop(grid_node_idx node) noexcept {
+    assert_within_capacity(node, HM3_AT_);
+    for (auto&& n : (*this)(node)) { erase(n, node); }
+    sizes_[*node] = 0;
+  }
+
+  /// Reorders the rows with the permutation \p p of the solver grid (see
+  /// grid::sort): the row of node i becomes the row of node p[i], and the
+  /// neighbors are renumbered
+  ///
+  /// The rows are repacked contiguously (with slack() room each) in one
+  /// parallel pass.
+  ///
+  /// Time complexity: O(capacity + no neighbors)
+  void permute(std::vector<grid_node_idx> const& p) {
+    const idx_t no_nodes = sizes_.size();
+    const idx_t no_rows  = p.size();
+    std::vector<grid_node_idx> new_idx(no_nodes);
+    for (idx_t i = 0; i != no_rows; ++i) { new_idx[*p[i]] = grid_node_idx{i}; }
+
+    std::vector<idx_t> offsets(no_nodes + 1), sizes(no_nodes, 0);
+    offsets[0] = 0;
+    for (idx_t i = 0; i != no_nodes; ++i) {
+      if (i < no_rows) { sizes[i] = sizes_[*p[i]]; }
+      offsets[i + 1] = offsets[i] + sizes[i] + slack_;
+    }
+    std::vector<grid_node_idx> data(offsets.back());
+    std::vector<std::uint8_t> manifolds(with_manifolds_ ? data.size() : 0);
+    parallel::for_each_static(0, no_rows, [&](int_t i) {
+      const idx_t from = offsets_[*p[i]], to = offsets[i];
+      for (idx_t j = 0; j != sizes[i]; ++j) {
+        data[to + j] = new_idx[*data_[from + j]];
+        if (with_manifolds_) { manifolds[to + j] = manifolds_[from + j]; }
+      }
+    });
+    offsets_   = std::move(offsets);
+    sizes_     = std::move(sizes);
+    data_      = std::move(data);
+    manifolds_ = std::move(manifolds);
+  }
+};
+
+}  // namespace state
+}  // namespace solver
+}  // namespace hm3
@@ -0,0 +1,312 @@
+#pragma once
+/// \file
+///
+/// Faces between the cells of a solver grid
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <hm3/solver/types.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/math.hpp>
+#include <hm3/utility/parallel.hpp>
+#include <hm3/utility/range.hpp>
+
+namespace hm3 {
+namespace solver {
+namespace state {
+
+/// Faces between the cells of a solver grid
+///
+/// Each face between two cells across an (Nd - 1)-dimensional manifold is
+/// stored once, such that flux-based solvers can loop over the faces instead
+/// of over the cells and their neighbors. The face i is shared by the cells
+/// left(i) and right(i), its normal points from left to right along the axis
+/// axis(i), and area_fraction(i) is its area relative to the face of the
+/// coarser cell (1 for same-level faces, 1 / 2^(Nd - 1) for hanging
+/// coarse/fine faces).
+///
+/// The faces are stored in SoA format and colored: faces of the same color
+/// share no cell, such that the fluxes of all faces of a color can be
+/// scattered to their cells in parallel without races. The faces are sorted
+/// by (color, left, right), i.e. each color is a contiguous range of faces
+/// sorted for locality.
+struct faces {
+  /// Left cell of each face
+  std::vector<grid_node_idx> left_;
+  /// Right cell of each face
+  std::vector<grid_node_idx> right_;
+  /// Normal axis of each face
+  std::vector<std::uint8_t> axis_;
+  /// Area of each face relative to the face of the coarser cell
+  std::vector<num_t> area_fraction_;
+  /// Color of each face
+  std::vector<std::uint8_t> color_;
+  /// The faces of color c are [color_offsets_[c], color_offsets_[c + 1])
+  std::vector<idx_t> color_offsets_{0};
+
+  /// Maximum number of colors
+  static constexpr uint_t max_no_colors() noexcept { return 64; }
+
+  /// Number of faces
+  idx_t size() const noexcept { return left_.size(); }
+  /// Number of colors
+  uint_t no_colors() const noexcept { return color_offsets_.size() - 1; }
+
+  /// Left cell of face \p i
+  grid_node_idx left(idx_t i) const noexcept {
+    assert_face(i, HM3_AT_);
+    return left_[i];
+  }
+  /// Right cell of face \p i
+  grid_node_idx right(idx_t i) const noexcept {
+    assert_face(i, HM3_AT_);
+    return right_[i];
+  }
+  /// Normal axis of face \p i (pointing from the left to the right cell)
+  uint_t axis(idx_t i) const noexcept {
+    assert_face(i, HM3_AT_);
+    return axis_[i];
+  }
+  /// Area of face \p i relative to the face of the coarser cell
+  num_t area_fraction(idx_t i) const noexcept {
+    assert_face(i, HM3_AT_);
+    return area_fraction_[i];
+  }
+  /// Color of face \p i
+  uint_t color(idx_t i) const noexcept {
+    assert_face(i, HM3_AT_);
+    return color_[i];
+  }
+  /// Faces of color \p c
+  auto faces_of_color(uint_t c) const noexcept {
+    HM3_ASSERT(c < no_colors(), "color {} out of bounds [0, {})", c,
+               no_colors());
+    return view::iota(color_offsets_[c], color_offsets_[c + 1]);
+  }
+
+  /// Area of face \p i of the solver grid \p g (the area of the face of the
+  /// finer cell)
+  template <typename Grid> num_t area(Grid const& g, idx_t i) const noexcept {
+    constexpr uint_t nd = Grid::tree_t::dimension();
+    const num_t l       = std::min(g.tree().length(g.tree_node(left(i))),
+                                   g.tree().length(g.tree_node(right(i))));
+    num_t a = 1;
+    for (uint_t d = 1; d < nd; ++d) { a *= l; }
+    return a;
+  }
+
+  /// Extracts the faces of the solver grid \p g
+  ///
+  /// Time complexity: O(size(g))
+  template <typename Grid> void build(Grid const& g) {
+    std::vector<grid_node_idx> cells;
+    RANGES_FOR (auto&& n, g.in_use()) {
+      if (g.tree_node(n)) { cells.push_back(n); }
+    }
+    clear();
+    std::vector<face> fs;
+    for (auto&& n : cells) { push_right_faces(g, n, fs); }
+    for (auto&& f : fs) { f.color = invalid_color(); }
+    assign(g, std::move(fs));
+  }
+
+  /// Updates the faces after the solver grid \p g has been adapted, where \p
+  /// cells are the cells created since the last update (e.g. see
+  /// grid::created_since)
+  ///
+  /// The faces of removed cells, and of \p cells and their neighbors, are
+  /// removed, and the faces of \p cells and their neighbors are extracted
+  /// again. The new faces are colored without recoloring the other faces.
+  ///
+  /// Time complexity: O(size() + distance(cells))
+  template <typename Grid, typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  void update(Grid const& g, Rng&& cells) {
+    std::vector<grid_node_idx> dirty;
+    for (auto&& n : cells) {
+      if (!g.tree_node(n)) { continue; }
+      dirty.push_back(n);
+      for (auto&& m : g.neighbors(n)) { dirty.push_back(m); }
+    }
+    std::sort(begin(dirty), end(dirty));
+    dirty.erase(std::unique(begin(dirty), end(dirty)), end(dirty));
+    auto is_dirty = [&](grid_node_idx n) {
+      return std::binary_search(begin(dirty), end(dirty), n);
+    };
+    auto removed = [&](grid_node_idx n) {
+      return g.is_free(n) or !g.tree_node(n) or is_dirty(n);
+    };
+
+    std::vector<face> fs;
+    fs.reserve(size());
+    for (idx_t i = 0, e = size(); i != e; ++i) {
+      if (removed(left_[i]) or removed(right_[i])) { continue; }
+      fs.push_back(
+       face{left_[i], right_[i], axis_[i], area_fraction_[i], color_[i]});
+    }
+    const auto no_kept = fs.size();
+    for (auto&& n : dirty) {
+      push_right_faces(g, n, fs);
+      push_left_faces(g, n, fs, [&](grid_node_idx m) { return !is_dirty(m); });
+    }
+    for (auto i = no_kept, e = fs.size(); i != e; ++i) {
+      fs[i].color = invalid_color();
+    }
+    clear();
+    assign(g, std::move(fs));
+  }
+
+  /// Updates the faces after the solver grid has been sorted with the
+  /// permutation \p p (see grid::sort)
+  void permute(std::vector<grid_node_idx> const& p) {
+    idx_t no_nodes = 0;
+    for (auto&& n : p) { no_nodes = std::max(no_nodes, *n + 1); }
+    std::vector<grid_node_idx> new_idx(no_nodes);
+    for (idx_t i = 0, e = p.size(); i != e; ++i) {
+      new_idx[*p[i]] = grid_node_idx{i};
+    }
+    std::vector<face> fs(size());
+    for (idx_t i = 0, e = size(); i != e; ++i) {
+      fs[i] = face{new_idx[*left_[i]], new_idx[*right_[i]], axis_[i],
+                   area_fraction_[i], color_[i]};
+    }
+    clear();
+    sort_and_store(std::move(fs));
+  }
+
+  /// Calls \p f(i) for all faces: the colors are processed one after the
+  /// other, and the faces of each color in parallel
+  ///
+  /// \p f can scatter to the left and right cells of the face without
+  /// synchronization.
+  template <typename F> void for_each(F&& f) const {
+    for (uint_t c = 0; c != no_colors(); ++c) {
+      parallel::for_each_static(color_offsets_[c], color_offsets_[c + 1],
+                                [&](int_t i) { f(idx_t{i}); });
+    }
+  }
+
+ private:
+  struct face {
+    grid_node_idx left;
+    grid_node_idx right;
+    std::uint8_t axis;
+    num_t area_fraction;
+    std::uint8_t color;
+  };
+
+  static constexpr std::uint8_t invalid_color() noexcept { return 255; }
+
+  template <typename At> void assert_face(idx_t i, At&& at) const noexcept {
+    HM3_ASSERT_AT(i >= 0 and i < size(), "face {} out of bounds [0, {})", at,
+                  i, size());
+  }
+
+  void clear() noexcept {
+    left_.clear();
+    right_.clear();
+    axis_.clear();
+    area_fraction_.clear();
+    color_.clear();
+    color_offsets_.assign(1, 0);
+  }
+
+  /// Calls \p f(m) for the cells m across the face at \p position of the cell
+  /// \p n of the solver grid \p g
+  template <typename Grid, typename F>
+  static void for_each_across(Grid const& g, grid_node_idx n, uint_t position,
+                              F&& f) {
+    for (auto&& m : g.face_neighbors(n, position)) { f(m); }
+  }
+
+  /// Face between the cells \p l and \p r across the axis \p d
+  template <typename Grid>
+  static face make_face(Grid const& g, grid_node_idx l, grid_node_idx r,
+                        uint_t d) {
+    constexpr uint_t nd = Grid::tree_t::dimension();
+    const auto ll       = *g.level(l);
+    const auto lr       = *g.level(r);
+    const uint_t dl     = ll > lr ? ll - lr : lr - ll;
+    const num_t f       = num_t{1} / math::ipow(math::ipow(2_u, nd - 1), dl);
+    return face{l, r, static_cast<std::uint8_t>(d), f, invalid_color()};
+  }
+
+  /// Appends the faces of the cell \p n with the cells on its right
+  template <typename Grid>
+  static void push_right_faces(Grid const& g, grid_node_idx n,
+                               std::vector<face>& fs) {
+    constexpr uint_t nd = Grid::tree_t::dimension();
+    for (uint_t d = 0; d != nd; ++d) {
+      for_each_across(g, n, 2 * d + 1, [&](grid_node_idx m) {
+        if (m != n) { fs.push_back(make_face(g, n, m, d)); }
+      });
+    }
+  }
+
+  /// Appends the faces of the cell \p n with the cells on its left that
+  /// satisfy \p pred
+  template <typename Grid, typename Pred>
+  static void push_left_faces(Grid const& g, grid_node_idx n,
+                              std::vector<face>& fs, Pred&& pred) {
+    constexpr uint_t nd = Grid::tree_t::dimension();
+    for (uint_t d = 0; d != nd; ++d) {
+      for_each_across(g, n, 2 * d, [&](grid_node_idx m) {
+        if (m != n and pred(m)) { fs.push_back(make_face(g, m, n, d)); }
+      });
+    }
+  }
+
+  /// Colors the faces without a color and stores the faces \p fs
+  ///
+  /// Greedy coloring: each face gets the smallest color not used by any other
+  /// face of its cells.
+  template <typename Grid> void assign(Grid const& g, std::vector<face>&& fs) {
+    std::vector<std::uint64_t> used(*g.capacity(), 0);
+    for (auto&& f : fs) {
+      if (f.color == invalid_color()) { continue; }
+      used[*f.left] |= std::uint64_t{1} << f.color;
+      used[*f.right] |= std::uint64_t{1} << f.color;
+    }
+    for (auto&& f : fs) {
+      if (f.color != invalid_color()) { continue; }
+      const std::uint64_t u = used[*f.left] | used[*f.right];
+      std::uint8_t c = 0;
+      while (c != max_no_colors() and (u >> c) & 1) { ++c; }
+      HM3_ASSERT(c != max_no_colors(), "ran out of colors");
+      f.color = c;
+      used[*f.left] |= std::uint64_t{1} << c;
+      used[*f.right] |= std::uint64_t{1} << c;
+    }
+    sort_and_store(std::move(fs));
+  }
+
+  /// Sorts the faces \p fs by (color, left, right) and stores them
+  void sort_and_store(std::vector<face>&& fs) {
+    std::sort(begin(fs), end(fs), [](face const& a, face const& b) {
+      return a.color != b.color
+              ? a.color < b.color
+              : a.left != b.left ? a.left < b.left : a.right < b.right;
+    });
+    const idx_t no_faces = fs.size();
+    left_.resize(no_faces);
+    right_.resize(no_faces);
+    axis_.resize(no_faces);
+    area_fraction_.resize(no_faces);
+    color_.resize(no_faces);
+    color_offsets_.assign(1, 0);
+    for (idx_t i = 0; i != no_faces; ++i) {
+      left_[i]          = fs[i].left;
+      right_[i]         = fs[i].right;
+      axis_[i]          = fs[i].axis;
+      area_fraction_[i] = fs[i].area_fraction;
+      color_[i]         = fs[i].color;
+      while (color_offsets_.size() <= fs[i].color) {
+        color_offsets_.push_back(i);
+      }
+    }
+    if (no_faces != 0) { color_offsets_.push_back(no_faces); }
+  }
+};
+
+}  // namespace state
+}  // namespace solver
+}  // namespace hm3
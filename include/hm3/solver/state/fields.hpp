@@ -0,0 +1,512 @@
+#pragma once
+/// \file
+///
+/// Registry of the solver grid node data fields
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <hm3/io/file.hpp>
+#include <hm3/solver/types.hpp>
+#include <hm3/tree/algorithm/stats.hpp>
+#include <hm3/utility/aligned_allocator.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/parallel.hpp>
+#include <hm3/utility/range.hpp>
+
+namespace hm3 {
+namespace solver {
+namespace state {
+
+/// Differences between the values of the face neighbors of a parent and its
+/// value along each axis, per parent length (see prolongation::linear)
+template <typename T, uint_t Nd> struct slopes {
+  /// Value of the parent - value of its left neighbor
+  std::array<T, Nd> left;
+  /// Value of the right neighbor - value of the parent
+  std::array<T, Nd> right;
+};
+
+/// Rules to initialize the children of a refined node from their parent
+///
+/// Each rule provides:
+/// - apply(field, parent, children): initializes the children of a single
+///   parent,
+/// - apply_group<NoChildren>(parent_value, children_values, slopes):
+///   initializes the NoChildren contiguous values of a sibling group (see
+///   fields::for_each_sibling_group), where the slopes are only computed if
+///   the rule needs_slopes.
+namespace prolongation {
+
+/// The children values are left unchanged
+struct none {
+  static constexpr bool needs_slopes = false;
+  template <typename Field, typename Rng>
+  static void apply(Field&, grid_node_idx, Rng&&) noexcept {}
+  template <uint_t NoChildren, typename T, typename Slopes>
+  static void apply_group(T const&, T*, Slopes const&) noexcept {}
+};
+
+/// The children take the value of their parent (injection)
+struct copy {
+  static constexpr bool needs_slopes = false;
+  template <typename Field, typename Rng>
+  static void apply(Field& f, grid_node_idx parent, Rng&& children) noexcept {
+    const auto v = f(parent);
+    for (auto&& c : children) { f(c) = v; }
+  }
+  template <uint_t NoChildren, typename T, typename Slopes>
+  static void apply_group(T const& parent, T* children,
+                          Slopes const&) noexcept {
+    for (uint_t c = 0; c != NoChildren; ++c) { children[c] = parent; }
+  }
+};
+
+/// Adds the slopes \p s (per parent length) to the values of the children
+/// (at +-1/4 parent length from the parent center along each axis, see
+/// tree::relative_child_position)
+template <uint_t NoChildren, typename T, std::size_t Nd>
+void add_slopes(T const& parent, T* children,
+                std::array<T, Nd> const& s) noexcept {
+  for (uint_t c = 0; c != NoChildren; ++c) {
+    T v = parent;
+    for (std::size_t d = 0; d != Nd; ++d) {
+      v += ((c >> d) & 1 ? T{0.25} : T{-0.25}) * s[d];
+    }
+    children[c] = v;
+  }
+}
+
+/// The children values are linearly interpolated from the parent value using
+/// the central slopes to the face neighbors of the parent (second-order
+/// accurate, conservative)
+///
+/// Without neighbor information (e.g. when refining a single node) the slopes
+/// are zero, i.e. the children take the value of their parent.
+struct linear {
+  static constexpr bool needs_slopes = true;
+  template <typename Field, typename Rng>
+  static void apply(Field& f, grid_node_idx parent, Rng&& children) noexcept {
+    copy::apply(f, parent, children);
+  }
+  template <uint_t NoChildren, typename T, uint_t Nd>
+  static void apply_group(T const& parent, T* children,
+                          slopes<T, Nd> const& s) noexcept {
+    std::array<T, Nd> c;
+    for (uint_t d = 0; d != Nd; ++d) {
+      c[d] = T{0.5} * (s.left[d] + s.right[d]);
+    }
+    add_slopes<NoChildren>(parent, children, c);
+  }
+};
+
+/// As linear, but the slopes are limited with the minmod limiter such that no
+/// new extrema are created (e.g. at discontinuities)
+struct limited_linear {
+  static constexpr bool needs_slopes = true;
+  template <typename Field, typename Rng>
+  static void apply(Field& f, grid_node_idx parent, Rng&& children) noexcept {
+    copy::apply(f, parent, children);
+  }
+  template <uint_t NoChildren, typename T, uint_t Nd>
+  static void apply_group(T const& parent, T* children,
+                          slopes<T, Nd> const& s) noexcept {
+    std::array<T, Nd> c;
+    for (uint_t d = 0; d != Nd; ++d) {
+      const T l = s.left[d], r = s.right[d];
+      c[d] = l * r <= T{0} ? T{0} : (std::abs(l) < std::abs(r) ? l : r);
+    }
+    add_slopes<NoChildren>(parent, children, c);
+  }
+};
+
+}  // namespace prolongation
+
+/// Rules to initialize the parent of coarsened nodes from its children
+///
+/// Each rule provides:
+/// - apply(field, parent, children): initializes the value of a single
+///   parent,
+/// - apply_group<NoChildren>(children_values, parent_value): initializes the
+///   parent value from the NoChildren contiguous values of its children (see
+///   fields::for_each_sibling_group).
+namespace restriction {
+
+/// The parent value is left unchanged
+struct none {
+  template <typename Field, typename Rng>
+  static void apply(Field&, grid_node_idx, Rng&&) noexcept {}
+  template <uint_t NoChildren, typename T>
+  static void apply_group(T const*, T&) noexcept {}
+};
+
+/// The parent takes the average value of its children
+struct average {
+  template <typename Field, typename Rng>
+  static void apply(Field& f, grid_node_idx parent, Rng&& children) noexcept {
+    using value_t = typename Field::value_type;
+    value_t v     = value_t{0};
+    uint_t count  = 0;
+    for (auto&& c : children) {
+      v += f(c);
+      ++count;
+    }
+    HM3_ASSERT(count != 0, "count cannot be equal to zero");
+    f(parent) = v / count;
+  }
+  /// Conservative averaging (the children have the same volume)
+  template <uint_t NoChildren, typename T>
+  static void apply_group(T const* children, T& parent) noexcept {
+    T v = T{0};
+    for (uint_t c = 0; c != NoChildren; ++c) { v += children[c]; }
+    parent = v / NoChildren;
+  }
+};
+
+/// The parent takes the sum of the values of its children (e.g. for extensive
+/// quantities)
+struct sum {
+  template <typename Field, typename Rng>
+  static void apply(Field& f, grid_node_idx parent, Rng&& children) noexcept {
+    using value_t = typename Field::value_type;
+    value_t v     = value_t{0};
+    for (auto&& c : children) { v += f(c); }
+    f(parent) = v;
+  }
+  template <uint_t NoChildren, typename T>
+  static void apply_group(T const* children, T& parent) noexcept {
+    T v = T{0};
+    for (uint_t c = 0; c != NoChildren; ++c) { v += children[c]; }
+    parent = v;
+  }
+};
+
+}  // namespace restriction
+
+/// Field storing a value of type \p T for each solver grid node
+///
+/// The values are stored contiguously in cache-line (64 byte) aligned memory.
+/// When nodes are refined (coarsened) the values of the new nodes are
+/// initialized with the \p Prolongation (\p Restriction) rule.
+template <typename T, typename Prolongation = prolongation::copy,
+          typename Restriction = restriction::average>
+struct field {
+  using value_type     = T;
+  using prolongation_t = Prolongation;
+  using restriction_t  = Restriction;
+
+  /// Name of the field (e.g. in the output files)
+  string name;
+  /// Values of the grid nodes
+  memory::aligned_vector<T> data_;
+
+  field() = default;
+  field(string name_, grid_node_idx capacity, T value = T{})
+   : name(std::move(name_)), data_(*capacity, value) {}
+
+  /// Maximum number of grid nodes
+  grid_node_idx capacity() const noexcept { return data_.size(); }
+
+  T& operator()(grid_node_idx n) noexcept {
+    HM3_ASSERT(n and n < capacity(), "node {} out of bounds [0, {})", n,
+               capacity());
+    return data_[*n];
+  }
+  T const& operator()(grid_node_idx n) const noexcept {
+    HM3_ASSERT(n and n < capacity(), "node {} out of bounds [0, {})", n,
+               capacity());
+    return data_[*n];
+  }
+
+  T* data() noexcept { return data_.data(); }
+  T const* data() const noexcept { return data_.data(); }
+
+  /// Sets the values of all grid nodes to \p v
+  void fill(T const& v) noexcept {
+    for (auto&& i : data_) { i = v; }
+  }
+};
+
+template <typename T, typename P, typename R>
+bool operator==(field<T, P, R> const& a, field<T, P, R> const& b) {
+  return a.name == b.name and a.data_ == b.data_;
+}
+
+template <typename T, typename P, typename R>
+bool operator!=(field<T, P, R> const& a, field<T, P, R> const& b) {
+  return !(a == b);
+}
+
+/// Registry of the \p Fields of a solver
+///
+/// The fields are registered once at compile time. Refining, coarsening,
+/// sorting (permuting), and reading/writing the solver state processes all
+/// fields without per-field code, and without virtual calls (the loops over
+/// the fields are unrolled at compile-time).
+template <typename... Fields> struct fields {
+  std::tuple<Fields...> fields_;
+
+  fields() = default;
+  explicit fields(Fields... fs) : fields_(std::move(fs)...) {}
+
+  /// Number of fields
+  static constexpr std::size_t size() noexcept { return sizeof...(Fields); }
+
+  /// Field \p I
+  template <std::size_t I> auto& get() noexcept {
+    return std::get<I>(fields_);
+  }
+  /// Field \p I
+  template <std::size_t I> auto const& get() const noexcept {
+    return std::get<I>(fields_);
+  }
+
+  /// Calls \p f on each field
+  template <typename F> void for_each(F&& f) {
+    for_each_impl(f, std::index_sequence_for<Fields...>{});
+  }
+  /// Calls \p f on each field
+  template <typename F> void for_each(F&& f) const {
+    for_each_impl(f, std::index_sequence_for<Fields...>{});
+  }
+
+  /// Initializes the \p children of the refined node \p parent using the
+  /// prolongation rule of each field
+  template <typename Rng>
+  void interpolate_from_parent_to_children(grid_node_idx parent,
+                                           Rng&& children) {
+    for_each([&](auto& f) {
+      using field_t = std::decay_t<decltype(f)>;
+      field_t::prolongation_t::apply(f, parent, children);
+    });
+  }
+
+  /// Initializes the \p parent of the coarsened nodes \p children using the
+  /// restriction rule of each field
+  template <typename Rng>
+  void interpolate_from_children_to_parent(grid_node_idx parent,
+                                           Rng&& children) {
+    for_each([&](auto& f) {
+      using field_t = std::decay_t<decltype(f)>;
+      field_t::restriction_t::apply(f, parent, children);
+    });
+  }
+
+  /// Calls \p k(field, i, parent_value, children_values) for each field and
+  /// for each sibling group i of the refinement or coarsening \p batch (see
+  /// grid::refine(range) and grid::coarsen(range))
+  ///
+  /// The children values are passed as a pointer to Batch::no_children()
+  /// contiguous values: if the children are contiguous grid nodes (e.g. after
+  /// grid::refine(range)) it points into the field, otherwise the values are
+  /// gathered into a buffer and scattered back after calling \p k. This lets
+  /// the kernels run fixed-size loops that the compiler vectorizes.
+  ///
+  /// Sibling groups that are only partially in the grid (e.g. after
+  /// grid::coarsen(range) of a sibling group whose siblings are not all in
+  /// the grid) call \p kp(field, i) instead, which must handle any number of
+  /// children (e.g. the apply functions of the rules).
+  ///
+  /// One parallel loop over the sibling groups is performed per field.
+  template <typename Batch, typename Kernel, typename PartialKernel>
+  void for_each_sibling_group(Batch const& batch, Kernel&& k,
+                              PartialKernel&& kp) {
+    constexpr uint_t nc = Batch::no_children();
+    for_each([&](auto& f) {
+      using value_t = typename std::decay_t<decltype(f)>::value_type;
+      parallel::for_each_static(0, batch.size(), [&](int_t i) {
+        std::array<grid_node_idx, nc> cs;
+        uint_t no_cs    = 0;
+        bool contiguous = true;
+        for (auto&& c : batch.children(i)) {
+          HM3_ASSERT(no_cs < nc, "too many children");
+          cs[no_cs]  = c;
+          contiguous = contiguous and *c == *cs[0] + idx_t(no_cs);
+          ++no_cs;
+        }
+        if (no_cs != nc) {
+          kp(f, i);
+          return;
+        }
+        value_t& pv = f(batch.parent(i));
+        if (contiguous) {
+          k(f, i, pv, f.data() + *cs[0]);
+          return;
+        }
+        std::array<value_t, nc> vs;
+        for (uint_t c = 0; c != nc; ++c) { vs[c] = f(cs[c]); }
+        k(f, i, pv, vs.data());
+        for (uint_t c = 0; c != nc; ++c) { f(cs[c]) = vs[c]; }
+      });
+    });
+  }
+
+  /// Initializes the children of all parents of the refinement \p batch
+  /// (see grid::refine(range)) using the prolongation rule of each field
+  ///
+  /// The rules are applied to each sibling group at once (see
+  /// for_each_sibling_group). The slopes of the rules that need them are
+  /// computed from the face neighbors of the parents in the grid of the
+  /// batch.
+  template <typename Batch>
+  void interpolate_from_parents_to_children(Batch const& batch) {
+    constexpr uint_t nc = Batch::no_children();
+    for_each_sibling_group(
+     batch,
+     [&](auto& f, idx_t i, auto const& pv, auto* cv) {
+       using field_t = std::decay_t<decltype(f)>;
+       using rule_t  = typename field_t::prolongation_t;
+       auto s        = compute_slopes<rule_t::needs_slopes>(
+        *batch.grid_, f, batch.parent(i));
+       rule_t::template apply_group<nc>(pv, cv, s);
+     },
+     [&](auto& f, idx_t i) {
+       using field_t = std::decay_t<decltype(f)>;
+       field_t::prolongation_t::apply(f, batch.parent(i), batch.children(i));
+     });
+  }
+
+  /// Initializes all parents of the coarsening \p batch (see
+  /// grid::coarsen(range)) using the restriction rule of each field
+  ///
+  /// The rules are applied to each sibling group at once (see
+  /// for_each_sibling_group).
+  template <typename Batch>
+  void interpolate_from_children_to_parents(Batch const& batch) {
+    constexpr uint_t nc = Batch::no_children();
+    for_each_sibling_group(
+     batch,
+     [&](auto& f, idx_t, auto& pv, auto const* cv) {
+       using field_t = std::decay_t<decltype(f)>;
+       field_t::restriction_t::template apply_group<nc>(cv, pv);
+     },
+     [&](auto& f, idx_t i) {
+       using field_t = std::decay_t<decltype(f)>;
+       field_t::restriction_t::apply(f, batch.parent(i), batch.children(i));
+     });
+  }
+
+  /// Slopes of the field \p f at the node \p n of the grid \p g (see
+  /// prolongation::linear)
+  ///
+  /// The values of the face neighbors across each face are averaged. If a
+  /// face has no neighbors, the slope across the opposite face is used
+  /// (or zero if there is none either).
+  template <typename Grid, typename Field>
+  static auto slopes_at(Grid const& g, Field const& f, grid_node_idx n) {
+    constexpr uint_t nd = Grid::tree_t::dimension();
+    using value_t       = typename Field::value_type;
+    slopes<value_t, nd> s;
+    const auto xn = g.coordinates(n);
+    const num_t l = g.tree().length(g.tree_node(n));
+    for (uint_t d = 0; d != nd; ++d) {
+      bool has[2]     = {false, false};
+      value_t diff[2] = {value_t{0}, value_t{0}};
+      for (uint_t side = 0; side != 2; ++side) {
+        value_t v = value_t{0};
+        num_t dx  = 0.;
+        uint_t no = 0;
+        for (auto&& m : g.face_neighbors(n, 2 * d + side)) {
+          v += f(m);
+          dx += std::abs(g.coordinates(m)(d) - xn(d));
+          ++no;
+        }
+        if (no == 0) { continue; }
+        has[side]  = true;
+        v          = v / no;
+        dx         = dx / no;
+        diff[side] = (side ? v - f(n) : f(n) - v) * (l / dx);
+      }
+      s.left[d]  = has[0] ? diff[0] : diff[1];
+      s.right[d] = has[1] ? diff[1] : diff[0];
+    }
+    return s;
+  }
+
+  /// Swaps the values of the grid nodes \p i and \p j in all fields
+  void swap(grid_node_idx i, grid_node_idx j) noexcept {
+    for_each([&](auto& f) { std::swap(f(i), f(j)); });
+  }
+
+  /// Permutes all fields with the permutation \p p (see grid::sort)
+  ///
+  /// The values are gathered for all fields in a single parallel pass.
+  void permute(std::vector<grid_node_idx> const& p) {
+    const idx_t no_nodes = p.size();
+    std::tuple<memory::aligned_vector<typename Fields::value_type>...> tmp;
+    permute_impl(p, tmp, no_nodes, std::index_sequence_for<Fields...>{});
+  }
+
+  /// Maps the values of the first \p no_nodes grid nodes of each field to the
+  /// file \p f (for reading or writing)
+  void map_arrays(io::file& f, grid_node_idx no_nodes) const {
+    for_each([&](auto const& fd) { f.field(fd.name, fd.data(), *no_nodes); });
+  }
+
+  /// Appends the memory used (by \p no_nodes grid nodes) and reserved by the
+  /// fields to the structure statistics \p s
+  void add_memory_stats(tree::statistics& s, grid_node_idx no_nodes) const {
+    for_each([&](auto const& fd) {
+      using value_t      = typename std::decay_t<decltype(fd)>::value_type;
+      const uint_t bytes = sizeof(value_t);
+      s.memory.push_back({fd.name, *no_nodes * bytes,
+                          static_cast<uint_t>(*fd.capacity()) * bytes});
+    });
+  }
+
+ private:
+  struct no_slopes {};
+
+  template <bool NeedsSlopes, typename Grid, typename Field,
+            std::enable_if_t<NeedsSlopes, int> = 0>
+  static auto compute_slopes(Grid const& g, Field const& f, grid_node_idx n) {
+    return slopes_at(g, f, n);
+  }
+  template <bool NeedsSlopes, typename Grid, typename Field,
+            std::enable_if_t<!NeedsSlopes, int> = 0>
+  static no_slopes compute_slopes(Grid const&, Field const&, grid_node_idx) {
+    return {};
+  }
+
+  template <typename F, std::size_t... Is>
+  void for_each_impl(F& f, std::index_sequence<Is...>) {
+    (void)std::initializer_list<int>{(f(std::get<Is>(fields_)), 0)...};
+  }
+  template <typename F, std::size_t... Is>
+  void for_each_impl(F& f, std::index_sequence<Is...>) const {
+    (void)std::initializer_list<int>{(f(std::get<Is>(fields_)), 0)...};
+  }
+
+  template <typename Tmp, std::size_t... Is>
+  void permute_impl(std::vector<grid_node_idx> const& p, Tmp& tmp,
+                    idx_t no_nodes, std::index_sequence<Is...>) {
+    (void)std::initializer_list<int>{
+     (std::get<Is>(tmp).resize(no_nodes), 0)...};
+    parallel::for_each_static(0, no_nodes, [&](int_t i) {
+      (void)std::initializer_list<int>{
+       (std::get<Is>(tmp)[i] = std::get<Is>(fields_).data_[*p[i]], 0)...};
+    });
+    parallel::for_each_static(0, no_nodes, [&](int_t i) {
+      (void)std::initializer_list<int>{
+       (std::get<Is>(fields_).data_[i] = std::get<Is>(tmp)[i], 0)...};
+    });
+  }
+};
+
+template <typename... Fields>
+bool operator==(fields<Fields...> const& a, fields<Fields...> const& b) {
+  return a.fields_ == b.fields_;
+}
+
+template <typename... Fields>
+bool operator!=(fields<Fields...> const& a, fields<Fields...> const& b) {
+  return !(a == b);
+}
+
+}  // namespace state
+}  // namespace solver
+}  // namespace hm3
@@ -0,0 +1,293 @@
+#pragma once
+/// \file
+///
+/// Layer of ghost cells around the boundaries of a solver grid
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <hm3/solver/types.hpp>
+#include <hm3/tree/algorithm/node_location.hpp>
+#include <hm3/tree/algorithm/node_neighbor.hpp>
+#include <hm3/tree/algorithm/node_or_parent_at.hpp>
+#include <hm3/tree/algorithm/shift_location.hpp>
+#include <hm3/tree/relations/neighbor.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/range.hpp>
+
+namespace hm3 {
+namespace solver {
+namespace state {
+
+/// Kind of boundary across a face of a solver grid cell
+enum class boundary_kind : std::uint8_t {
+  none,    ///< the face is interior to the grid
+  domain,  ///< the face lies on the boundary of the computational domain
+  grid     ///< the face lies on the boundary with the rest of the tree
+};
+
+/// Layer of ghost cells around the boundaries of a solver grid
+///
+/// For each boundary face of a cell of the solver grid, width() ghost cells
+/// are appended to the solver grid. Ghost cells are grid nodes without a tree
+/// node. Each ghost stores the cell it is attached to (its owner), the face
+/// and layer it lies at, and the interior cell it mirrors (its source), such
+/// that boundary conditions can be applied in a single loop over the ghosts,
+/// and stencil loops over the interior cells do not need to branch on
+/// missing neighbors.
+///
+/// After build() on a compact grid, the ghost cells form a contiguous range
+/// at the end of the grid nodes. Ghosts added by update() fill the holes left
+/// by AMR: sorting the grid (which moves the grid nodes without a tree node
+/// to the end) and permuting the ghost layer restores contiguity.
+struct ghost_layer {
+  /// Ghost cell
+  struct ghost {
+    /// Grid node of the ghost
+    grid_node_idx node;
+    /// Grid node of the cell the ghost is attached to
+    grid_node_idx owner;
+    /// Grid node of the interior cell mirrored by the ghost (e.g. for
+    /// symmetry boundary conditions)
+    grid_node_idx source;
+    /// Position of the face of the owner (see tree::face_neighbors)
+    std::uint8_t position;
+    /// Layer of the ghost: 1 (adjacent to the owner), ..., width
+    std::uint8_t layer;
+    /// Kind of boundary across the face
+    boundary_kind kind;
+  };
+
+  /// Ghost cells sorted by (owner, position, layer)
+  std::vector<ghost> ghosts_;
+  /// Number of ghost layers
+  uint_t width_ = 1;
+
+  ghost_layer() = default;
+  explicit ghost_layer(uint_t width) : width_(width) {
+    HM3_ASSERT(width > 0 and width < 256, "invalid ghost layer width {}",
+               width);
+  }
+
+  /// Number of ghost layers
+  uint_t width() const noexcept { return width_; }
+  /// Number of ghost cells
+  idx_t size() const noexcept { return ghosts_.size(); }
+  /// Ghost cells sorted by (owner, position, layer)
+  std::vector<ghost> const& operator()() const noexcept { return ghosts_; }
+
+  /// Ghost cell at \p layer across the face at \p position of the cell \p
+  /// owner (invalid grid node if the face is not a boundary face)
+  ///
+  /// Time complexity: O(log(size()))
+  grid_node_idx operator()(grid_node_idx owner, uint_t position,
+                           uint_t layer = 1) const noexcept {
+    auto it = std::lower_bound(
+     begin(ghosts_), end(ghosts_), key(owner, position, layer),
+     [](ghost const& a, ghost const& b) { return less(a, b); });
+    return it != end(ghosts_) and it->owner == owner
+               and it->position == position and it->layer == layer
+            ? it->node
+            : grid_node_idx{};
+  }
+
+  /// Kind of boundary across the face at \p position of the cell \p n of the
+  /// solver grid \p g
+  template <typename Grid>
+  static boundary_kind boundary(Grid const& g, grid_node_idx n,
+                                uint_t position) noexcept {
+    using manifold = tree::face_neighbors<Grid::tree_t::dimension()>;
+    auto&& t       = g.tree();
+    const auto gi  = g.idx();
+    const auto tn  = g.tree_node(n);
+    HM3_ASSERT(tn, "cell {} has no tree node", n);
+    const auto p   = manifold::idx(position);
+    const auto loc = tree::node_location(t, tn);
+    const auto nb
+     = tree::node_or_parent_at(
+        t, tree::shift_location(loc, manifold{}[p], t.periodicity()))
+        .idx;
+    if (!nb) { return boundary_kind::domain; }
+    if (t.in_grid(nb, gi)) { return boundary_kind::none; }
+    if (t.is_leaf(nb)) {
+      return !t.is_root(nb) and t.in_grid(t.parent(nb), gi)
+              ? boundary_kind::none
+              : boundary_kind::grid;
+    }
+    for (auto&& cp : manifold::children_sharing_face(p)) {
+      if (t.in_grid(t.child(nb, cp), gi)) { return boundary_kind::none; }
+    }
+    return boundary_kind::grid;
+  }
+
+  /// Removes all ghost cells from the solver grid \p g
+  template <typename Grid> void clear(Grid& g) {
+    for (auto&& gh : ghosts_) { g.pop(gh.node); }
+    ghosts_.clear();
+  }
+
+  /// Builds the ghost cells of all boundary faces of the solver grid \p g
+  ///
+  /// If \p g is compact, the ghosts are contiguous at the end of the grid
+  /// nodes.
+  ///
+  /// Time complexity: O(size(g))
+  template <typename Grid> void build(Grid& g) {
+    clear(g);
+    std::vector<grid_node_idx> cells;
+    RANGES_FOR (auto&& n, g.in_use()) {
+      if (g.tree_node(n)) { cells.push_back(n); }
+    }
+    for (auto&& n : cells) { push(g, n); }
+    sort();
+  }
+
+  /// Updates the ghost cells after the solver grid \p g has been adapted, where
+  /// \p cells are the cells created since the last update (e.g. see
+  /// grid::created_since)
+  ///
+  /// The ghosts of \p cells and of their neighbors are recreated. The other
+  /// ghosts are only removed if their owner or source was removed (or
+  /// replaced by a new cell), or if their face is no longer a boundary face.
+  ///
+  /// Note: if cells are removed from the grid without being replaced (i.e.
+  /// the grid shrinks) the ghost layer must be rebuilt.
+  ///
+  /// Time complexity: O(size() * log(distance(cells)) + distance(cells))
+  template <typename Grid, typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  void update(Grid& g, Rng&& cells) {
+    // the new cells and their neighbors:
+    std::vector<grid_node_idx> created, owners;
+    for (auto&& n : cells) {
+      if (!g.tree_node(n)) { continue; }
+      created.push_back(n);
+      owners.push_back(n);
+      for (auto&& m : g.neighbors(n)) { owners.push_back(m); }
+    }
+    std::sort(begin(created), end(created));
+    std::sort(begin(owners), end(owners));
+    owners.erase(std::unique(begin(owners), end(owners)), end(owners));
+
+    // remove their ghosts and the stale ones. A removed cell might have been
+    // replaced by a new cell at the same grid node, so ghosts whose source is
+    // a new cell are stale too (with width() > 1 the source is not
+    // necessarily a neighbor of the owner):
+    auto removed = [&](grid_node_idx n) {
+      return g.is_free(n) or !g.tree_node(n);
+    };
+    auto stale = [&](ghost const& gh) {
+      return removed(gh.owner) or removed(gh.source)
+             or std::binary_search(begin(owners), end(owners), gh.owner)
+             or std::binary_search(begin(created), end(created), gh.source)
+             or boundary(g, gh.owner, gh.position) != gh.kind;
+    };
+    for (auto&& gh : ghosts_) {
+      if (stale(gh)) {
+        g.pop(gh.node);
+        gh.node = grid_node_idx{};
+      }
+    }
+    ghosts_.erase(std::remove_if(begin(ghosts_), end(ghosts_),
+                                 [](ghost const& gh) { return !gh.node; }),
+                  end(ghosts_));
+
+    for (auto&& n : owners) { push(g, n); }
+    sort();
+  }
+
+  /// Updates the ghost cells after the solver grid has been sorted with the
+  /// permutation \p p (see grid::sort)
+  void permute(std::vector<grid_node_idx> const& p) {
+    idx_t no_nodes = 0;
+    for (auto&& n : p) { no_nodes = std::max(no_nodes, *n + 1); }
+    std::vector<grid_node_idx> new_idx(no_nodes);
+    for (idx_t i = 0, e = p.size(); i != e; ++i) {
+      new_idx[*p[i]] = grid_node_idx{i};
+    }
+    for (auto&& gh : ghosts_) {
+      gh.node   = new_idx[*gh.node];
+      gh.owner  = new_idx[*gh.owner];
+      gh.source = new_idx[*gh.source];
+    }
+    sort();
+  }
+
+  /// Are the ghost cells the last size() grid nodes of the solver grid \p g?
+  template <typename Grid> bool is_contiguous(Grid const& g) const noexcept {
+    const idx_t first = *g.size() - size();
+    return g.is_compact() and all_of(ghosts_, [&](ghost const& gh) {
+             return *gh.node >= first;
+           });
+  }
+
+  /// Center coordinates of the ghost cell \p gh of the solver grid \p g
+  template <typename Grid>
+  static auto coordinates(Grid const& g, ghost const& gh) noexcept {
+    using manifold = tree::face_neighbors<Grid::tree_t::dimension()>;
+    auto&& t       = g.tree();
+    const auto tn  = g.tree_node(gh.owner);
+    auto x         = t.coordinates(tn);
+    const num_t l  = gh.layer * t.length(tn);
+    const auto o   = manifold{}[manifold::idx(gh.position)];
+    for (auto&& d : t.dimensions()) { x(d) += l * o[d]; }
+    return x;
+  }
+
+ private:
+  template <typename Grid> static constexpr uint_t no_faces(Grid const&) {
+    return tree::face_neighbors<Grid::tree_t::dimension()>::size();
+  }
+
+  static ghost key(grid_node_idx owner, uint_t position, uint_t layer) {
+    return ghost{grid_node_idx{}, owner, grid_node_idx{},
+                 static_cast<std::uint8_t>(position),
+                 static_cast<std::uint8_t>(layer), boundary_kind::none};
+  }
+
+  static bool less(ghost const& a, ghost const& b) noexcept {
+    return a.owner != b.owner
+            ? a.owner < b.owner
+            : a.position != b.position ? a.position < b.position
+                                       : a.layer < b.layer;
+  }
+
+  void sort() {
+    std::sort(begin(ghosts_), end(ghosts_),
+              [](ghost const& a, ghost const& b) { return less(a, b); });
+  }
+
+  /// Pushes the ghosts of all boundary faces of the cell \p n
+  template <typename Grid> void push(Grid& g, grid_node_idx n) {
+    for (uint_t position = 0; position != no_faces(g); ++position) {
+      push(g, n, position);
+    }
+  }
+
+  /// Pushes the ghosts of the face at \p position of the cell \p n (if it is a
+  /// boundary face)
+  ///
+  /// The ghost at layer l mirrors the (l - 1)-th same-level cell in the grid
+  /// opposite to the face (or the last one found if the grid is too thin).
+  template <typename Grid>
+  void push(Grid& g, grid_node_idx n, uint_t position) {
+    using manifold = tree::face_neighbors<Grid::tree_t::dimension()>;
+    const auto kind = boundary(g, n, position);
+    if (kind == boundary_kind::none) { return; }
+    auto&& t        = g.tree();
+    const auto away = tree::opposite(manifold::idx(position));
+    auto source     = n;
+    for (uint_t layer = 1; layer <= width(); ++layer) {
+      if (layer > 1) {
+        const auto tn = tree::node_neighbor(t, g.tree_node(source), away);
+        if (tn and t.in_grid(tn, g.idx())) { source = g.in_tree(tn); }
+      }
+      const auto gn = g.push(tree_node_idx{});
+      ghosts_.push_back(ghost{gn, n, source,
+                              static_cast<std::uint8_t>(position),
+                              static_cast<std::uint8_t>(layer), kind});
+    }
+  }
+};
+
+}  // namespace state
+}  // namespace solver
+}  // namespace hm3
@@ -3,8 +3,17 @@
 ///
 ///
 /// Stores a solver grid in sync with the tree
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
 #include <hm3/grid/grid.hpp>
 #include <hm3/solver/types.hpp>
+#include <hm3/tree/algorithm/node_location.hpp>
+#include <hm3/tree/algorithm/node_or_parent_at.hpp>
+#include <hm3/tree/algorithm/shift_location.hpp>
+#include <hm3/utility/parallel.hpp>
 
 namespace hm3 {
 namespace solver {
@@ -15,15 +24,48 @@ namespace state {
 /// For each solver grid node, it stores its corresponding tree node (if any),
 /// and it also stores the solver node within the tree.
 ///
-/// \note The solver grid is allowed to have holes in it.
+/// \note The solver grid is allowed to have holes in it. The free grid nodes
+/// below the last grid node in use are kept in a stack, such that pushing and
+/// popping grid nodes is O(1).
 /// \note Solver grid nodes do not necessarily need to be part of the grid
 /// tree. For example ghost nodes might not exist within the tree.
-template <uint_t Nd> struct grid {
-  using tree_t = ::hm3::grid::mhc<Nd>;
+///
+/// The tree node indices are stored using the integer type \p Idx (see
+/// tree::tree). The solver grid is stored in the multi tree grid \p TreeGrid
+/// (e.g. grid::mhc, or grid::mhc_forest for non-cubic domains).
+template <uint_t Nd, typename Idx = idx_t,
+          typename TreeGrid = ::hm3::grid::mhc<Nd, Idx>>
+struct grid {
+  using tree_t = TreeGrid;
+  /// Tree node index as stored in memory
+  using stored_tree_node_idx = tree_node_idx_storage<Idx>;
+
+  /// Kind of change of a grid node recorded in the change journal
+  enum class change_kind : std::uint8_t {
+    created,  ///< the grid node was pushed
+    removed,  ///< the grid node was popped
+    swapped,  ///< the grid nodes node and from were swapped
+    sorted,   ///< the grid was sorted (followed by the moved grid nodes)
+    moved     ///< the grid node from was moved to node (during a sort)
+  };
+
+  /// Change of a grid node recorded in the change journal
+  struct change {
+    change_kind kind;
+    /// Grid node changed
+    grid_node_idx node;
+    /// Swapped/moved: the other grid node
+    grid_node_idx from;
+    /// Created/removed: the tree node of the grid node (if any)
+    tree_node_idx tree_node;
+  };
+
+  /// Position in the change journal (see journal_marker)
+  using journal_marker_t = idx_t;
 
  private:
   using tree_node_ids
-   = dense::vector<tree_node_idx, dense::dynamic, grid_node_idx>;
+   = dense::vector<stored_tree_node_idx, dense::dynamic, grid_node_idx>;
   using bit_vector = dense::vector<dense::bit, dense::dynamic, grid_node_idx>;
 
   /// \name Data members
@@ -36,12 +78,26 @@ template <uint_t Nd> struct grid {
   tree_node_ids tree_node_ids_;
   /// Stores if a grid node is free or in use (allows holes)
   bit_vector is_free_;
+  /// Stack of the free grid nodes below end_
+  std::vector<grid_node_idx> free_nodes_;
+  /// One past the last grid node that might be in use: all grid nodes
+  /// in [end_, capacity) are free
+  grid_node_idx end_ = 0_gn;
+  /// Are free_nodes_ and end_ up-to-date? (swapping grid nodes invalidates
+  /// them)
+  bool has_free_nodes_ = true;
   /// Number of grid nodes currently stored.
   ///
   /// This is equivalent to one past the last node stored if the nodes are
   /// compact (i.e. there are no free nodes between the first and the last
   /// node)
   grid_node_idx size_ = 0_gn;
+  /// Changes since the first marker of the journal
+  std::vector<change> journal_;
+  /// Marker of the first change in journal_
+  journal_marker_t journal_begin_ = 0;
+  /// Are changes being recorded?
+  bool has_journal_ = false;
   /// Smallest level in the grid
   level_idx min_level;
   /// Largest level in the grid.
@@ -66,6 +122,22 @@ template <uint_t Nd> struct grid {
   /// Solver grid data
   auto data() const noexcept { return tree_node_ids_.data(); }
 
+  /// Appends the memory used and reserved by the solver grid to the structure
+  /// statistics \p s
+  void add_memory_stats(tree::statistics& s) const {
+    const uint_t bytes = sizeof(stored_tree_node_idx);
+    const uint_t used  = *size();
+    const uint_t cap   = *capacity();
+    s.memory.push_back({"solver_grid_" + std::to_string(*idx()) + "_tree_nodes",
+                        used * bytes, cap * bytes});
+    s.memory.push_back({"solver_grid_" + std::to_string(*idx()) + "_is_free",
+                        (used + 7) / 8, (cap + 7) / 8});
+    s.memory.push_back(
+     {"solver_grid_" + std::to_string(*idx()) + "_free_nodes",
+      free_nodes_.size() * sizeof(grid_node_idx),
+      free_nodes_.capacity() * sizeof(grid_node_idx)});
+  }
+
  private:
   template <typename At>
   static void assert_valid(tree_node_idx n, At&& at) noexcept {
@@ -78,29 +150,30 @@ template <uint_t Nd> struct grid {
     assert_valid(i, HM3_AT_);
     return tree().node(i, idx());
   }
-  /// Solver grid node index at tree node \p i
-  grid_node_idx& in_tree(tree_node_idx i) noexcept {
+
+ private:
+  /// Sets the solver grid node at tree node \p i to \p n
+  void set_in_tree(tree_node_idx i, grid_node_idx n) noexcept {
     assert_valid(i, HM3_AT_);
-    return tree().node(i, idx());
+    tree().node(i, idx()) = n;
   }
 
-  /// Tree node of grid node \p n
-  tree_node_idx& tree_node(grid_node_idx n) noexcept {
-    assert_in_use(n, HM3_AT_);
-    auto& tn = tree_node_ids_(n);
-// In the paraview plugin the grid doesn't need to load the grid ids
-#ifndef HM3_PARAVIEW_PLUGIN
-    HM3_ASSERT(
-     (tn and in_tree(tn) == n) || !tn,
-     "grid node {} has tree node {} but tree node {} has grid node {}", n, tn,
-     tn, in_tree(tn));
-#endif
-    return tn;
+  /// Tree node stored at grid node \p n (the grid node might be free)
+  tree_node_idx stored_tree_node(grid_node_idx n) const noexcept {
+    return compact_optional_cast<tree_node_idx>(tree_node_ids_(n));
+  }
+
+  /// Sets the tree node of grid node \p n to \p tn
+  void set_tree_node(grid_node_idx n, tree_node_idx tn) noexcept {
+    assert_within_capacity(n, HM3_AT_);
+    tree_node_ids_(n) = compact_optional_cast<stored_tree_node_idx>(tn);
   }
+
+ public:
   /// Tree node of grid node \p n
   tree_node_idx tree_node(grid_node_idx n) const noexcept {
     assert_in_use(n, HM3_AT_);
-    const auto tn = tree_node_ids_(n);
+    const auto tn = stored_tree_node(n);
 // In the paraview plugin the grid doesn't need to load the grid ids
 #ifndef HM3_PARAVIEW_PLUGIN
     HM3_ASSERT(
@@ -152,6 +225,37 @@ template <uint_t Nd> struct grid {
     return gs;
   }
 
+  /// Neighbors of grid node \p n in grid across its face at \p position (see
+  /// tree::face_neighbors): either one neighbor at the same or the parent
+  /// level, or the neighbors at the children level sharing the face
+  auto face_neighbors(grid_node_idx n, uint_t position) const noexcept {
+    using manifold = tree::face_neighbors<tree_t::dimension()>;
+    stack::vector<grid_node_idx, tree_t::no_children()> gs;
+    auto tn = tree_node(n);
+    HM3_ASSERT(tn, "grid node {} is not part of the tree grid", n);
+    auto&& t       = tree();
+    const auto p   = manifold::idx(position);
+    const auto loc = tree::node_location(t, tn);
+    const auto nb
+     = tree::node_or_parent_at(
+        t, tree::shift_location(loc, manifold{}[p], t.periodicity()))
+        .idx;
+    if (!nb) { return gs; }
+    if (t.in_grid(nb, idx())) {
+      gs.push_back(in_tree(nb));
+    } else if (t.is_leaf(nb)) {
+      if (!t.is_root(nb) and t.in_grid(t.parent(nb), idx())) {
+        gs.push_back(in_tree(t.parent(nb)));
+      }
+    } else {
+      for (auto&& cp : manifold::children_sharing_face(p)) {
+        const auto c = t.child(nb, cp);
+        if (t.in_grid(c, idx())) { gs.push_back(in_tree(c)); }
+      }
+    }
+    return gs;
+  }
+
   /// Level of grid node \p n
   auto level(grid_node_idx n) const noexcept {
     auto tn = tree_node(n);
@@ -168,14 +272,12 @@ template <uint_t Nd> struct grid {
                   capacity());
   }
 
- private:
   /// Is the grid node \p n free?
   bool is_free(grid_node_idx n) const noexcept {
     assert_within_capacity(n, HM3_AT_);
     return is_free_(n);
   }
 
- public:
   /// Asserts that the grid node \p n is in use (i.e. it is not a free node)
   template <typename At>
   void assert_in_use(grid_node_idx n, At&& at_) const noexcept {
@@ -184,17 +286,87 @@ template <uint_t Nd> struct grid {
   }
 
  private:
-  /// Returns the position of a free grid node
-  grid_node_idx free_node() const noexcept {
-    // auto i = is_free_.find_next(hint);
+  /// Returns the position of the first free grid node
+  ///
+  /// Time complexity: O(capacity / 64)
+  grid_node_idx first_free_node() const noexcept {
     auto i = is_free_.find_first();
     return i == is_free_.npos() ? grid_node_idx{} : grid_node_idx{i};
   }
 
+  /// Rebuilds the stack of free grid nodes from the bitset
+  ///
+  /// Time complexity: O(end_)
+  void update_free_nodes() {
+    if (has_free_nodes_) { return; }
+    free_nodes_.clear();
+    end_ = 0_gn;
+    for (idx_t n = 0, no_in_use = 0; no_in_use != *size() and n != *capacity();
+         ++n) {
+      if (!is_free_(grid_node_idx{n})) {
+        end_ = grid_node_idx{n + 1};
+        ++no_in_use;
+      }
+    }
+    for (idx_t n = *end_ - 1; n >= 0; --n) {
+      const grid_node_idx sn{n};
+      if (is_free_(sn)) { free_nodes_.push_back(sn); }
+    }
+    has_free_nodes_ = true;
+  }
+
+  /// One past the last grid node that might be in use
+  grid_node_idx used_end() const noexcept {
+    return has_free_nodes_ ? end_ : capacity();
+  }
+
+  /// Returns the position of a free grid node (the last node freed, or the
+  /// first node past the last node in use)
+  ///
+  /// Time complexity: O(1) amortized
+  grid_node_idx free_node() {
+    update_free_nodes();
+    if (!free_nodes_.empty()) { return free_nodes_.back(); }
+    return end_ < capacity() ? end_ : grid_node_idx{};
+  }
+
+  /// Marks the free grid node \p sn as in use
+  void allocate(grid_node_idx sn) noexcept {
+    HM3_ASSERT(is_free(sn), "node {} is not free", sn);
+    if (!free_nodes_.empty() and free_nodes_.back() == sn) {
+      free_nodes_.pop_back();
+    } else {
+      HM3_ASSERT(sn >= end_, "node {} is not on top of the free stack", sn);
+      end_ = grid_node_idx{*sn + 1};
+    }
+    is_free_(sn) = false;
+    ++size_;
+  }
+
+  /// Records the change \p c in the journal (if enabled)
+  void record(change c) {
+    if (has_journal_) { journal_.push_back(c); }
+  }
+
+  /// Connects the allocated grid node \p sn with the tree node \p n (if any)
+  void connect(grid_node_idx sn, tree_node_idx n) {
+    record(change{change_kind::created, sn, grid_node_idx{}, n});
+    if (n) {
+      HM3_ASSERT(
+       !in_tree(n),
+       "tree node \"{}\" already has a valid grid node \"{}\" in grid \"{}\"",
+       n, in_tree(n), idx());
+      set_tree_node(sn, n);
+      set_in_tree(n, sn);
+      update_minmax_level(n);
+    }  // else we push a new grid node without a connection with the tree
+  }
+
  public:
   /// Are the grid nodes contiguous
   bool is_compact() const noexcept {
-    return !free_node() or free_node() == size();
+    if (has_free_nodes_ and free_nodes_.empty()) { return true; }
+    return !first_free_node() or first_free_node() == size();
   }
 
   /// Swaps the positions of two grid nodes
@@ -213,20 +385,15 @@ template <uint_t Nd> struct grid {
 
     assert_within_capacity(i, HM3_AT_);
     assert_within_capacity(j, HM3_AT_);
-    HM3_ASSERT((is_free(j) and !tree_node_ids_(j))
-                or (!is_free(j) and tree_node_ids_(j)),
-               "");
-    HM3_ASSERT((is_free(i) and !tree_node_ids_(i))
-                or (!is_free(i) and tree_node_ids_(i)),
-               "");
-
-    if (tree_node_ids_(i) && tree_node_ids_(j)) {
-      ranges::swap(in_tree(tree_node_ids_(i)), in_tree(tree_node_ids_(j)));
-    } else if (tree_node_ids_(i)) {
-      in_tree(tree_node_ids_(i)) = j;
-    } else if (tree_node_ids_(j)) {
-      in_tree(tree_node_ids_(j)) = i;
-    }
+    const auto tn_i = stored_tree_node(i);
+    const auto tn_j = stored_tree_node(j);
+    HM3_ASSERT((is_free(j) and !tn_j) or (!is_free(j) and tn_j), "");
+    HM3_ASSERT((is_free(i) and !tn_i) or (!is_free(i) and tn_i), "");
+
+    if (i != j) { record(change{change_kind::swapped, i, j, tree_node_idx{}}); }
+    if (tn_i) { set_in_tree(tn_i, j); }
+    if (tn_j) { set_in_tree(tn_j, i); }
+    if (is_free_(i) != is_free_(j)) { has_free_nodes_ = false; }
     {
       bool tmp = is_free_(i);
       is_free_(i) = is_free_(j);
@@ -260,10 +427,11 @@ template <uint_t Nd> struct grid {
     return boxed_ints<grid_node_idx>(0_gn, size());
   }
 
-  /// Range of solver grid nodes in use (slow, doesn't require contiguous
-  /// nodes)
+  /// Range of solver grid nodes in use (doesn't require contiguous nodes)
+  ///
+  /// Time complexity: O(size + no holes) (it does not scan the capacity).
   auto in_use() const noexcept {
-    return boxed_ints<grid_node_idx>(0_gn, capacity())
+    return boxed_ints<grid_node_idx>(0_gn, used_end())
            | view::filter([&](grid_node_idx n) { return !is_free(n); })
            | view::take(*size());
   }
@@ -297,47 +465,110 @@ template <uint_t Nd> struct grid {
 
  public:
   /// Push grid node into solver nodes and get solver node
+  ///
+  /// Time complexity: O(1) amortized.
   grid_node_idx push(tree_node_idx n) {
     auto sn = free_node();
-    HM3_ASSERT(is_free(sn), "node {} is not free", sn);
-    if (sn >= capacity()) {
+    if (!sn) {
       /// TODO: this should probably throw to allow writing a checkpoint
       /// before dying
       HM3_FATAL_ERROR("cannot push node: ran out of memory");
     }
-    is_free_(sn) = false;
-
-    if (n) {
-      HM3_ASSERT(
-       !in_tree(n),
-       "tree node \"{}\" already has a valid grid node \"{}\" in grid \"{}\"",
-       n, in_tree(n), idx());
-      tree_node(sn) = n;
-      in_tree(n) = sn;
-      update_minmax_level(n);
-    }  // else we push a new grid node without a connection with the tree
-    ++size_;
+    allocate(sn);
+    connect(sn, n);
     return sn;
   }
 
+  /// Maximum number of tree nodes pushed at once
+  static constexpr uint_t max_batch_size() noexcept {
+    return tree_t::no_children();
+  }
+
+  /// Push the tree nodes \p ns (e.g. a sibling group) into solver nodes and get
+  /// their solver nodes
+  ///
+  /// The solver nodes are reserved at once past the last node in use, such
+  /// that they are contiguous. If there is no space left there, the holes are
+  /// filled instead.
+  ///
+  /// Time complexity: O(distance(ns)) amortized.
+  template <typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  auto push(Rng&& ns) {
+    stack::vector<grid_node_idx, max_batch_size()> sns;
+    update_free_nodes();
+    const idx_t no_nodes = distance(ns);
+    HM3_ASSERT(no_nodes <= max_batch_size(),
+               "cannot push {} nodes at once (max: {})", no_nodes,
+               max_batch_size());
+    if (*end_ + no_nodes <= *capacity()) {
+      grid_node_idx sn = end_;
+      for (auto&& n : ns) {
+        allocate(sn);
+        connect(sn, n);
+        sns.push_back(sn);
+        ++sn;
+      }
+    } else {
+      for (auto&& n : ns) { sns.push_back(push(n)); }
+    }
+    return sns;
+  }
+
   /// Pop solver node \p sn
   ///
-  /// \todo Provide a way to pop a sibling group (since this is typically what
-  /// AMR does). Maybe one should provide this in grid::adaptor::multi as
-  /// well.
+  /// To pop many nodes at once (e.g. sibling groups) see pop(range).
   void pop(grid_node_idx sn) {
-    assert_in_use(sn, HM3_AT_);
-    auto gn = tree_node(sn);
-    tree_node(sn) = tree_node_idx{};
-    is_free_(sn) = true;
+    auto gn = release(sn);
     if (gn) {
       HM3_ASSERT(in_tree(gn) == sn, "");
       tree().remove(gn, idx());
     }
+  }
+
+  /// Pop the solver nodes \p sns
+  ///
+  /// The grid nodes are removed from the tree in a single pass at the end (see
+  /// grid::adaptor::multi::remove).
+  template <typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  void pop(Rng&& sns) {
+    std::vector<tree_node_idx> gns;
+    for (auto&& sn : sns) {
+      auto gn = release(sn);
+      if (gn) {
+        HM3_ASSERT(in_tree(gn) == sn, "");
+        gns.push_back(gn);
+      }
+    }
+    tree().remove(gns, idx());
+  }
+
+ private:
+  /// Frees the solver node \p sn and returns its tree node (the tree is not
+  /// modified)
+  tree_node_idx release(grid_node_idx sn) {
+    assert_in_use(sn, HM3_AT_);
+    auto gn = tree_node(sn);
+    record(change{change_kind::removed, sn, grid_node_idx{}, gn});
+    set_tree_node(sn, tree_node_idx{});
+    is_free_(sn) = true;
+    if (has_free_nodes_) {
+      if (*sn + 1 == *end_) {
+        --end_;
+        while (!free_nodes_.empty() and *free_nodes_.back() + 1 == *end_) {
+          free_nodes_.pop_back();
+          --end_;
+        }
+      } else {
+        free_nodes_.push_back(sn);
+      }
+    }
     --size_;
     HM3_ASSERT(is_free(sn), "");
+    return gn;
   }
 
+ public:
+
   /// Coordinates of grid node \p n
   auto coordinates(grid_node_idx n) const noexcept {
     return tree().coordinates(tree_node(n));
@@ -351,10 +582,12 @@ template <uint_t Nd> struct grid {
   /// node
   /// is remove from the grid;
   ///
+  /// It models a refinement batch with a single parent (see refine_batch_t)
+  /// without allocating memory.
   struct refine_t {
-    grid& grid_;
+    grid* grid_;
     grid_node_idx parent_;
-    refine_t(grid& g, grid_node_idx n) : grid_{g}, parent_{std::move(n)} {}
+    refine_t(grid& g, grid_node_idx n) : grid_{&g}, parent_{std::move(n)} {}
     refine_t(refine_t&& other) : grid_{other.grid_}, parent_{other.parent_} {
       other.parent_ = grid_node_idx{};
     }
@@ -364,12 +597,23 @@ template <uint_t Nd> struct grid {
 
     ~refine_t() {
       if (!parent_) { return; }
-      grid_.pop(parent_);
+      grid_->pop(parent_);
     }
     auto operator()() const noexcept {
-      return grid_.tree().children(grid_.tree_node(parent_))
-             | grid_.tree().in_grid(grid_.idx()) | grid_.to_grid_nodes();
+      return grid_->tree().children(grid_->tree_node(parent_))
+             | grid_->tree().in_grid(grid_->idx()) | grid_->to_grid_nodes();
     }
+
+    /// Number of children of the parent
+    static constexpr uint_t no_children() noexcept {
+      return tree_t::no_children();
+    }
+    /// Number of refined parents (one)
+    static constexpr idx_t size() noexcept { return 1; }
+    /// Refined parent
+    grid_node_idx parent(idx_t) const noexcept { return parent_; }
+    /// Children of the refined parent
+    auto children(idx_t) const noexcept { return (*this)(); }
   };
 
   /// Refine grid node \p n
@@ -381,33 +625,45 @@ template <uint_t Nd> struct grid {
     if (distance(child_nodes) == 0) {
       HM3_FATAL_ERROR("couldn't refine node {}", n);
     }
-    for (auto&& i : child_nodes) {
-      HM3_ASSERT(i, "invalid child node");
-      push(i);
-    }
+    push(child_nodes);
     return {*this, n};
   }
 
+  /// It models a coarsening batch with a single parent (see coarsen_batch_t)
+  /// without allocating memory.
   struct coarsen_t {
-    grid& grid_;
+    grid* grid_;
     grid_node_idx parent_;
-    coarsen_t(grid& g, grid_node_idx n) : grid_{g}, parent_{std::move(n)} {}
+    coarsen_t(grid& g, grid_node_idx n) : grid_{&g}, parent_{std::move(n)} {}
     coarsen_t(coarsen_t&& other) : grid_{other.grid_}, parent_{other.parent_} {
       other.parent_ = grid_node_idx{};
     }
     ~coarsen_t() {
       if (!parent_) { return; }
       /// Pop the children:
-      for (auto&& c : (*this)()) { grid_.pop(c); }
+      stack::vector<grid_node_idx, tree_t::no_children()> cs;
+      for (auto&& c : (*this)()) { cs.push_back(c); }
+      for (auto&& c : cs) { grid_->pop(c); }
     }
     coarsen_t operator=(coarsen_t&& other) = delete;
     coarsen_t(coarsen_t const&) = delete;
     coarsen_t operator=(coarsen_t const&) = delete;
 
     auto operator()() const noexcept {
-      return grid_.tree().children(grid_.tree_node(parent_))
-             | grid_.tree().in_grid(grid_.idx()) | grid_.to_grid_nodes();
+      return grid_->tree().children(grid_->tree_node(parent_))
+             | grid_->tree().in_grid(grid_->idx()) | grid_->to_grid_nodes();
     }
+
+    /// Number of children of the parent
+    static constexpr uint_t no_children() noexcept {
+      return tree_t::no_children();
+    }
+    /// Number of new parents (one)
+    static constexpr idx_t size() noexcept { return 1; }
+    /// New parent
+    grid_node_idx parent(idx_t) const noexcept { return parent_; }
+    /// Children of the new parent
+    auto children(idx_t) const noexcept { return (*this)(); }
   };
 
   /// Coarsens the parent of node \p n (i.e. the siblings of \p n)
@@ -417,6 +673,135 @@ template <uint_t Nd> struct grid {
     return {*this, p};
   }
 
+  /// RAII object for refining a batch of grid nodes
+  ///
+  /// Stores the refined parents and their children (the children of the i-th
+  /// parent are contiguous). When this object is destroyed, the parents are
+  /// removed from the grid at once.
+  struct refine_batch_t {
+    grid* grid_;
+    std::vector<grid_node_idx> parents_;
+    std::vector<grid_node_idx> children_;
+
+    explicit refine_batch_t(grid& g) : grid_{&g} {}
+    refine_batch_t(refine_batch_t&& other)
+     : grid_{other.grid_}
+     , parents_{std::move(other.parents_)}
+     , children_{std::move(other.children_)} {
+      other.parents_.clear();
+    }
+    refine_batch_t& operator=(refine_batch_t&& other) = delete;
+    refine_batch_t(refine_batch_t const&) = delete;
+    refine_batch_t& operator=(refine_batch_t const&) = delete;
+
+    ~refine_batch_t() {
+      if (parents_.empty()) { return; }
+      grid_->pop(parents_);
+    }
+
+    /// Number of children of each parent
+    static constexpr uint_t no_children() noexcept {
+      return tree_t::no_children();
+    }
+    /// Number of refined parents
+    idx_t size() const noexcept { return parents_.size(); }
+    /// \p i-th refined parent
+    grid_node_idx parent(idx_t i) const noexcept { return parents_[i]; }
+    /// Children of the \p i-th refined parent
+    auto children(idx_t i) const noexcept {
+      constexpr idx_t nc = tree_t::no_children();
+      return view::counted(children_.data() + i * nc, nc);
+    }
+  };
+
+  /// Refines the grid nodes \p ns
+  ///
+  /// The tree nodes are refined first, and then the grid nodes of all
+  /// children are allocated at once (contiguously if possible, see
+  /// push(range)). The parents are removed when the returned object is
+  /// destroyed, such that the data of the children can be initialized from
+  /// their parents in a single batch in the meantime.
+  template <typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  refine_batch_t refine(Rng&& ns) {
+    refine_batch_t b(*this);
+    std::vector<tree_node_idx> parents_tn;
+    for (auto&& n : ns) {
+      auto tn = tree_node(n);
+      HM3_ASSERT(tn, "grid node {} doesn't have a valid tree node", n);
+      b.parents_.push_back(n);
+      parents_tn.push_back(tn);
+    }
+    for (auto&& tn : parents_tn) {
+      if (distance(tree().refine(tn)) == 0) {
+        HM3_FATAL_ERROR("couldn't refine node {}", in_tree(tn));
+      }
+    }
+    b.children_.reserve(b.parents_.size() * tree_t::no_children());
+    for (auto&& tn : parents_tn) {
+      for (auto&& c : push(tree().children(tn))) { b.children_.push_back(c); }
+    }
+    return b;
+  }
+
+  /// RAII object for coarsening a batch of sibling groups
+  ///
+  /// Stores the new parents. When this object is destroyed, the children of
+  /// all parents are removed from the grid at once.
+  struct coarsen_batch_t {
+    grid* grid_;
+    std::vector<grid_node_idx> parents_;
+
+    explicit coarsen_batch_t(grid& g) : grid_{&g} {}
+    coarsen_batch_t(coarsen_batch_t&& other)
+     : grid_{other.grid_}, parents_{std::move(other.parents_)} {
+      other.parents_.clear();
+    }
+    coarsen_batch_t& operator=(coarsen_batch_t&& other) = delete;
+    coarsen_batch_t(coarsen_batch_t const&) = delete;
+    coarsen_batch_t& operator=(coarsen_batch_t const&) = delete;
+
+    ~coarsen_batch_t() {
+      if (parents_.empty()) { return; }
+      std::vector<grid_node_idx> children;
+      for (idx_t i = 0, e = size(); i != e; ++i) {
+        for (auto&& c : this->children(i)) { children.push_back(c); }
+      }
+      grid_->pop(children);
+    }
+
+    /// Number of children of each parent
+    static constexpr uint_t no_children() noexcept {
+      return tree_t::no_children();
+    }
+    /// Number of new parents
+    idx_t size() const noexcept { return parents_.size(); }
+    /// \p i-th new parent
+    grid_node_idx parent(idx_t i) const noexcept { return parents_[i]; }
+    /// Children of the \p i-th new parent
+    auto children(idx_t i) const noexcept {
+      return grid_->tree().children(grid_->tree_node(parents_[i]))
+             | grid_->tree().in_grid(grid_->idx()) | grid_->to_grid_nodes();
+    }
+  };
+
+  /// Coarsens the parents of the nodes \p ns (i.e. the siblings of each node;
+  /// several siblings of the same group can be passed)
+  ///
+  /// The parents are allocated at once. The children are removed when the
+  /// returned object is destroyed, such that the data of the parents can be
+  /// initialized from their children in a single batch in the meantime.
+  template <typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  coarsen_batch_t coarsen(Rng&& ns) {
+    coarsen_batch_t b(*this);
+    std::vector<tree_node_idx> parents_tn;
+    for (auto&& n : ns) { parents_tn.push_back(parent(n)); }
+    std::sort(begin(parents_tn), end(parents_tn));
+    parents_tn.erase(std::unique(begin(parents_tn), end(parents_tn)),
+                     end(parents_tn));
+    for (auto&& p : parents_tn) { b.parents_.push_back(push(p)); }
+    return b;
+  }
+
   grid() = default;
 
   grid(tree_t& t, grid_idx g, grid_node_idx node_capacity)
@@ -438,76 +823,339 @@ template <uint_t Nd> struct grid {
   void reset() {
     size_ = 0_gn;
     is_free_.set();
-    for (auto&& n : tree_node_ids_) { n = tree_node_idx{}; }
+    free_nodes_.clear();
+    end_            = 0_gn;
+    has_free_nodes_ = true;
+    for (auto&& n : tree_node_ids_) { n = stored_tree_node_idx{}; }
     min_level = level_idx{};
     max_level = level_idx{};
     // reset doesn't do the following, mainly because the grid already does
     // it, but also because the typical pattern is to read the grid first, and
     // then read the solver grid state, which mean the solver nodes are
     // already in the tree:
-    for (auto&& n : tree().nodes(idx())) { in_tree(n) = grid_node_idx{}; }
+    for (auto&& n : tree().nodes(idx())) {
+      set_in_tree(n, grid_node_idx{});
+    }
   }
 
   /// Resizes a zero sized grid to have \p s grid nodes
-  void resize(grid_node_idx s) noexcept {
+  void resize(grid_node_idx s) {
     HM3_ASSERT(size_ == 0_gn, "cannot resize non empty grid, size = {}", size_);
     size_ = s;
     for (auto&& n : boxed_ints<grid_node_idx>(0_gn, size_)) {
       is_free_(n) = false;
+      record(change{change_kind::created, n, grid_node_idx{}, tree_node_idx{}});
     }
+    free_nodes_.clear();
+    end_            = s;
+    has_free_nodes_ = true;
     HM3_ASSERT(size() == s, "");
     HM3_ASSERT(is_compact(), "size is {} but first free node is {}", size(),
-               free_node());
+               first_free_node());
   }
 
   void update_from_tree() {
     for (auto n : tree().nodes(idx())) {
       auto cn = in_tree(n);
-      tree_node_ids_(cn) = n;
+      set_tree_node(cn, n);
     }
   }
 
   void update_tree() {
     RANGES_FOR (auto n, in_use()) {
       auto tn = tree_node(n);
-      if (tn) { in_tree(tn) = n; }
+      if (tn) { set_in_tree(tn, n); }
     }
   }
 
-  template <typename DataSwap> void sort(DataSwap&& ds) {
+  /// \name Change journal
+  ///
+  /// When enabled, the grid nodes created, removed, swapped, and moved are
+  /// recorded, such that solvers and caches can update only the grid nodes
+  /// that changed since a marker (e.g. the last AMR iteration) instead of all
+  /// grid nodes.
+  ///@{
+
+  /// Starts recording changes
+  void enable_journal() noexcept { has_journal_ = true; }
+  /// Stops recording changes and discards the journal
+  void disable_journal() noexcept {
+    has_journal_ = false;
+    journal_begin_ += journal_.size();
+    journal_.clear();
+    journal_.shrink_to_fit();
+  }
+  /// Are changes being recorded?
+  bool has_journal() const noexcept { return has_journal_; }
+
+  /// Marker of the current position in the journal
+  journal_marker_t journal_marker() const noexcept {
+    return journal_begin_ + journal_.size();
+  }
+
+  /// Discards the changes before the marker \p m
+  void discard_changes_before(journal_marker_t m) {
+    HM3_ASSERT(m >= journal_begin_ and m <= journal_marker(),
+               "invalid journal marker {}", m);
+    journal_.erase(begin(journal_), begin(journal_) + (m - journal_begin_));
+    journal_begin_ = m;
+  }
+
+  /// Changes recorded since the marker \p m (in the order they happened)
+  auto changed_since(journal_marker_t m) const noexcept {
+    HM3_ASSERT(m >= journal_begin_ and m <= journal_marker(),
+               "journal marker {} is invalid (valid markers: [{}, {}])", m,
+               journal_begin_, journal_marker());
+    return view::counted(journal_.data() + (m - journal_begin_),
+                         journal_marker() - m);
+  }
+
+  /// Grid nodes in use created since the marker \p m (at their current
+  /// position, sorted)
+  ///
+  /// These are the grid nodes whose data has not been initialized or has been
+  /// interpolated since the marker. Grid nodes without tree node (e.g.
+  /// ghosts) are not included.
+  ///
+  /// Time complexity: O(no changes * log(no changes)).
+  std::vector<grid_node_idx> created_since(journal_marker_t m) const {
+    // replay the changes into a hash set, and sort the result once:
+    std::unordered_set<idx_t> created;
+    auto changes  = changed_since(m);
+    auto contains = [&](grid_node_idx n) { return created.count(*n) != 0; };
+    for (auto it = begin(changes), e = end(changes); it != e; ++it) {
+      auto&& c = *it;
+      switch (c.kind) {
+        case change_kind::created: {
+          created.insert(*c.node);
+          break;
+        }
+        case change_kind::removed: {
+          created.erase(*c.node);
+          break;
+        }
+        case change_kind::swapped: {
+          const bool n = contains(c.node);
+          const bool f = contains(c.from);
+          if (n != f) {
+            created.erase(*(n ? c.node : c.from));
+            created.insert(*(n ? c.from : c.node));
+          }
+          break;
+        }
+        case change_kind::sorted: {
+          // the moves following a sort form a single permutation
+          std::vector<grid_node_idx> moved;
+          std::vector<grid_node_idx> sources;
+          for (++it; it != e and (*it).kind == change_kind::moved; ++it) {
+            if (contains((*it).from)) {
+              moved.push_back((*it).node);
+              sources.push_back((*it).from);
+            }
+          }
+          --it;
+          for (auto&& n : sources) { created.erase(*n); }
+          for (auto&& n : moved) { created.insert(*n); }
+          break;
+        }
+        case change_kind::moved: {
+          HM3_ASSERT(false, "grid node {} moved outside of a sort", c.node);
+          break;
+        }
+      }
+    }
+    std::vector<grid_node_idx> result;
+    result.reserve(created.size());
+    for (auto&& n : created) {
+      if (tree_node(grid_node_idx{n})) { result.push_back(grid_node_idx{n}); }
+    }
+    std::sort(begin(result), end(result));
+    return result;
+  }
+
+  /// Tree nodes of the grid nodes created or removed since the marker \p m
+  /// (sorted, without duplicates)
+  ///
+  /// These are e.g. the dirty nodes of the interfaces between grids (see
+  /// grid::adaptor::interface::update).
+  std::vector<tree_node_idx> changed_tree_nodes_since(
+   journal_marker_t m) const {
+    std::vector<tree_node_idx> tns;
+    for (auto&& c : changed_since(m)) {
+      if (c.tree_node) { tns.push_back(c.tree_node); }
+    }
+    std::sort(begin(tns), end(tns));
+    tns.erase(std::unique(begin(tns), end(tns)), end(tns));
+    return tns;
+  }
+
+  ///@}  // Change journal
+
+  /// \name Sorting
+  ///
+  /// Sorting reorders the grid nodes in the order of the tree nodes of the
+  /// grid (i.e. depth-first order if the tree is sorted). The grid nodes
+  /// without tree node are stored afterwards (in their previous order).
+  ///@{
+
+  /// Sorts the grid nodes by swapping them pairwise, calling
+  /// \p data_swap(i, j) for each swap
+  template <typename DataSwap,
+            CONCEPT_REQUIRES_(
+             Function<DataSwap, grid_node_idx, grid_node_idx>{})>
+  void sort(DataSwap&& data_swap) {
     min_level = level_idx{};
     max_level = level_idx{};
     auto i    = grid_node_idx{0};
     for (auto n : tree().nodes(idx())) {
       auto cn = in_tree(n);
-      ds(i, cn);
+      data_swap(i, cn);
       swap(i, cn);
       ++i;
       update_minmax_level(n);
     }
+    update_free_nodes();
+  }
+
+  /// Sorts the grid nodes by computing the permutation \p p once (the grid
+  /// node at position i after sorting is the grid node p[i] before sorting)
+  /// and calling \p data_permute(p) once
+  ///
+  /// The tree node indices of the grid nodes and the grid nodes stored in the
+  /// tree are rebuilt in a single pass (the tree node indices stored in the
+  /// solver grid do not need to be updated after sorting the tree, see
+  /// update_from_tree).
+  ///
+  /// Time complexity: O(size).
+  template <typename DataPermute,
+            CONCEPT_REQUIRES_(
+             Function<DataPermute, std::vector<grid_node_idx> const&>{})>
+  void sort(DataPermute&& data_permute) {
+    sort_plan_t plan;
+    plan.reserve(*size());
+    for (auto&& n : tree().nodes(idx())) { plan.push_back(*this, n); }
+    sort(std::move(plan), std::forward<DataPermute>(data_permute));
+  }
+
+  /// Tree nodes of a grid in tree order and the corresponding grid nodes
+  /// (i.e. the sorting permutation)
+  ///
+  /// The plans of several grids of the same tree can be computed in a single
+  /// traversal of the tree (see solver::sort).
+  struct sort_plan_t {
+    std::vector<tree_node_idx> tree_nodes;
+    std::vector<grid_node_idx> permutation;
+    void reserve(idx_t n) {
+      tree_nodes.reserve(n);
+      permutation.reserve(n);
+    }
+    /// Appends the tree node \p n of the grid \p g
+    void push_back(grid const& g, tree_node_idx n) {
+      tree_nodes.push_back(n);
+      permutation.push_back(g.in_tree(n));
+    }
+  };
+
+  /// Sorts the grid nodes with the \p plan (computed from the sorted tree) and
+  /// calls \p data_permute(p) once with the permutation (see sort)
+  ///
+  /// Time complexity: O(size).
+  template <typename DataPermute,
+            CONCEPT_REQUIRES_(
+             Function<DataPermute, std::vector<grid_node_idx> const&>{})>
+  void sort(sort_plan_t&& plan, DataPermute&& data_permute) {
+    auto tree_nodes           = std::move(plan.tree_nodes);
+    auto p                    = std::move(plan.permutation);
+    const idx_t no_tree_nodes = p.size();
+    if (no_tree_nodes != *size()) {  // grid nodes without tree node
+      std::vector<bool> in_tree_order(*capacity(), false);
+      for (auto&& n : p) { in_tree_order[*n] = true; }
+      RANGES_FOR (auto&& n, in_use()) {
+        if (!in_tree_order[*n]) { p.push_back(n); }
+      }
+    }
+    HM3_ASSERT(static_cast<idx_t>(p.size()) == *size(),
+               "permutation size {} != number of grid nodes {}", p.size(),
+               size());
+
+    data_permute(static_cast<std::vector<grid_node_idx> const&>(p));
+    if (has_journal_) {
+      journal_.push_back(change{change_kind::sorted, grid_node_idx{},
+                                grid_node_idx{}, tree_node_idx{}});
+      for (idx_t i = 0, e = p.size(); i != e; ++i) {
+        if (p[i] != grid_node_idx{i}) {
+          journal_.push_back(
+           change{change_kind::moved, grid_node_idx{i}, p[i], tree_node_idx{}});
+        }
+      }
+    }
+
+    // Rebuild the tree nodes and the grid nodes in the tree:
+    const auto old_end = used_end();
+    min_level          = level_idx{};
+    max_level          = level_idx{};
+    for (idx_t i = 0, e = p.size(); i != e; ++i) {
+      const grid_node_idx sn{i};
+      const auto n = i < no_tree_nodes ? tree_nodes[i] : tree_node_idx{};
+      set_tree_node(sn, n);
+      is_free_(sn) = false;
+      if (n) {
+        set_in_tree(n, sn);
+        update_minmax_level(n);
+      }
+    }
+    for (idx_t i = p.size(); i < *old_end; ++i) {
+      const grid_node_idx sn{i};
+      set_tree_node(sn, tree_node_idx{});
+      is_free_(sn) = true;
+    }
+    free_nodes_.clear();
+    end_            = size();
+    has_free_nodes_ = true;
   }
+
+  /// Permutes the grid node data \p data (indexed by grid_node_idx) in
+  /// parallel with the permutation \p p computed by sort
+  template <typename Data>
+  static void permute(Data& data, std::vector<grid_node_idx> const& p) {
+    using value_t = std::decay_t<decltype(data(grid_node_idx{0}))>;
+    const idx_t no_nodes = p.size();
+    std::vector<value_t> tmp(no_nodes);
+    parallel::for_each_static(0, no_nodes,
+                              [&](int_t i) { tmp[i] = data(p[i]); });
+    parallel::for_each_static(
+     0, no_nodes, [&](int_t i) { data(grid_node_idx{i}) = std::move(tmp[i]); });
+  }
+
+  ///@}  // Sorting
 };
 
-template <uint_t Nd> bool operator==(grid<Nd> const& a, grid<Nd> const& b) {
+template <uint_t Nd, typename Idx, typename TreeGrid>
+bool operator==(grid<Nd, Idx, TreeGrid> const& a,
+                grid<Nd, Idx, TreeGrid> const& b) {
   return a.idx() == b.idx() && a.size() == b.size()
          // compare the grids in the tree as well ?
          && equal(a.in_use(), b.in_use());
 }
-template <uint_t Nd> bool operator!=(grid<Nd> const& a, grid<Nd> const& b) {
+template <uint_t Nd, typename Idx, typename TreeGrid>
+bool operator!=(grid<Nd, Idx, TreeGrid> const& a,
+                grid<Nd, Idx, TreeGrid> const& b) {
   return !(a == b);
 }
 
 /// \name Solver-grid I/O
 ///@{
-template <uint_t Nd> void map_arrays(io::file& f, grid<Nd> const& g) {
+template <uint_t Nd, typename Idx, typename TreeGrid>
+void map_arrays(io::file& f, grid<Nd, Idx, TreeGrid> const& g) {
   auto no_nodes = grid_node_idx{f.constant("no_grid_nodes", idx_t{})};
   HM3_ASSERT(no_nodes == g.size(), "mismatching number of grid nodes");
-  f.field("tree_nodes", reinterpret_cast<const idx_t*>(g.data()), *no_nodes);
+  f.index_field<idx_t>("tree_nodes", g.data(), *no_nodes);
 }
 
-template <uint_t Nd, typename Tree = typename grid<Nd>::tree_t>
-grid<Nd> from_file_unread(grid<Nd> const&, io::file& f, Tree& t,
-                          grid_node_idx node_capacity) {
+template <uint_t Nd, typename Idx, typename TreeGrid>
+grid<Nd, Idx, TreeGrid> from_file_unread(grid<Nd, Idx, TreeGrid> const&,
+                                         io::file& f, TreeGrid& t,
+                                         grid_node_idx node_capacity) {
   auto idx = grid_idx{f.constant("grid_idx", suint_t{})};
   auto nd = uint_t{f.constant("spatial_dimension", suint_t{})};
   auto no_nodes = grid_node_idx{f.constant("no_grid_nodes", idx_t{})};
@@ -515,13 +1163,14 @@ grid<Nd> from_file_unread(grid<Nd> const&, io::file& f, Tree& t,
     HM3_FATAL_ERROR("spatial_dimension mismatch, type {} vs file {}", Nd, nd);
   }
   if (!node_capacity) { node_capacity = no_nodes; }
-  grid<Nd> g{t, idx, node_capacity};
+  grid<Nd, Idx, TreeGrid> g{t, idx, node_capacity};
   g.resize(no_nodes);
   map_arrays(f, g);
   return g;
 }
 
-template <uint_t Nd> void to_file_unwritten(io::file& f, grid<Nd> const& g) {
+template <uint_t Nd, typename Idx, typename TreeGrid>
+void to_file_unwritten(io::file& f, grid<Nd, Idx, TreeGrid> const& g) {
   HM3_ASSERT(g.is_compact(), "cannot write non-compact solver grid");
   f.field("grid_idx", *g.idx())
    .field("spatial_dimension", Nd)
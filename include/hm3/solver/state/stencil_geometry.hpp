@@ -0,0 +1,290 @@
+#pragma once
+/// \file
+///
+/// Precomputed geometry of the stencils of the solver grid cells
+#include <algorithm>
+#include <vector>
+#include <hm3/geometry/point.hpp>
+#include <hm3/solver/types.hpp>
+#include <hm3/utility/aligned_allocator.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/math.hpp>
+#include <hm3/utility/parallel.hpp>
+#include <hm3/utility/range.hpp>
+
+namespace hm3 {
+namespace solver {
+namespace state {
+
+/// Geometry of the stencils of the cells of a solver grid
+///
+/// A cell is structured if it has all its same-level neighbors (across all
+/// manifolds) in the grid. The distance from a structured cell to its
+/// neighbor at position p is the cell length times the offset of p, so
+/// nothing is stored for it. Otherwise the cell is unstructured: its
+/// neighbors and the distances to them are precomputed and stored in a
+/// compact side table in compressed sparse row format.
+///
+/// The cells are partitioned into the list of structured cells and the list
+/// of unstructured cells (both sorted by grid node), such that structured
+/// cells can be processed by a branch-free kernel, and unstructured cells by
+/// a kernel gathering the precomputed geometry.
+template <uint_t Nd> struct stencil_geometry {
+  using vector_t = geometry::vector<Nd>;
+
+  /// Structured cells (sorted)
+  std::vector<grid_node_idx> structured_;
+  /// Unstructured cells (sorted)
+  std::vector<grid_node_idx> unstructured_;
+  /// Offset of the row of each unstructured cell in the side table (the row of
+  /// the i-th unstructured cell is [offsets_[i], offsets_[i+1]))
+  std::vector<idx_t> offsets_{0};
+  /// Neighbors of the unstructured cells
+  std::vector<grid_node_idx> neighbors_;
+  /// Distance vectors from the unstructured cells to their neighbors
+  memory::aligned_vector<vector_t> distances_;
+
+  /// Row of the cells that are not unstructured
+  static constexpr idx_t no_row = -1;
+
+  /// Number of same-level neighbors of a structured cell
+  static constexpr uint_t no_structured_neighbors() noexcept {
+    return math::ipow(3_u, Nd) - 1;
+  }
+
+  /// Structured cells (sorted)
+  std::vector<grid_node_idx> const& structured() const noexcept {
+    return structured_;
+  }
+  /// Unstructured cells (sorted)
+  std::vector<grid_node_idx> const& unstructured() const noexcept {
+    return unstructured_;
+  }
+
+  /// Is the cell \p n structured?
+  ///
+  /// Time complexity: O(log(no structured cells))
+  bool is_structured(grid_node_idx n) const noexcept {
+    return std::binary_search(begin(structured_), end(structured_), n);
+  }
+
+  /// Row of the unstructured cell \p n in the side table (no_row if \p n is
+  /// not unstructured)
+  ///
+  /// Time complexity: O(log(no unstructured cells))
+  idx_t row(grid_node_idx n) const noexcept {
+    auto it = std::lower_bound(begin(unstructured_), end(unstructured_), n);
+    return it != end(unstructured_) and *it == n
+            ? it - begin(unstructured_)
+            : no_row;
+  }
+
+  /// Neighbors of the \p i-th unstructured cell
+  auto neighbors(idx_t i) const noexcept {
+    assert_row(i, HM3_AT_);
+    return view::counted(neighbors_.data() + offsets_[i],
+                         offsets_[i + 1] - offsets_[i]);
+  }
+  /// Distance vectors from the \p i-th unstructured cell to its neighbors
+  auto distances(idx_t i) const noexcept {
+    assert_row(i, HM3_AT_);
+    return view::counted(distances_.data() + offsets_[i],
+                         offsets_[i + 1] - offsets_[i]);
+  }
+
+  /// Classifies the cells of the solver grid \p g and computes the geometry
+  /// of the unstructured cells
+  ///
+  /// Time complexity: O(size(g) / no_threads)
+  template <typename Grid> void build(Grid const& g) {
+    std::vector<grid_node_idx> cells;
+    RANGES_FOR (auto&& n, g.in_use()) {
+      if (g.tree_node(n)) { cells.push_back(n); }
+    }
+    structured_.clear();
+    unstructured_.clear();
+    classify(g, cells);
+    rebuild_side_table(g, std::vector<grid_node_idx>{},
+                       std::vector<grid_node_idx>{});
+  }
+
+  /// Updates the geometry after the solver grid \p g has been adapted, where
+  /// \p cells are the cells created since the last update (e.g. see
+  /// grid::created_since)
+  ///
+  /// Only the \p cells and their neighbors are reclassified, and only the
+  /// geometry of the unstructured ones among them is recomputed; the rows of
+  /// the other unstructured cells are copied.
+  ///
+  /// Time complexity: O(distance(cells) + no cells) (the partitions are
+  /// filtered once)
+  template <typename Grid, typename Rng, CONCEPT_REQUIRES_(Range<Rng>())>
+  void update(Grid const& g, Rng&& cells) {
+    std::vector<grid_node_idx> dirty;
+    for (auto&& n : cells) {
+      if (!g.tree_node(n)) { continue; }
+      dirty.push_back(n);
+      for (auto&& m : g.neighbors(n)) { dirty.push_back(m); }
+    }
+    std::sort(begin(dirty), end(dirty));
+    dirty.erase(std::unique(begin(dirty), end(dirty)), end(dirty));
+
+    // drop the removed and dirty cells from both partitions:
+    auto drop = [&](grid_node_idx n) {
+      return g.is_free(n) or !g.tree_node(n)
+             or std::binary_search(begin(dirty), end(dirty), n);
+    };
+    auto old_unstructured = unstructured_;
+    structured_.erase(remove_if(structured_, drop), end(structured_));
+    unstructured_.erase(remove_if(unstructured_, drop), end(unstructured_));
+    auto kept = unstructured_;
+
+    classify(g, dirty);
+    rebuild_side_table(g, old_unstructured, kept);
+  }
+
+  /// Updates the geometry after the solver grid has been sorted with the
+  /// permutation \p p (see grid::sort)
+  void permute(std::vector<grid_node_idx> const& p) {
+    idx_t no_nodes = 0;
+    for (auto&& n : p) { no_nodes = std::max(no_nodes, *n + 1); }
+    std::vector<grid_node_idx> new_idx(no_nodes);
+    for (idx_t i = 0, e = p.size(); i != e; ++i) {
+      new_idx[*p[i]] = grid_node_idx{i};
+    }
+    for (auto&& n : structured_) { n = new_idx[*n]; }
+    std::sort(begin(structured_), end(structured_));
+
+    // reorder the rows of the unstructured cells:
+    const idx_t no_rows = unstructured_.size();
+    std::vector<idx_t> rows(no_rows);
+    for (idx_t i = 0; i != no_rows; ++i) { rows[i] = i; }
+    std::sort(begin(rows), end(rows), [&](idx_t a, idx_t b) {
+      return new_idx[*unstructured_[a]] < new_idx[*unstructured_[b]];
+    });
+    std::vector<grid_node_idx> unstructured(no_rows);
+    std::vector<idx_t> offsets(no_rows + 1, 0);
+    std::vector<grid_node_idx> neighbors;
+    neighbors.reserve(neighbors_.size());
+    memory::aligned_vector<vector_t> distances;
+    distances.reserve(distances_.size());
+    for (idx_t i = 0; i != no_rows; ++i) {
+      const idx_t r   = rows[i];
+      unstructured[i] = new_idx[*unstructured_[r]];
+      for (idx_t j = offsets_[r]; j != offsets_[r + 1]; ++j) {
+        neighbors.push_back(new_idx[*neighbors_[j]]);
+        distances.push_back(distances_[j]);
+      }
+      offsets[i + 1] = neighbors.size();
+    }
+    unstructured_ = std::move(unstructured);
+    offsets_      = std::move(offsets);
+    neighbors_    = std::move(neighbors);
+    distances_    = std::move(distances);
+  }
+
+  /// Calls \p f(n) for all structured cells in parallel
+  template <typename F> void for_each_structured(F&& f) const {
+    parallel::for_each_static(0, structured_.size(),
+                              [&](int_t i) { f(structured_[i]); });
+  }
+
+  /// Calls \p f(n, neighbors, distances) for all unstructured cells in
+  /// parallel
+  template <typename F> void for_each_unstructured(F&& f) const {
+    parallel::for_each_static(0, unstructured_.size(), [&](int_t i) {
+      f(unstructured_[i], neighbors(i), distances(i));
+    });
+  }
+
+ private:
+  template <typename At> void assert_row(idx_t i, At&& at) const noexcept {
+    HM3_ASSERT_AT(i >= 0 and i < static_cast<idx_t>(unstructured_.size()),
+                  "row {} out of bounds [0, {})", at, i,
+                  unstructured_.size());
+  }
+
+  /// Is the cell \p n of the solver grid \p g structured?
+  template <typename Grid>
+  static bool compute_is_structured(Grid const& g, grid_node_idx n) noexcept {
+    auto ns = g.neighbors(n);
+    if (ns.size() != no_structured_neighbors()) { return false; }
+    const auto l = g.level(n);
+    return all_of(ns, [&](grid_node_idx m) { return g.level(m) == l; });
+  }
+
+  /// Adds the \p cells of the solver grid \p g to their partition
+  template <typename Grid>
+  void classify(Grid const& g, std::vector<grid_node_idx> const& cells) {
+    const idx_t no_cells = cells.size();
+    std::vector<char> is_structured(no_cells);
+    parallel::for_each_static(0, no_cells, [&](int_t i) {
+      is_structured[i] = compute_is_structured(g, cells[i]);
+    });
+    const auto no_structured = structured_.size();
+    const auto no_unstructured = unstructured_.size();
+    for (idx_t i = 0; i != no_cells; ++i) {
+      (is_structured[i] ? structured_ : unstructured_).push_back(cells[i]);
+    }
+    std::inplace_merge(begin(structured_), begin(structured_) + no_structured,
+                       end(structured_));
+    std::inplace_merge(begin(unstructured_),
+                       begin(unstructured_) + no_unstructured,
+                       end(unstructured_));
+  }
+
+  /// Rebuilds the side table of the unstructured cells of the solver grid \p
+  /// g
+  ///
+  /// The rows of the cells in \p kept are copied from the current side table,
+  /// whose rows belong to the cells \p old (sorted). The other rows are
+  /// computed (in parallel).
+  template <typename Grid>
+  void rebuild_side_table(Grid const& g, std::vector<grid_node_idx> const& old,
+                          std::vector<grid_node_idx> const& kept) {
+    const idx_t no_rows = unstructured_.size();
+    std::vector<idx_t> offsets(no_rows + 1, 0);
+    std::vector<idx_t> old_rows(no_rows, no_row);
+    for (idx_t i = 0; i != no_rows; ++i) {
+      const auto n = unstructured_[i];
+      idx_t size   = 0;
+      if (std::binary_search(begin(kept), end(kept), n)) {
+        const idx_t r = std::lower_bound(begin(old), end(old), n) - begin(old);
+        old_rows[i]   = r;
+        size          = offsets_[r + 1] - offsets_[r];
+      } else {
+        size = g.neighbors(n).size();
+      }
+      offsets[i + 1] = offsets[i] + size;
+    }
+    std::vector<grid_node_idx> neighbors(offsets.back());
+    memory::aligned_vector<vector_t> distances(offsets.back());
+    parallel::for_each_static(0, no_rows, [&](int_t i) {
+      idx_t o = offsets[i];
+      if (old_rows[i] != no_row) {
+        const idx_t r = old_rows[i];
+        for (idx_t j = offsets_[r]; j != offsets_[r + 1]; ++j, ++o) {
+          neighbors[o] = neighbors_[j];
+          distances[o] = distances_[j];
+        }
+        return;
+      }
+      const auto n  = unstructured_[i];
+      const auto xn = g.coordinates(n);
+      for (auto&& m : g.neighbors(n)) {
+        neighbors[o] = m;
+        distances[o] = g.coordinates(m) - xn;
+        ++o;
+      }
+    });
+    offsets_   = std::move(offsets);
+    neighbors_ = std::move(neighbors);
+    distances_ = std::move(distances);
+  }
+};
+
+template <uint_t Nd> constexpr idx_t stencil_geometry<Nd>::no_row;
+
+}  // namespace state
+}  // namespace solver
+}  // namespace hm3
@@ -0,0 +1,294 @@
+#pragma once
+/// \file
+///
+/// Conservative transfer of cell data between solver grids of the same tree
+#include <algorithm>
+#include <vector>
+#include <hm3/solver/types.hpp>
+#include <hm3/tree/algorithm/root_traversal.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/math.hpp>
+#include <hm3/utility/parallel.hpp>
+#include <hm3/utility/range.hpp>
+
+namespace hm3 {
+namespace solver {
+namespace state {
+
+/// Conservative transfer of cell data from a source to a target solver grid
+/// of the same tree
+///
+/// The cells of both grids are tree nodes, so a target cell overlaps either a
+/// single source cell at the same or a coarser level (weight 1), or a set of
+/// source cells at finer levels (weight: volume of the source cell relative to
+/// the volume of the target cell). The value of a target cell is the
+/// weighted sum of the values of the source cells it overlaps, such that the
+/// integral of the data over the overlap of both grids is conserved. Target
+/// cells that are only partially covered by the source grid receive the
+/// integral of the covered part (see coverage); target cells that do not
+/// overlap the source grid have no row and are not modified.
+///
+/// The weights are computed in a single depth-first traversal of the tree
+/// and stored in compressed sparse row format (one row per target cell,
+/// sorted by target cell), such that applying the transfer is a parallel
+/// sparse matrix-vector product.
+///
+/// \pre the cells of each grid do not overlap each other (e.g. they are the
+/// leaves of the grid)
+struct transfer {
+  /// Target cells (sorted)
+  std::vector<grid_node_idx> targets_;
+  /// Offset of the row of each target cell (the row of the i-th target cell
+  /// is [offsets_[i], offsets_[i+1]))
+  std::vector<idx_t> offsets_{0};
+  /// Source cells of the rows
+  std::vector<grid_node_idx> sources_;
+  /// Weights of the source cells
+  std::vector<num_t> weights_;
+
+  /// Row of the target cells without a row
+  static constexpr idx_t no_row() noexcept { return -1; }
+
+  /// Number of rows (target cells overlapping the source grid)
+  idx_t size() const noexcept { return targets_.size(); }
+
+  /// Target cells with a row (sorted)
+  std::vector<grid_node_idx> const& targets() const noexcept {
+    return targets_;
+  }
+
+  /// Row of the target cell \p n (no_row() if \p n does not overlap the
+  /// source grid)
+  ///
+  /// Time complexity: O(log(size()))
+  idx_t row(grid_node_idx n) const noexcept {
+    auto it = std::lower_bound(begin(targets_), end(targets_), n);
+    return it != end(targets_) and *it == n ? it - begin(targets_) : no_row();
+  }
+
+  /// Source cells of the \p i-th row
+  auto sources(idx_t i) const noexcept {
+    assert_row(i, HM3_AT_);
+    return view::counted(sources_.data() + offsets_[i],
+                         offsets_[i + 1] - offsets_[i]);
+  }
+  /// Weights of the \p i-th row
+  auto weights(idx_t i) const noexcept {
+    assert_row(i, HM3_AT_);
+    return view::counted(weights_.data() + offsets_[i],
+                         offsets_[i + 1] - offsets_[i]);
+  }
+
+  /// Fraction of the volume of the target cell of the \p i-th row covered by
+  /// the source grid
+  num_t coverage(idx_t i) const noexcept {
+    return accumulate(weights(i), num_t{0});
+  }
+
+  /// Computes the transfer from the source grid \p src to the target grid \p
+  /// dst
+  ///
+  /// Time complexity: O(size(tree))
+  template <typename Grid> void build(Grid const& src, Grid const& dst) {
+    assert_same_tree(src, dst);
+    std::vector<entry> es;
+    dfs(src, dst, tree_node_idx{0}, grid_node_idx{}, grid_node_idx{}, es);
+    store(std::move(es));
+  }
+
+  /// Updates the transfer after the grids \p src and \p dst have been
+  /// adapted, where \p src_cells and \p dst_cells are the cells created since
+  /// the last update (e.g. see grid::created_since)
+  ///
+  /// Only the sub-trees containing created cells (or below the target cells
+  /// containing them) are traversed again; the rows of the other target cells
+  /// are kept.
+  ///
+  /// Note: if cells are removed from a grid without being replaced (i.e. the
+  /// grid shrinks) the transfer must be rebuilt.
+  ///
+  /// Time complexity: O(size() log(N) + size of the changed sub-trees)
+  template <typename Grid, typename SrcRng, typename DstRng,
+            CONCEPT_REQUIRES_(Range<SrcRng>() and Range<DstRng>())>
+  void update(Grid const& src, Grid const& dst, SrcRng&& src_cells,
+              DstRng&& dst_cells) {
+    assert_same_tree(src, dst);
+    auto&& t = dst.tree();
+
+    // roots of the changed sub-trees: the created cells, or the target cells
+    // containing them
+    std::vector<tree_node_idx> roots;
+    auto push_root = [&](tree_node_idx n) {
+      if (!n) { return; }
+      const auto r = tree::root_traversal(t, n, [&](tree_node_idx m) {
+        return !t.in_grid(m, dst.idx());
+      });
+      roots.push_back(r ? r : n);
+    };
+    for (auto&& n : src_cells) { push_root(src.tree_node(n)); }
+    for (auto&& n : dst_cells) { push_root(dst.tree_node(n)); }
+    std::sort(begin(roots), end(roots));
+    roots.erase(std::unique(begin(roots), end(roots)), end(roots));
+    auto in_changed_subtree = [&](tree_node_idx n) {
+      return static_cast<bool>(tree::root_traversal(t, n, [&](tree_node_idx m) {
+        return !std::binary_search(begin(roots), end(roots), m);
+      }));
+    };
+    // the roots of the sub-trees that are not nested in other sub-trees:
+    std::vector<tree_node_idx> top_roots;
+    for (auto&& r : roots) {
+      if (t.is_root(r) or !in_changed_subtree(t.parent(r))) {
+        top_roots.push_back(r);
+      }
+    }
+
+    // keep the rows of the target cells outside the changed sub-trees:
+    std::vector<entry> es;
+    es.reserve(sources_.size());
+    for (idx_t i = 0, e = size(); i != e; ++i) {
+      const auto n = targets_[i];
+      if (dst.is_free(n) or !dst.tree_node(n)
+          or in_changed_subtree(dst.tree_node(n))) {
+        continue;
+      }
+      for (idx_t j = offsets_[i]; j != offsets_[i + 1]; ++j) {
+        es.push_back(entry{n, sources_[j], weights_[j]});
+      }
+    }
+
+    // traverse the changed sub-trees:
+    for (auto&& r : top_roots) {
+      // the source cell containing the sub-tree (if any):
+      grid_node_idx s{};
+      if (!t.is_root(r)) {
+        const auto p
+         = tree::root_traversal(t, t.parent(r), [&](tree_node_idx m) {
+             return !t.in_grid(m, src.idx());
+           });
+        if (p) { s = src.in_tree(p); }
+      }
+      dfs(src, dst, r, s, grid_node_idx{}, es);
+    }
+
+    store(std::move(es));
+  }
+
+  /// Updates the transfer after the source grid has been sorted with the
+  /// permutation \p p (see grid::sort)
+  void permute_sources(std::vector<grid_node_idx> const& p) {
+    const auto new_idx = inverse(p);
+    for (auto&& n : sources_) { n = new_idx[*n]; }
+  }
+
+  /// Updates the transfer after the target grid has been sorted with the
+  /// permutation \p p (see grid::sort)
+  void permute_targets(std::vector<grid_node_idx> const& p) {
+    const auto new_idx = inverse(p);
+    std::vector<entry> es;
+    es.reserve(sources_.size());
+    for (idx_t i = 0, e = size(); i != e; ++i) {
+      for (idx_t j = offsets_[i]; j != offsets_[i + 1]; ++j) {
+        es.push_back(entry{new_idx[*targets_[i]], sources_[j], weights_[j]});
+      }
+    }
+    store(std::move(es));
+  }
+
+  /// Transfers the data \p src_data of the source grid to the data \p
+  /// dst_data of the target grid (both indexed by grid_node_idx) in parallel
+  ///
+  /// Only the target cells overlapping the source grid are modified.
+  template <typename SrcData, typename DstData>
+  void apply(SrcData const& src_data, DstData&& dst_data) const {
+    parallel::for_each_static(0, size(), [&](int_t i) {
+      const idx_t b = offsets_[i];
+      const idx_t e = offsets_[i + 1];
+      auto v        = weights_[b] * src_data(sources_[b]);
+      for (idx_t j = b + 1; j != e; ++j) {
+        v += weights_[j] * src_data(sources_[j]);
+      }
+      dst_data(targets_[i]) = v;
+    });
+  }
+
+ private:
+  struct entry {
+    grid_node_idx target;
+    grid_node_idx source;
+    num_t weight;
+  };
+
+  template <typename At> void assert_row(idx_t i, At&& at) const noexcept {
+    HM3_ASSERT_AT(i >= 0 and i < size(), "row {} out of bounds [0, {})", at, i,
+                  size());
+  }
+
+  template <typename Grid>
+  static void assert_same_tree(Grid const& src, Grid const& dst) noexcept {
+    HM3_ASSERT(&src.tree() == &dst.tree(),
+               "the source and target grids have different trees");
+  }
+
+  static std::vector<grid_node_idx> inverse(
+   std::vector<grid_node_idx> const& p) {
+    idx_t no_nodes = 0;
+    for (auto&& n : p) { no_nodes = std::max(no_nodes, *n + 1); }
+    std::vector<grid_node_idx> new_idx(no_nodes);
+    for (idx_t i = 0, e = p.size(); i != e; ++i) {
+      new_idx[*p[i]] = grid_node_idx{i};
+    }
+    return new_idx;
+  }
+
+  /// Appends the entries of the sub-tree of the tree node \p n, where \p s
+  /// and \p d are the source and target cells containing \p n (if any)
+  template <typename Grid>
+  static void dfs(Grid const& src, Grid const& dst, tree_node_idx n,
+                  grid_node_idx s, grid_node_idx d, std::vector<entry>& es) {
+    constexpr uint_t nd = Grid::tree_t::dimension();
+    auto&& t            = dst.tree();
+    const bool in_src   = t.in_grid(n, src.idx());
+    const bool in_dst   = t.in_grid(n, dst.idx());
+    if (in_src) { s = src.in_tree(n); }
+    if (in_dst) {
+      d = dst.in_tree(n);
+      // same level or coarser source cell:
+      if (s) { es.push_back(entry{d, s, num_t{1}}); }
+    } else if (in_src and d) {  // finer source cell:
+      const uint_t dl = *src.level(s) - *dst.level(d);
+      const num_t w   = num_t{1} / math::ipow(math::ipow(2_u, nd), dl);
+      es.push_back(entry{d, s, w});
+    }
+    // below a source and a target cell there are no other cells:
+    if ((s and d) or t.is_leaf(n)) { return; }
+    for (auto&& p : t.child_positions()) {
+      dfs(src, dst, t.child(n, p), s, d, es);
+    }
+  }
+
+  /// Sorts the entries \p es by (target, source) and stores them (replacing
+  /// the current rows)
+  void store(std::vector<entry>&& es) {
+    targets_.clear();
+    offsets_.assign(1, 0);
+    std::sort(begin(es), end(es), [](entry const& a, entry const& b) {
+      return a.target != b.target ? a.target < b.target : a.source < b.source;
+    });
+    sources_.resize(es.size());
+    weights_.resize(es.size());
+    for (idx_t i = 0, e = es.size(); i != e; ++i) {
+      if (i == 0 or es[i].target != es[i - 1].target) {
+        targets_.push_back(es[i].target);
+        offsets_.push_back(i + 1);
+      } else {
+        offsets_.back() = i + 1;
+      }
+      sources_[i] = es[i].source;
+      weights_[i] = es[i].weight;
+    }
+  }
+};
+
+}  // namespace state
+}  // namespace solver
+}  // namespace hm3
@@ -1,18 +1,59 @@
 #pragma once
 /// \file
 ///
-/// Sorts a group of solvers in order
+/// Sorts a tree and the solvers defined on it
+#include <initializer_list>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/range.hpp>
 
 namespace hm3 {
 namespace solver {
 
 template <typename Solver> void sort(Solver&& s) { s.sort(); }
 
-template <typename Solver, typename... Solvers>
-void sort(Solver&& s, Solvers&&... ss) {
-  s.sort();
-  sort(std::forward<Solvers>(ss)...);
+namespace sort_detail {
+
+template <typename Tree, std::size_t... Is, typename... Solvers>
+void fused(Tree& t, std::index_sequence<Is...>, Solvers&... ss) {
+  // Compute the sort plans of all solver grids in a single traversal of the
+  // (sorted) tree:
+  auto plans = std::make_tuple(
+   typename std::decay_t<decltype(ss.g)>::sort_plan_t{}...);
+  (void)std::initializer_list<int>{
+   (std::get<Is>(plans).reserve(*ss.g.size()), 0)...};
+  RANGES_FOR (auto&& n, t.nodes()) {
+    (void)std::initializer_list<int>{
+     (t.in_grid(n, ss.g.idx()) ? std::get<Is>(plans).push_back(ss.g, n)
+                               : void(),
+      0)...};
+  }
+
+  // Permute the solvers one after the other (each permutation runs in
+  // parallel, and nested parallel regions would run on a single thread):
+  (void)std::initializer_list<int>{
+   (ss.sort(std::move(std::get<Is>(plans))), 0)...};
+}
+
+}  // namespace sort_detail
+
+/// Sorts the tree \p t and the solvers \p s, \p ss defined on it
+///
+/// The tree is sorted once, the sort plans of all solver grids are computed
+/// in a single traversal of the tree, and the solvers are then permuted one
+/// after the other (each using all threads). Each solver must provide its
+/// grid as a member `g` and a `sort(plan)` member function (see e.g.
+/// level_set::state::sort).
+///
+/// Time complexity: O(size(t) + sum of the solver sizes / no_threads).
+template <typename Tree, typename Solver, typename... Solvers>
+void sort(Tree&& t, Solver&& s, Solvers&&... ss) {
+  t.sort();
+  HM3_ASSERT(t.is_sorted(), "tree is not sorted!");
+  sort_detail::fused(t, std::make_index_sequence<1 + sizeof...(Solvers)>{},
+                     s, ss...);
 }
 
 }  // namespace solver
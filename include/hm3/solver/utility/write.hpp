@@ -1,17 +1,40 @@
 #pragma once
 /// \file
 ///
-/// Writes a group of solvers in order
+/// Writes a tree and the solvers defined on it
+#include <initializer_list>
 #include <utility>
+#include <vector>
+#include <hm3/io/file.hpp>
+#include <hm3/utility/assert.hpp>
+
 namespace hm3 {
 namespace solver {
 
 template <typename Solver> void write(Solver&& s) { s.write(); }
 
-template <typename Solver, typename... Solvers>
-void write(Solver&& s, Solvers&&... ss) {
-  s.write();
-  write(std::forward<Solvers>(ss)...);
+/// Writes the tree \p t and the solvers \p s, \p ss defined on it
+///
+/// The files of the tree and of all solvers are registered in the session in
+/// that order (so that the solver files depend on the tree file of the same
+/// output step), their data is written concurrently, and the session file is
+/// written once (see io::session::write). Each solver must provide an
+/// `unwritten_file()` member function (see e.g. level_set::state), and be in
+/// the I/O session of the tree.
+template <typename Tree, typename Solver, typename... Solvers>
+void write(Tree&& t, Solver&& s, Solvers&&... ss) {
+  auto assert_same_session = [&](auto&& solver) {
+    HM3_ASSERT(&solver.io_.session() == &t.io_.session(),
+               "the solver and the tree are in different I/O sessions");
+  };
+  assert_same_session(s);
+  (void)std::initializer_list<int>{(assert_same_session(ss), 0)...};
+  std::vector<io::file> fs;
+  fs.reserve(2 + sizeof...(Solvers));
+  fs.push_back(t.unwritten_file());
+  fs.push_back(s.unwritten_file());
+  (void)std::initializer_list<int>{(fs.push_back(ss.unwritten_file()), 0)...};
+  t.io_.session().write(fs);
 }
 
 }  // namespace solver
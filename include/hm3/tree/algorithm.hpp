@@ -2,8 +2,10 @@
 /// \file
 ///
 /// Tree algorithms
+#include <hm3/tree/algorithm/balance.hpp>
 #include <hm3/tree/algorithm/balanced_refine.hpp>
 #include <hm3/tree/algorithm/dfs_sort.hpp>
+#include <hm3/tree/algorithm/diff.hpp>
 #include <hm3/tree/algorithm/node_at.hpp>
 #include <hm3/tree/algorithm/node_length.hpp>
 #include <hm3/tree/algorithm/node_level.hpp>
@@ -13,4 +15,6 @@
 #include <hm3/tree/algorithm/node_or_parent_at.hpp>
 #include <hm3/tree/algorithm/normalized_coordinates.hpp>
 #include <hm3/tree/algorithm/root_traversal.hpp>
+#include <hm3/tree/algorithm/set_operations.hpp>
 #include <hm3/tree/algorithm/shift_location.hpp>
+#include <hm3/tree/algorithm/stats.hpp>
@@ -0,0 +1,90 @@
+#pragma once
+/// \file
+///
+/// 2:1 tree balancing algorithm
+#include <vector>
+#include <hm3/tree/algorithm/node_level.hpp>
+#include <hm3/tree/algorithm/node_location.hpp>
+#include <hm3/tree/algorithm/node_or_parent_at.hpp>
+#include <hm3/tree/algorithm/shift_location.hpp>
+#include <hm3/tree/concepts.hpp>
+#include <hm3/tree/relations/neighbor.hpp>
+#include <hm3/utility/static_const.hpp>
+
+namespace hm3 {
+namespace tree {
+//
+
+struct balance_fn {
+  /// Refines the nodes of the (possibly unbalanced) tree \p t until the levels
+  /// of neighboring leaf nodes (across all manifolds) differ at most by one
+  ///
+  /// The leaf nodes are processed in a single pass from the finest to the
+  /// coarsest level: for each leaf node at level l, the same-level neighbors of
+  /// its parent are created by refining the leaf nodes containing them (which
+  /// are at level < l - 1). The nodes created are at most at level l - 1, and
+  /// are processed afterwards.
+  ///
+  /// The nodes are refined using t.refine. If a node cannot be refined (e.g.
+  /// the tree is full) the tree is left unbalanced there.
+  ///
+  /// \returns true if the tree is balanced, false if refining a node failed
+  ///
+  /// Time complexity: O(N log(N)) (the location of each leaf is computed
+  /// once).
+  ///
+  /// \pre t.refine does not refine other nodes (i.e. t is not a multi grid
+  /// whose refine balances the tree by itself)
+  template <typename Tree> bool operator()(Tree& t) const {
+    constexpr uint_t nd = Tree::dimension();
+
+    bool balanced = true;
+
+    // Leaf nodes per level:
+    std::vector<std::vector<node_idx>> leafs;
+    RANGES_FOR (auto&& n, t.nodes()) {
+      if (!t.is_leaf(n)) { continue; }
+      const auto l = *node_level(t, n);
+      if (leafs.size() <= l) { leafs.resize(l + 1); }
+      leafs[l].push_back(n);
+    }
+
+    for (idx_t l = leafs.size() - 1; l > 1; --l) {
+      const level_idx min_level{static_cast<suint_t>(l - 1)};
+      // note: nodes are only appended to coarser levels in this loop
+      for (std::size_t i = 0; i != leafs[l].size(); ++i) {
+        const auto loc = node_location(t, t.parent(leafs[l][i]));
+        using manifold_rng = meta::as_list<meta::integer_range<int, 1, nd + 1>>;
+        meta::for_each(manifold_rng{}, [&](auto m_) {
+          using manifold = manifold_neighbors<nd, decltype(m_){}>;
+          manifold positions;
+          for (auto&& p : positions()) {
+            auto neighbor_loc
+             = shift_location(loc, positions[p], t.periodicity());
+            if (!neighbor_loc) { continue; }
+            auto m = node_or_parent_at(t, *neighbor_loc);
+            while (m.level < min_level) {
+              t.refine(m.idx);
+              if (t.is_leaf(m.idx)) {  // refinement failed
+                balanced = false;
+                break;
+              }
+              for (auto&& c : t.children(m.idx)) {
+                leafs[*m.level + 1].push_back(c);
+              }
+              m = node_or_parent_at(t, *neighbor_loc);
+            }
+          }
+        });
+      }
+    }
+    return balanced;
+  }
+};
+
+namespace {
+constexpr auto&& balance = static_const<balance_fn>::value;
+}  // namespace
+
+}  // namespace tree
+}  // namespace hm3
@@ -0,0 +1,75 @@
+#pragma once
+/// \file
+///
+/// Tree difference (change detection) algorithm
+#include <vector>
+#include <hm3/tree/types.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/static_const.hpp>
+
+namespace hm3 {
+namespace tree {
+
+struct diff_fn {
+  /// A changed sub-tree
+  ///
+  /// The sub-tree of \p old_node in the old tree differs from the sub-tree of
+  /// \p new_node in the new tree (both nodes are at the same location).
+  struct change {
+    node_idx old_node;
+    node_idx new_node;
+  };
+
+  using changes = std::vector<change>;
+
+ private:
+  template <typename Tree>
+  static void diff_impl(Tree const& t_old, node_idx o, Tree const& t_new,
+                        node_idx n, changes& result) {
+    if (t_old.hash(o) == t_new.hash(n)) { return; }
+
+    // If the refinement changed, or a payload changed, the whole sub-tree is
+    // reported:
+    if (t_old.is_leaf(o) or t_new.is_leaf(n)
+        or t_old.payload_hash(o) != t_new.payload_hash(n)) {
+      result.push_back(change{o, n});
+      return;
+    }
+
+    // Otherwise the change is in some of the children:
+    for (auto&& p : t_old.child_positions()) {
+      diff_impl(t_old, t_old.child(o, p), t_new, t_new.child(n, p), result);
+    }
+  }
+
+ public:
+  /// Changed sub-trees between the trees \p t_old and \p t_new
+  ///
+  /// \param t_old [in] Old tree (with sub-tree hashes enabled).
+  /// \param t_new [in] New tree (with sub-tree hashes enabled).
+  ///
+  /// \returns the roots of the smallest sub-trees that changed, that is, those
+  /// nodes that were refined/coarsened, whose payload changed, or whose
+  /// sub-tree was refined/coarsened.
+  ///
+  /// Only those sub-trees whose hashes differ are visited.
+  ///
+  /// Time complexity: O(C log(N)) where C is the number of changes.
+  ///
+  /// \pre t_old.has_hashes() && t_new.has_hashes()
+  template <typename Tree>
+  auto operator()(Tree const& t_old, Tree const& t_new) const -> changes {
+    HM3_ASSERT(t_old.has_hashes(), "old tree has no sub-tree hashes");
+    HM3_ASSERT(t_new.has_hashes(), "new tree has no sub-tree hashes");
+    changes result;
+    diff_impl(t_old, 0_n, t_new, 0_n, result);
+    return result;
+  }
+};
+
+namespace {
+constexpr auto&& diff = static_const<diff_fn>::value;
+}  // namespace
+
+}  // namespace tree
+}  // namespace hm3
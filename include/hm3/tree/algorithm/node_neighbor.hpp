@@ -17,6 +17,9 @@ namespace tree {
 /// Note: the manifold is associated to the neighbor index type
 /// (todo: strongly type this)
 ///
+/// The overloads taking a tree wrap around its periodic dimensions (see
+/// tree::periodicity).
+///
 struct node_neighbor_fn {
   template <typename Loc, typename NeighborIdx,
             typename Manifold = get_tag_t<NeighborIdx>,
@@ -34,7 +37,8 @@ struct node_neighbor_fn {
    noexcept {
     static_assert(Tree::dimension() == ranges::uncvref_t<Loc>::dimension(), "");
     static_assert(Tree::dimension() == Manifold::dimension(), "");
-    return location(node_location(t, n, l), p);
+    return shift_location(node_location(t, n, l), Manifold{}[p],
+                          t.periodicity());
   }
 
   template <typename Tree, typename Loc, typename NeighborIdx,
@@ -44,7 +48,7 @@ struct node_neighbor_fn {
    -> node_idx {
     static_assert(Tree::dimension() == ranges::uncvref_t<Loc>::dimension(), "");
     static_assert(Tree::dimension() == Manifold::dimension(), "");
-    return node_at(t, location(loc, p));
+    return node_at(t, shift_location(loc, Manifold{}[p], t.periodicity()));
   }
 
   template <typename Tree, typename NeighborIdx,
@@ -23,6 +23,9 @@ struct node_neighbors_fn {
 
   /// Finds neighbors of node at location \p loc across the Manifold
   /// (appends them to a push_back-able container)
+  ///
+  /// The neighbor locations wrap around the periodic dimensions of the tree
+  /// (see tree::periodicity).
   template <typename Manifold, typename Tree, typename Loc,
             typename PushBackableContainer,
             typename UnaryPredicate = always_true_pred,
@@ -37,8 +40,8 @@ struct node_neighbors_fn {
     if (HM3_UNLIKELY(lvl == 0_l)) { return; }
     // For all same level neighbor positions
     for (auto&& sl_pos : positions()) {
-      auto neighbor
-       = node_or_parent_at(t, shift_location(loc, positions[sl_pos]));
+      auto neighbor = node_or_parent_at(
+       t, shift_location(loc, positions[sl_pos], t.periodicity()));
       const auto n = neighbor.idx;
       if (!n) { continue; }
       HM3_ASSERT((neighbor.level == lvl) || (neighbor.level == (lvl - 1)),
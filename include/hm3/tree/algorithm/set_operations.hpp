@@ -0,0 +1,264 @@
+#pragma once
+/// \file
+///
+/// Tree set operations: union, intersection, and difference
+///
+/// The trees are interpreted as sets of nodes (i.e. as refinement patterns).
+/// The algorithms walk both input trees in lockstep in depth-first order and
+/// output a depth-first sorted, compact tree.
+///
+/// Runtime complexity: O(N1 + N2), where N1 and N2 are the number of nodes of
+/// the input trees.
+///
+/// The work is distributed in parallel over the sub-trees of the root node.
+#include <array>
+#include <vector>
+#include <hm3/tree/tree.hpp>
+#include <hm3/utility/parallel.hpp>
+#include <hm3/utility/static_const.hpp>
+
+namespace hm3 {
+namespace tree {
+
+namespace set_operations_detail {
+
+/// Child at position \p p of node \p n (invalid if \p n is invalid or a leaf)
+template <uint_t Nd, typename Idx>
+node_idx child(tree<Nd, Idx> const& t, node_idx n,
+               child_pos<Nd> p) noexcept {
+  return n ? t.child(n, p) : node_idx{};
+}
+
+/// Is node \p n of tree \p t valid and refined?
+template <uint_t Nd, typename Idx>
+bool is_refined(tree<Nd, Idx> const& t, node_idx n) noexcept {
+  return n and !t.is_leaf(n);
+}
+
+/// Callback that ignores the output-to-input node mapping
+struct ignore_nodes_fn {
+  void operator()(node_idx, node_idx, node_idx) const noexcept {}
+};
+
+/// Generic set operation
+///
+/// Op::refined(a, na, b, nb) -> bool returns whether the output node
+/// corresponding to the input nodes (na, nb) is refined.
+template <typename Op> struct set_operation_fn {
+ private:
+  /// Number of sibling groups of the output sub-tree below the nodes (na, nb)
+  template <uint_t Nd, typename Idx, typename OpState>
+  static idx_t count(tree<Nd, Idx> const& a, node_idx na,
+                     tree<Nd, Idx> const& b, node_idx nb,
+                     OpState const& op) noexcept {
+    if (!op.refined(a, na, b, nb)) { return 0; }
+    idx_t result = 1;
+    for (auto&& p : tree<Nd, Idx>::child_positions()) {
+      result += count(a, child(a, na, p), b, child(b, nb, p), op);
+    }
+    return result;
+  }
+
+  /// Writes the children group of output node \p no to the sibling group \p s
+  /// of the output tree \p o, and then the sub-trees of its children in
+  /// depth-first order.
+  ///
+  /// \returns the next free sibling group after the sub-tree of \p no
+  template <uint_t Nd, typename Idx, typename OpState, typename OnNode>
+  static siblings_idx write(tree<Nd, Idx>& o, node_idx no, siblings_idx s,
+                            tree<Nd, Idx> const& a, node_idx na,
+                            tree<Nd, Idx> const& b, node_idx nb,
+                            OpState const& op, OnNode& on_node) noexcept {
+    using stored_t    = typename tree<Nd, Idx>::stored_node_idx;
+    const node_idx fc = *begin(tree<Nd, Idx>::nodes(s));
+    o.parents_[*s]         = compact_optional_cast<stored_t>(no);
+    o.first_children_[*no] = compact_optional_cast<stored_t>(fc);
+    ++s;
+    for (auto&& p : tree<Nd, Idx>::child_positions()) {
+      const node_idx co = node_idx{*fc + *p};
+      const node_idx ca = child(a, na, p);
+      const node_idx cb = child(b, nb, p);
+      on_node(co, ca, cb);
+      if (op.refined(a, ca, b, cb)) {
+        s = write(o, co, s, a, ca, b, cb, op, on_node);
+      }
+    }
+    return s;
+  }
+
+ public:
+  /// Computes the set operation between the trees \p a and \p b
+  ///
+  /// \param a             [in] First input tree.
+  /// \param b             [in] Second input tree.
+  /// \param on_node       [in] Function (out, in_a, in_b) -> ignored that is
+  ///                           called once per output node with the
+  ///                           corresponding input nodes (invalid if the node
+  ///                           is not part of the input tree). Useful to build
+  ///                           node maps from/to the input trees.
+  /// \param node_capacity [in] Minimum node capacity of the output tree.
+  ///
+  /// \returns depth-first sorted compact tree
+  ///
+  /// \warning \p on_node is called concurrently for different output nodes
+  template <uint_t Nd, typename Idx, typename OnNode = ignore_nodes_fn>
+  tree<Nd, Idx> operator()(tree<Nd, Idx> const& a, tree<Nd, Idx> const& b,
+                      OnNode&& on_node = OnNode{},
+                      node_idx node_capacity = 0_n) const {
+    using tree_t                   = tree<Nd, Idx>;
+    constexpr auto no_top_subtrees = tree_t::no_children();
+    const auto op                  = Op::make(a, b);
+
+    /// Pass 1: number of sibling groups of each top-level sub-tree
+    /// (one per child of the root node)
+    std::array<idx_t, no_top_subtrees> no_sgs;
+    no_sgs.fill(0);
+    const bool root_refined = op.refined(a, 0_n, b, 0_n);
+    if (root_refined) {
+      parallel::for_each(0, no_top_subtrees, [&](int_t i) {
+        const auto p = child_pos<Nd>{static_cast<suint_t>(i)};
+        no_sgs[i]    = count(a, child(a, 0_n, p), b, child(b, 0_n, p), op);
+      });
+    }
+
+    /// Offsets of the top-level sub-trees within the output tree
+    /// (sg 0 is the root node, sg 1 the root's children)
+    std::array<idx_t, no_top_subtrees> offsets;
+    idx_t no_sgs_total = 1;
+    if (root_refined) {
+      no_sgs_total = 2;
+      for (uint_t i = 0; i != no_top_subtrees; ++i) {
+        offsets[i] = no_sgs_total;
+        no_sgs_total += no_sgs[i];
+      }
+    }
+
+    /// Allocate the output tree
+    const auto no_nodes = tree_t::no_nodes(siblings_idx{no_sgs_total});
+    tree_t o(node_capacity > no_nodes ? node_capacity : no_nodes);
+    on_node(0_n, 0_n, 0_n);
+
+    /// Pass 2: write the root's children and each top-level sub-tree
+    if (root_refined) {
+      using stored_t       = typename tree_t::stored_node_idx;
+      o.parents_[1]        = stored_t{0};
+      o.first_children_[0] = stored_t{1};
+      parallel::for_each(0, no_top_subtrees, [&](int_t i) {
+        const auto p  = child_pos<Nd>{static_cast<suint_t>(i)};
+        const auto co = node_idx{1 + i};
+        const auto ca = child(a, 0_n, p);
+        const auto cb = child(b, 0_n, p);
+        on_node(co, ca, cb);
+        if (op.refined(a, ca, b, cb)) {
+          write(o, co, siblings_idx{offsets[i]}, a, ca, b, cb, op, on_node);
+        }
+      });
+    }
+    o.size_                     = no_nodes;
+    o.first_free_sibling_group_ = siblings_idx{no_sgs_total};
+    HM3_ASSERT(o.is_compact(), "output tree must be compact");
+    return o;
+  }
+};
+
+/// Union: an output node is refined if it is refined in any input tree
+struct union_op {
+  template <uint_t Nd, typename Idx>
+  static union_op make(tree<Nd, Idx> const&,
+                       tree<Nd, Idx> const&) noexcept {
+    return {};
+  }
+  template <uint_t Nd, typename Idx>
+  bool refined(tree<Nd, Idx> const& a, node_idx na, tree<Nd, Idx> const& b,
+               node_idx nb) const noexcept {
+    return is_refined(a, na) or is_refined(b, nb);
+  }
+};
+
+/// Intersection: an output node is refined if it is refined in both input
+/// trees
+struct intersection_op {
+  template <uint_t Nd, typename Idx>
+  static intersection_op make(tree<Nd, Idx> const&,
+                              tree<Nd, Idx> const&) noexcept {
+    return {};
+  }
+  template <uint_t Nd, typename Idx>
+  bool refined(tree<Nd, Idx> const& a, node_idx na, tree<Nd, Idx> const& b,
+               node_idx nb) const noexcept {
+    return is_refined(a, na) and is_refined(b, nb);
+  }
+};
+
+/// Difference: an output node is refined if it is refined in the first tree,
+/// and the sub-tree of the first tree below it contains nodes that are not
+/// part of the second tree (that is, the output keeps the refinement of the
+/// first tree only where it is finer than the second tree).
+///
+/// This requires a pre-pass over both trees to compute which sub-trees of the
+/// first tree differ from the second one.
+struct difference_op {
+  /// Is the sub-tree below node n of the first tree different from the
+  /// second tree? (one flag per node of the first tree)
+  std::vector<char> differs_;
+
+  template <uint_t Nd, typename Idx>
+  static bool mark(tree<Nd, Idx> const& a, node_idx na,
+                   tree<Nd, Idx> const& b, node_idx nb,
+                   std::vector<char>& differs) noexcept {
+    if (a.is_leaf(na)) { return false; }
+    bool result = !is_refined(b, nb);
+    for (auto&& p : tree<Nd, Idx>::child_positions()) {
+      // note: all children need to be visited to set their flags
+      const bool c = mark(a, a.child(na, p), b, child(b, nb, p), differs);
+      result = result or c;
+    }
+    differs[*na] = result;
+    return result;
+  }
+
+  template <uint_t Nd, typename Idx>
+  static difference_op make(tree<Nd, Idx> const& a,
+                            tree<Nd, Idx> const& b) {
+    difference_op op;
+    op.differs_.resize(*a.capacity(), false);
+    if (a.is_leaf(0_n)) { return op; }
+    parallel::for_each(0, tree<Nd, Idx>::no_children(), [&](int_t i) {
+      const auto p = child_pos<Nd>{static_cast<suint_t>(i)};
+      mark(a, a.child(0_n, p), b, child(b, 0_n, p), op.differs_);
+    });
+    op.differs_[0] = !is_refined(b, 0_n)
+                     or any_of(a.children(0_n), [&](node_idx c) {
+                          return static_cast<bool>(op.differs_[*c]);
+                        });
+    return op;
+  }
+
+  template <uint_t Nd, typename Idx>
+  bool refined(tree<Nd, Idx> const& a, node_idx na, tree<Nd, Idx> const&,
+               node_idx) const noexcept {
+    return is_refined(a, na) and differs_[*na];
+  }
+};
+
+}  // namespace set_operations_detail
+
+using tree_union_fn = set_operations_detail::set_operation_fn<
+ set_operations_detail::union_op>;
+using tree_intersection_fn = set_operations_detail::set_operation_fn<
+ set_operations_detail::intersection_op>;
+using tree_difference_fn = set_operations_detail::set_operation_fn<
+ set_operations_detail::difference_op>;
+
+namespace {
+/// Union of two trees: tree_union(a, b[, on_node, node_capacity])
+constexpr auto&& tree_union = static_const<tree_union_fn>::value;
+/// Intersection of two trees: tree_intersection(a, b[, on_node,
+/// node_capacity])
+constexpr auto&& tree_intersection = static_const<tree_intersection_fn>::value;
+/// Difference of two trees: tree_difference(a, b[, on_node, node_capacity])
+constexpr auto&& tree_difference = static_const<tree_difference_fn>::value;
+}  // namespace
+
+}  // namespace tree
+}  // namespace hm3
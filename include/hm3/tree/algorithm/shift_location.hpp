@@ -38,6 +38,20 @@ struct shift_location_fn {
    -> compact_optional<Loc> {
     return shift(loc, offset);
   }
+
+  /// Shifts the location \p loc by \p offset wrapping around the axes in
+  /// which \p periodic is true
+  ///
+  /// Along the periodic axes the resulting location wraps around modulo
+  /// 2^level. Along the other axes, if the resulting location is out-of-bounds
+  /// the optional_location won't contain a valid value.
+  template <typename Loc, uint_t Nd = Loc::dimension(),
+            CONCEPT_REQUIRES_(Location<Loc>{})>
+  auto operator()(Loc loc, std::array<int_t, Nd> offset,
+                  std::array<bool, Nd> periodic) const noexcept
+   -> compact_optional<Loc> {
+    return shift(loc, offset, periodic);
+  }
 };
 
 namespace {
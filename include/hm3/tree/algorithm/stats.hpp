@@ -0,0 +1,299 @@
+#pragma once
+/// \file
+///
+/// Tree structure statistics
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <vector>
+#include <hm3/io/json.hpp>
+#include <hm3/tree/algorithm/node_level.hpp>
+#include <hm3/tree/algorithm/node_location.hpp>
+#include <hm3/tree/algorithm/node_or_parent_at.hpp>
+#include <hm3/tree/algorithm/shift_location.hpp>
+#include <hm3/tree/relations/neighbor.hpp>
+#include <hm3/tree/types.hpp>
+#include <hm3/utility/parallel.hpp>
+#include <hm3/utility/static_const.hpp>
+
+namespace hm3 {
+namespace tree {
+
+/// Structure statistics of a tree
+///
+/// Useful to tune the capacity of the tree and how often it is sorted.
+struct statistics {
+  /// Memory used and reserved by an array
+  struct memory_entry {
+    string name;
+    uint_t used;      ///< Bytes in use
+    uint_t reserved;  ///< Bytes allocated
+  };
+
+  /// Number of bins of the free sibling group distribution
+  static constexpr uint_t no_bins = 16;
+
+  uint_t dimension = 0;
+  /// \name Nodes
+  ///@{
+  idx_t no_nodes      = 0;
+  idx_t node_capacity = 0;
+  idx_t no_leaf_nodes = 0;
+  std::vector<idx_t> no_nodes_per_level;
+  std::vector<idx_t> no_leaf_nodes_per_level;
+  ///@}
+
+  /// \name Sibling groups
+  ///@{
+  idx_t no_sibling_groups      = 0;
+  idx_t sibling_group_capacity = 0;
+  /// One past the last sibling group in use
+  idx_t sibling_group_extent = 0;
+  /// Number of contiguous ranges of free sibling groups before the extent
+  idx_t no_hole_runs = 0;
+  /// Number of free sibling groups in each of no_bins equally-sized ranges of
+  /// the sibling group capacity
+  std::array<idx_t, no_bins> free_sibling_groups_per_bin{};
+  ///@}
+
+  /// \name Locality
+  ///@{
+  num_t parent_child_distance  = 0.;  ///< Sum of |child - parent|
+  idx_t no_parent_child_pairs  = 0;
+  num_t face_neighbor_distance = 0.;  ///< Sum of |neighbor - leaf|
+  idx_t no_face_neighbor_pairs = 0;
+  ///@}
+
+  /// Number of leaf nodes with neighbors more than one level finer
+  idx_t no_2to1_violations = 0;
+
+  std::vector<memory_entry> memory;
+
+  /// Number of free sibling groups before the extent
+  idx_t no_holes() const noexcept {
+    return sibling_group_extent - no_sibling_groups;
+  }
+  /// Sibling groups in use / sibling group capacity
+  num_t occupancy() const noexcept {
+    return sibling_group_capacity > 0
+            ? static_cast<num_t>(no_sibling_groups) / sibling_group_capacity
+            : 0.;
+  }
+  /// Sibling groups in use / sibling group extent (1 if the tree is compact)
+  num_t density() const noexcept {
+    return sibling_group_extent > 0
+            ? static_cast<num_t>(no_sibling_groups) / sibling_group_extent
+            : 0.;
+  }
+  /// Mean index distance between parents and children
+  num_t mean_parent_child_distance() const noexcept {
+    return no_parent_child_pairs > 0
+            ? parent_child_distance / no_parent_child_pairs
+            : 0.;
+  }
+  /// Mean index distance between leaf nodes and their face neighbors
+  num_t mean_face_neighbor_distance() const noexcept {
+    return no_face_neighbor_pairs > 0
+            ? face_neighbor_distance / no_face_neighbor_pairs
+            : 0.;
+  }
+  /// Total memory used (bytes)
+  uint_t memory_used() const noexcept {
+    uint_t r = 0;
+    for (auto&& m : memory) { r += m.used; }
+    return r;
+  }
+  /// Total memory reserved (bytes)
+  uint_t memory_reserved() const noexcept {
+    uint_t r = 0;
+    for (auto&& m : memory) { r += m.reserved; }
+    return r;
+  }
+
+  /// Accumulates the partial statistics \p o
+  void merge(statistics const& o) {
+    auto merge_levels = [](auto& a, auto const& b) {
+      if (a.size() < b.size()) { a.resize(b.size(), 0); }
+      for (std::size_t i = 0, e = b.size(); i != e; ++i) { a[i] += b[i]; }
+    };
+    no_nodes += o.no_nodes;
+    no_leaf_nodes += o.no_leaf_nodes;
+    merge_levels(no_nodes_per_level, o.no_nodes_per_level);
+    merge_levels(no_leaf_nodes_per_level, o.no_leaf_nodes_per_level);
+    no_sibling_groups += o.no_sibling_groups;
+    sibling_group_extent
+     = std::max(sibling_group_extent, o.sibling_group_extent);
+    no_hole_runs += o.no_hole_runs;
+    for (uint_t i = 0; i != no_bins; ++i) {
+      free_sibling_groups_per_bin[i] += o.free_sibling_groups_per_bin[i];
+    }
+    parent_child_distance += o.parent_child_distance;
+    no_parent_child_pairs += o.no_parent_child_pairs;
+    face_neighbor_distance += o.face_neighbor_distance;
+    no_face_neighbor_pairs += o.no_face_neighbor_pairs;
+    no_2to1_violations += o.no_2to1_violations;
+  }
+};
+
+/// Statistics as JSON
+inline io::json to_json(statistics const& s) {
+  io::json j;
+  j["dimension"]               = s.dimension;
+  j["no_nodes"]                = s.no_nodes;
+  j["node_capacity"]           = s.node_capacity;
+  j["no_leaf_nodes"]           = s.no_leaf_nodes;
+  j["no_nodes_per_level"]      = s.no_nodes_per_level;
+  j["no_leaf_nodes_per_level"] = s.no_leaf_nodes_per_level;
+  j["sibling_groups"]          = {
+   {"no_in_use", s.no_sibling_groups},
+   {"capacity", s.sibling_group_capacity},
+   {"extent", s.sibling_group_extent},
+   {"occupancy", s.occupancy()},
+   {"density", s.density()},
+   {"no_holes", s.no_holes()},
+   {"no_hole_runs", s.no_hole_runs},
+   {"free_per_bin", std::vector<idx_t>(begin(s.free_sibling_groups_per_bin),
+                                       end(s.free_sibling_groups_per_bin))}};
+  j["locality"] = {
+   {"mean_parent_child_distance", s.mean_parent_child_distance()},
+   {"mean_face_neighbor_distance", s.mean_face_neighbor_distance()}};
+  j["no_2to1_violations"] = s.no_2to1_violations;
+  io::json m;
+  for (auto&& e : s.memory) {
+    m[e.name] = {{"used", e.used}, {"reserved", e.reserved}};
+  }
+  m["total"] = {{"used", s.memory_used()}, {"reserved", s.memory_reserved()}};
+  j["memory"] = m;
+  return j;
+}
+
+struct stats_fn {
+ private:
+  /// Increments the counter of level \p l in \p v
+  static void count(std::vector<idx_t>& v, level_idx l) {
+    if (v.size() <= *l) { v.resize(*l + 1, 0); }
+    ++v[*l];
+  }
+
+  /// Neighbor statistics of the leaf node \p n
+  template <typename Tree, int Nd = Tree::dimension()>
+  static void leaf_neighbors(Tree const& t, node_idx n, statistics& r) {
+    const auto loc = node_location(t, n);
+    const auto lvl = loc.level();
+    if (lvl == 0_l) { return; }
+
+    bool violation = false;
+    using manifold_rng = meta::as_list<meta::integer_range<int, 1, Nd + 1>>;
+    meta::for_each(manifold_rng{}, [&](auto m_) {
+      using manifold = manifold_neighbors<Nd, decltype(m_){}>;
+      manifold positions;
+      for (auto&& p : positions()) {
+        auto nb = node_or_parent_at(
+         t, shift_location(loc, positions[p], t.periodicity()));
+        if (!nb.idx) { continue; }
+        if (decltype(m_){} == 1) {  // face neighbors
+          r.face_neighbor_distance += std::abs(*nb.idx - *n);
+          ++r.no_face_neighbor_pairs;
+        }
+        // a refined neighbor at the same level whose children sharing a
+        // face with the node are refined violates 2:1
+        if (nb.level != lvl or t.is_leaf(nb.idx)) { continue; }
+        for (auto&& cp : positions.children_sharing_face(p)) {
+          if (!t.is_leaf(t.child(nb.idx, cp))) { violation = true; }
+        }
+      }
+    });
+    if (violation) { ++r.no_2to1_violations; }
+  }
+
+  /// Statistics of sibling group \p s
+  template <typename Tree>
+  static void visit(Tree const& t, siblings_idx s, statistics& r) {
+    if (s != 0_sg and !t.parent(s)) {  // free sibling group
+      ++r.free_sibling_groups_per_bin[*s * statistics::no_bins
+                                      / r.sibling_group_capacity];
+      // first free sibling group of a run?
+      const auto prev = siblings_idx{*s - 1};
+      if (prev == 0_sg or t.parent(prev)) { ++r.no_hole_runs; }
+      return;
+    }
+
+    ++r.no_sibling_groups;
+    r.sibling_group_extent = std::max(r.sibling_group_extent, *s + 1);
+    const auto lvl = node_level(t, *begin(t.nodes(s)));
+    for (auto&& n : t.nodes(s)) {
+      ++r.no_nodes;
+      count(r.no_nodes_per_level, lvl);
+      if (t.is_leaf(n)) {
+        ++r.no_leaf_nodes;
+        count(r.no_leaf_nodes_per_level, lvl);
+        leaf_neighbors(t, n, r);
+        continue;
+      }
+      for (auto&& c : t.children(n)) {
+        r.parent_child_distance += std::abs(*c - *n);
+        ++r.no_parent_child_pairs;
+      }
+    }
+  }
+
+ public:
+  /// Structure statistics of the tree \p t
+  ///
+  /// \param t [in] Tree.
+  ///
+  /// Computes the node and leaf counts per level, the occupancy of the
+  /// sibling groups and the distribution of the free ones, the memory used
+  /// and reserved by the tree, the locality of the tree (mean index distance
+  /// between parents and children, and between leaf nodes and their face
+  /// neighbors), and the number of 2:1 balance violations.
+  ///
+  /// The statistics are computed in a single parallel pass over the sibling
+  /// groups of the tree.
+  ///
+  /// Time complexity: O(N log(N))
+  template <typename Tree> statistics operator()(Tree const& t) const {
+    using stored_t        = typename Tree::stored_node_idx;
+    const idx_t sg_cap    = *t.sibling_group_capacity();
+    const auto no_threads = static_cast<int_t>(parallel::no_threads());
+
+    std::vector<statistics> partial(no_threads);
+    for (auto&& p : partial) { p.sibling_group_capacity = sg_cap; }
+    parallel::for_each_static(0, no_threads, [&](int_t i) {
+      const idx_t from = sg_cap * i / no_threads;
+      const idx_t to   = sg_cap * (i + 1) / no_threads;
+      for (idx_t s = from; s != to; ++s) {
+        visit(t, siblings_idx{s}, partial[i]);
+      }
+    });
+
+    statistics r;
+    r.dimension              = Tree::dimension();
+    r.node_capacity          = *t.capacity();
+    r.sibling_group_capacity = sg_cap;
+    for (auto&& p : partial) { r.merge(p); }
+    // the run of free sibling groups after the extent is not a hole:
+    if (r.sibling_group_extent < sg_cap) { --r.no_hole_runs; }
+
+    const uint_t idx_size = sizeof(stored_t);
+    r.memory.push_back({"parents", r.no_sibling_groups * idx_size,
+                        static_cast<uint_t>(sg_cap) * idx_size});
+    r.memory.push_back({"first_children", r.no_nodes * idx_size,
+                        static_cast<uint_t>(r.node_capacity) * idx_size});
+    if (t.has_hashes()) {
+      const uint_t hash_size = sizeof(typename Tree::hash_t);
+      const uint_t no_arrays = t.has_payload_hashes() ? 2 : 1;
+      r.memory.push_back(
+       {"hashes", no_arrays * r.no_nodes * hash_size,
+        no_arrays * static_cast<uint_t>(r.node_capacity) * hash_size});
+    }
+    return r;
+  }
+};
+
+namespace {
+constexpr auto&& stats = static_const<stats_fn>::value;
+}  // namespace
+
+}  // namespace tree
+}  // namespace hm3
@@ -191,6 +191,24 @@ template <uint_t Nd, typename T = uint_t> struct fast {
     return opt_this_t{l};
   }
 
+  /// Shifts the location \p l by \p offset wrapping around the axes in which
+  /// \p periodic is true (modulo 2^level)
+  friend opt_this_t shift(this_t l, std::array<int_t, Nd> offset,
+                          std::array<bool, Nd> periodic) noexcept {
+    const auto lvl  = static_cast<integer_t>(*l.level());
+    const auto mask = static_cast<integer_t>(bit::max_value(lvl));
+    for (auto&& d : dimensions()) {
+      const auto x = l.to_int(d);
+      if (!periodic[d] and bit::overflows_on_add(x, offset[d], lvl)) {
+        return opt_this_t{};
+      }
+      // unsigned arithmetic wraps around modulo 2^level:
+      l.x[d] = bit::to_int_r((x + static_cast<T>(offset[d])) & mask,
+                             static_cast<T>(0), static_cast<T>(lvl + 1));
+    }
+    return opt_this_t{l};
+  }
+
   uint_t pop() noexcept {
     uint_t tmp = (*this)[level()];
     --level_;
@@ -234,6 +234,32 @@ compact_optional<slim<Nd, Int>> shift(slim<Nd, Int> t,
   return compact_optional<sl>{};
 }
 
+/// Shifts the location \p t by \p offset wrapping around the axes in which
+/// \p periodic is true (modulo 2^level)
+///
+/// Along the non-periodic axes, if the resulting location is out-of-bounds
+/// the optional location won't contain a valid value.
+template <uint_t Nd, typename Int>
+compact_optional<slim<Nd, Int>> shift(slim<Nd, Int> t,
+                                      std::array<int_t, Nd> offset,
+                                      std::array<bool, Nd> periodic) noexcept {
+  using sl       = slim<Nd, Int>;
+  auto lvl       = t.level();
+  auto xs        = sl::decode(t.value, static_cast<Int>(*lvl));
+  const Int mask = bit::max_value(*lvl);  // 2^level - 1
+  for (auto&& d : dimensions(Nd)) {
+    if (!periodic[d]
+        and bit::overflows_on_add(xs[d], offset[d], static_cast<Int>(*lvl))) {
+      return compact_optional<sl>{};
+    }
+    // unsigned arithmetic wraps around modulo 2^level:
+    xs[d] = (xs[d] + static_cast<Int>(offset[d])) & mask;
+  }
+  t.value = sl::encode(xs, lvl);
+  HM3_ASSERT(t.value != 0_u, "logic error, encoding delivers zero");
+  return compact_optional<sl>{t};
+}
+
 template <uint_t Nd, typename T>
 constexpr bool operator==(slim<Nd, T> const& a, slim<Nd, T> const& b) noexcept {
   return a.value == b.value;
@@ -12,11 +12,15 @@ namespace hm3 {
 namespace tree {
 
 /// Maps arrays in the file descriptor to memory addresses
-template <uint_t Nd> void map_arrays(io::file& f, tree<Nd> const& t) {
-  f.field("parents", reinterpret_cast<uint_t const*>(t.parents_.get()),
-          *t.no_sibling_groups(t.size()))
-   .field("first_children",
-          reinterpret_cast<uint_t const*>(t.first_children_.get()), *t.size());
+///
+/// The node indices are always stored in the file as 64-bit integers (trees
+/// using a different index type are converted on write/read).
+template <uint_t Nd, typename Idx>
+void map_arrays(io::file& f, tree<Nd, Idx> const& t) {
+  f.index_field<uint_t>("parents", t.parents_.get(),
+                        *t.no_sibling_groups(t.size()))
+   .index_field<uint_t>("first_children", t.first_children_.get(),
+                        *t.size());
   // f.field("sibling_to_parent_edges",
   //         reinterpret_cast<uint_t const*>(t.parents_.get()),
   //         *t.no_sibling_groups(t.size()))
@@ -26,9 +30,9 @@ template <uint_t Nd> void map_arrays(io::file& f, tree<Nd> const& t) {
 }
 
 /// Returns a yet to be read tree from a file descriptor \p f
-template <uint_t Nd>
-tree<Nd> from_file_unread(tree<Nd> const&, io::file& f,
-                          node_idx node_capacity) {
+template <uint_t Nd, typename Idx>
+tree<Nd, Idx> from_file_unread(tree<Nd, Idx> const&, io::file& f,
+                               node_idx node_capacity) {
   // Check the tree dimension:
   auto tree_dim = f.constant("spatial_dimension", int64_t{});
   if (Nd != tree_dim) {
@@ -47,7 +51,7 @@ tree<Nd> from_file_unread(tree<Nd> const&, io::file& f,
   }
 
   // Construct a tree with the given capacity and number of nodes:
-  tree<Nd> t(*node_capacity);
+  tree<Nd, Idx> t(*node_capacity);
   t.size_                     = node_idx{no_nodes};
   t.first_free_sibling_group_ = t.sibling_group(t.size());
 
@@ -55,23 +59,24 @@ tree<Nd> from_file_unread(tree<Nd> const&, io::file& f,
   map_arrays(f, t);
 
   // Move the tree out of the function:
-  static_assert(std::is_move_constructible<tree<Nd>>{},
+  static_assert(std::is_move_constructible<tree<Nd, Idx>>{},
                 "if the tree is not move constructible mapping the arrays "
                 "fails (they will be mapped to the wrong addresses in memory)");
   return t;
 }
 
 /// Reads tree from file descriptor \p f
-template <uint_t Nd>
-tree<Nd> from_file(tree<Nd> const&, io::file& f,
-                   node_idx node_capacity = node_idx{}) {
-  auto&& t = from_file_unread(tree<Nd>{}, f, node_capacity);
+template <uint_t Nd, typename Idx>
+tree<Nd, Idx> from_file(tree<Nd, Idx> const&, io::file& f,
+                        node_idx node_capacity = node_idx{}) {
+  auto&& t = from_file_unread(tree<Nd, Idx>{}, f, node_capacity);
   f.read_arrays();
   return t;
 }
 
 /// Appends constants and map arrays to file \p f
-template <uint_t Nd> void to_file_unwritten(io::file& f, tree<Nd> const& t) {
+template <uint_t Nd, typename Idx>
+void to_file_unwritten(io::file& f, tree<Nd, Idx> const& t) {
   f.field("spatial_dimension", Nd).field("no_tree_nodes", *t.size());
   map_arrays(f, t);
 }
@@ -3,12 +3,16 @@
 /// TODO:
 /// - replace static_cast<int_t> with static_cast<uint_t>
 ///
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <vector>
 #include <hm3/tree/types.hpp>
 #include <hm3/tree/relations/tree.hpp>
 #include <hm3/utility/assert.hpp>
 #include <hm3/utility/fmt.hpp>
 #include <hm3/utility/math.hpp>
+#include <hm3/utility/parallel.hpp>
 #include <hm3/utility/range.hpp>
 #include <hm3/utility/bounded.hpp>
 
@@ -16,7 +20,18 @@ namespace hm3 {
 namespace tree {
 
 /// Nd-octree data-structure
-template <uint_t Nd> struct tree {
+///
+/// The node indices are stored using the integer type \p Idx (64-bit by
+/// default). Trees with less than 2^32 - 1 nodes can use std::uint32_t (the
+/// maximum value marks invalid indices) to halve the memory footprint of the
+/// tree and the memory bandwidth required to traverse it. The interface
+/// always uses node_idx.
+template <uint_t Nd, typename Idx> struct tree {
+  /// Integer type used to store the node indices
+  using index_type = Idx;
+  /// Node index as stored in memory
+  using stored_node_idx = node_idx_storage<Idx>;
+
   /// \name Data (all member variables of the tree)
   ///
   /// Memory layout: siblings (node with the same parent) are stored
@@ -24,7 +39,7 @@ template <uint_t Nd> struct tree {
   ///
   /// The order of groups of children is arbitrary.
   ///
-  /// Memory requirements: 1 word + 1 / no_children word per node
+  /// Memory requirements: 1 index + 1 / no_children index per node
   /// - each node stores the index of its first child (the other children are
   ///   stored contiguously after the first in Z-Order)
   /// - each group of siblings stores the index of its parent
@@ -39,13 +54,17 @@ template <uint_t Nd> struct tree {
   /// store
   siblings_idx sg_capacity_ = 0_sg;
   /// Indices to the parent node of each sibling group (1 index / sibling group)
-  std::unique_ptr<node_idx[]> parents_ = nullptr;
+  std::unique_ptr<stored_node_idx[]> parents_ = nullptr;
   /// Indices of the first children of each node (1 index / node)
-  std::unique_ptr<node_idx[]> first_children_ = nullptr;
+  std::unique_ptr<stored_node_idx[]> first_children_ = nullptr;
   /// Number of nodes in the tree
   node_idx size_ = 0_n;
   /// First group of siblings that is free (i.e. not in use)
   siblings_idx first_free_sibling_group_{0};
+  /// Sub-tree hash of each node (optional: 1 word / node, see hash)
+  std::unique_ptr<std::uint64_t[]> hashes_ = nullptr;
+  /// Payload hash of each node (optional: 1 word / node, see hash)
+  std::unique_ptr<std::uint64_t[]> payload_hashes_ = nullptr;
 
   ///@}  // Data
 
@@ -67,6 +86,13 @@ template <uint_t Nd> struct tree {
     return hm3::tree::no_children(Nd);
   }
 
+  /// Periodicity of the tree along each spatial dimension (none)
+  ///
+  /// Neighbor queries wrap around the periodic dimensions (see
+  /// tree::node_neighbors). Grids with periodic boundaries hide this function
+  /// (see grid::hc::single).
+  static constexpr std::array<bool, Nd> periodicity() noexcept { return {}; }
+
   /// Position of node \p n within its parent
   ///
   /// \post n == child(parent(n), position_in_parent(n))
@@ -95,7 +121,7 @@ template <uint_t Nd> struct tree {
     HM3_ASSERT(s >= 0_sg and s < sibling_group_capacity(),
                "sg {} is out-of-bounds for parents [{}, {})", s, 0,
                sibling_group_capacity());
-    return parents_[*s];
+    return compact_optional_cast<node_idx>(parents_[*s]);
   }
 
  private:
@@ -109,7 +135,7 @@ template <uint_t Nd> struct tree {
     HM3_ASSERT(s >= 0_sg and s < sibling_group_capacity(),
                "sg {} is out-of-bounds for parents [{}, {})", s, 0,
                sibling_group_capacity());
-    parents_[*s] = value;
+    parents_[*s] = compact_optional_cast<stored_node_idx>(value);
     HM3_ASSERT(parent(s) == value, "");
   }
 
@@ -133,7 +159,7 @@ template <uint_t Nd> struct tree {
     HM3_ASSERT(n >= 0_n and n < capacity(),
                "node {} is out-of-bounds for first_child [{}, {})", n, 0,
                capacity());
-    return first_children_[*n];
+    return compact_optional_cast<node_idx>(first_children_[*n]);
     // cannot assert post-condition because swap temporarily violates it
   }
 
@@ -152,7 +178,7 @@ template <uint_t Nd> struct tree {
     HM3_ASSERT(n >= 0_n and n < capacity(),
                "node {} is out-of-bounds for first_child [{}, {})", n, 0,
                capacity());
-    first_children_[*n] = value;
+    first_children_[*n] = compact_optional_cast<stored_node_idx>(value);
     HM3_ASSERT(child(n, child_pos{0}) == value, "");
   }
 
@@ -389,6 +415,10 @@ template <uint_t Nd> struct tree {
 
     set_parent(s, p);
     set_first_child(p, first_node(s));
+    if (has_hashes()) {
+      for (auto&& c : children(p)) { reset_hash(c); }
+      update_hashes(p);
+    }
 
     HM3_ASSERT(!is_free(s), "node {}: refine produced a free sg {}", *p, *s);
     HM3_ASSERT(all_of(children(p), [&](node_idx i) { return is_leaf(i); }),
@@ -415,6 +445,7 @@ template <uint_t Nd> struct tree {
 
     set_parent(cg, node_idx{});
     set_first_child(p, node_idx{});
+    if (has_hashes()) { update_hashes(p); }
 
     HM3_ASSERT(is_free(cg), "node {}: after coarsen child group {} not free",
                *p, *cg);
@@ -422,7 +453,130 @@ template <uint_t Nd> struct tree {
     HM3_ASSERT(!is_free(p), "node {}: after coarsen is free", *p);
   }
 
+  /// Refines a tree that only contains the root node uniformly up to level
+  /// \p l (i.e. all leaf nodes are at level \p l)
+  ///
+  /// The parent/children edges of the uniform tree are written directly in
+  /// depth-first order (in parallel), without refining the nodes one by one.
+  /// The resulting tree is compact and sorted (see dfs_sort).
+  ///
+  /// Time complexity: O(N / no_threads)
+  ///
+  /// \pre size() == 1
+  /// \pre capacity() >= no_nodes_until_uniform_level(Nd, l)
+  /// \post is_compact() && dfs_sort.is(*this)
+  void refine_uniformly(level_idx l) {
+    HM3_ASSERT(size() == 1_n, "tree with {} nodes is not root-only", size());
+    const node_idx no_nodes{
+     static_cast<idx_t>(no_nodes_until_uniform_level(Nd, l))};
+    HM3_ASSERT(no_nodes <= capacity(),
+               "a uniform tree of level {} requires {} nodes but the tree "
+               "capacity is {}",
+               l, no_nodes, capacity());
+    if (l == 0_l) { return; }
+
+    // Split the tree at the first level containing enough nodes to keep all
+    // threads busy, and write the sub-trees below that level in parallel:
+    level_idx split = 1_l;
+    while (split < l
+           and no_nodes_at_uniform_level(Nd, split)
+                < 8 * parallel::no_threads()) {
+      ++split;
+    }
+    std::vector<std::pair<node_idx, siblings_idx>> sub_trees;
+    write_uniform(0_n, 1_sg, 0_l, l, split, sub_trees);
+    parallel::for_each(0, sub_trees.size(), [&](int_t i) {
+      write_uniform(sub_trees[i].first, sub_trees[i].second, split, l,
+                    level_idx{}, sub_trees);
+    });
+
+    size_                     = no_nodes;
+    first_free_sibling_group_ = sibling_group(size());
+    if (has_hashes()) { compute_hashes(0_n); }
+    HM3_ASSERT(is_compact(), "uniform tree is not compact");
+  }
+
+  /// \name Concurrent refinement
+  ///
+  /// Nodes can be refined concurrently into sibling groups reserved upfront:
+  /// each thread refines its own nodes into its own range of reserved sibling
+  /// groups (see reserve_sibling_groups and refine_into).
+  ///@{
+
+  /// Reserves \p no_sgs contiguous free sibling groups and returns the first
+  /// one
+  ///
+  /// The reserved sibling groups count towards size() but are free until a
+  /// node is refined into them (see refine_into). All of them must be used
+  /// before the tree is modified or traversed.
+  ///
+  /// \pre is_compact()
+  /// \pre size() + no_sgs * no_children() <= capacity()
+  ///
+  /// \warning not thread-safe
+  siblings_idx reserve_sibling_groups(idx_t no_sgs) noexcept {
+    HM3_ASSERT(is_compact(), "sibling groups can only be reserved in a "
+                             "compact tree");
+    HM3_ASSERT(size() + node_idx{no_sgs * no_children()} <= capacity(),
+               "cannot reserve {} sibling groups: tree size {}, capacity {}",
+               no_sgs, size(), capacity());
+    const auto s = first_free_sibling_group_;
+    size_ += node_idx{no_sgs * no_children()};
+    first_free_sibling_group_ = siblings_idx{*s + no_sgs};
+    return s;
+  }
+
+  /// Refines node \p p into the reserved sibling group \p s
+  ///
+  /// Thread-safe as long as each thread refines different nodes into
+  /// different sibling groups. The sub-tree hashes are not updated: if they
+  /// are enabled they must be recomputed afterwards (see enable_hashes).
+  ///
+  /// \pre !is_free(p) && is_leaf(p) && is_free(s) && s has been reserved
+  /// \post !is_free(s) && parent(s) == p
+  void refine_into(node_idx p, siblings_idx s) noexcept {
+    HM3_ASSERT(!is_free(p), "node {}: is free and cannot be refined", *p);
+    HM3_ASSERT(is_leaf(p), "node {}: is not a leaf and cannot be refined", *p);
+    HM3_ASSERT(is_free(s), "node {}: reserved sg {} is not free", *p, *s);
+    HM3_ASSERT(s < first_free_sibling_group_, "sg {} is not reserved", s);
+    set_parent(s, p);
+    set_first_child(p, first_node(s));
+    if (has_payload_hashes()) {
+      for (auto&& c : children(p)) { payload_hashes_[*c] = hash_t{0}; }
+    }
+  }
+
+  ///@}  // Concurrent refinement
+
  private:
+  /// Writes the edges of the sub-tree of the node \p n at level \p l of a
+  /// uniform tree of level \p l_max in depth-first order, starting with its
+  /// children group at \p s
+  ///
+  /// The sub-trees of the nodes at level \p split are not written but
+  /// appended to \p sub_trees instead.
+  void write_uniform(
+   node_idx n, siblings_idx s, level_idx l, level_idx l_max, level_idx split,
+   std::vector<std::pair<node_idx, siblings_idx>>& sub_trees) {
+    if (l == l_max) { return; }
+    if (l == split) {
+      sub_trees.emplace_back(n, s);
+      return;
+    }
+    set_parent(s, n);
+    set_first_child(n, first_node(s));
+    if (l + 1 == l_max) { return; }
+    // number of sibling groups in the sub-tree of each child:
+    const idx_t nc        = no_children();
+    const idx_t child_sgs
+     = (math::ipow(nc, idx_t{*l_max - *l - 1}) - 1) / (nc - 1);
+    for (auto&& p : child_positions()) {
+      write_uniform(node_idx{*first_node(s) + *p},
+                    siblings_idx{*s + 1 + *p * child_sgs}, l + 1, l_max, split,
+                    sub_trees);
+    }
+  }
+
   /// Initializes the tree with a root node
   ///
   /// \pre empty()
@@ -440,8 +594,8 @@ template <uint_t Nd> struct tree {
   /// Is the tree reseted?
   bool is_reseted() {
     return size_ == 0 and first_free_sibling_group_ == 0_sg
-           and all_of(all_parents(), [](node_idx i) { return !i; })
-           and all_of(all_children(), [](node_idx i) { return !i; });
+           and all_of(all_parents(), [](stored_node_idx i) { return !i; })
+           and all_of(all_children(), [](stored_node_idx i) { return !i; });
   }
 
  public:
@@ -469,6 +623,10 @@ template <uint_t Nd> struct tree {
       ranges::swap(first_children_[*l], first_children_[*r]);
       update_cg_parent(l);
       update_cg_parent(r);
+      if (has_hashes()) { ranges::swap(hashes_[*l], hashes_[*r]); }
+      if (has_payload_hashes()) {
+        ranges::swap(payload_hashes_[*l], payload_hashes_[*r]);
+      }
     };
 
     /// 2) swap parent -> sibling edges, and sibling -> parent edges:
@@ -497,6 +655,131 @@ template <uint_t Nd> struct tree {
 
   ///@}  // Memory management
 
+  /// \name Sub-tree hashes
+  ///
+  /// Each node can (optionally) store a Merkle hash of its sub-tree. The hash
+  /// of a node depends on the refinement structure below it and on the
+  /// (optional) payload hashes of the nodes in its sub-tree, but not on where
+  /// the nodes are stored in memory. That is, two trees with the same
+  /// structure have the same root hash independently of their memory layout.
+  ///
+  /// Hashes are updated along the path to the root on refine and coarsen:
+  /// O(log(N)) per modification.
+  ///
+  /// Memory requirements: 1 word per node (+ 1 word per node if payload
+  /// hashes are used).
+  ///
+  ///@{
+
+  using hash_t = std::uint64_t;
+
+  /// Are the sub-tree hashes enabled?
+  bool has_hashes() const noexcept { return static_cast<bool>(hashes_); }
+
+  /// Are the payload hashes enabled?
+  bool has_payload_hashes() const noexcept {
+    return static_cast<bool>(payload_hashes_);
+  }
+
+  /// Hash of the sub-tree of node \p n
+  ///
+  /// \pre has_hashes()
+  hash_t hash(node_idx n) const noexcept {
+    HM3_ASSERT(has_hashes(), "sub-tree hashes are not enabled");
+    HM3_ASSERT(n >= 0_n and n < capacity(),
+               "node {} is out-of-bounds for hashes [{}, {})", n, 0,
+               capacity());
+    return hashes_[*n];
+  }
+
+  /// Hash of the whole tree
+  ///
+  /// \pre has_hashes()
+  hash_t hash() const noexcept { return hash(0_n); }
+
+  /// Payload hash of node \p n (zero if no payload hash has been set)
+  hash_t payload_hash(node_idx n) const noexcept {
+    HM3_ASSERT(n >= 0_n and n < capacity(),
+               "node {} is out-of-bounds for payload hashes [{}, {})", n, 0,
+               capacity());
+    return has_payload_hashes() ? payload_hashes_[*n] : hash_t{0};
+  }
+
+  /// Enables the sub-tree hashes and computes them bottom-up
+  ///
+  /// Time complexity: O(N)
+  void enable_hashes() {
+    if (!has_hashes()) {
+      hashes_ = std::make_unique<hash_t[]>(*capacity());
+    }
+    compute_hashes(0_n);
+  }
+
+  /// Disables the sub-tree hashes (and the payload hashes)
+  void disable_hashes() noexcept {
+    hashes_.reset();
+    payload_hashes_.reset();
+  }
+
+  /// Sets the payload hash of node \p n to \p value
+  ///
+  /// Time complexity: O(log(N)) (the hashes of the path from \p n to the root
+  /// node are updated)
+  ///
+  /// \pre has_hashes()
+  void set_payload_hash(node_idx n, hash_t value) {
+    HM3_ASSERT(has_hashes(), "sub-tree hashes are not enabled");
+    HM3_ASSERT(!is_free(n), "node {} is free", n);
+    if (!has_payload_hashes()) {
+      payload_hashes_ = std::make_unique<hash_t[]>(*capacity());
+    }
+    payload_hashes_[*n] = value;
+    update_hashes(n);
+  }
+
+ private:
+  /// Mixes the bits of \p x (splitmix64 finalizer)
+  static constexpr hash_t mix(hash_t x) noexcept {
+    x = (x ^ (x >> 30)) * hash_t{0xbf58476d1ce4e5b9};
+    x = (x ^ (x >> 27)) * hash_t{0x94d049bb133111eb};
+    return x ^ (x >> 31);
+  }
+
+  /// Combines the hash \p seed with the hash \p value
+  static constexpr hash_t combine(hash_t seed, hash_t value) noexcept {
+    return mix(seed ^ (value + hash_t{0x9e3779b97f4a7c15} + (seed << 6)
+                       + (seed >> 2)));
+  }
+
+  /// Hash of node \p n from its payload and the hashes of its children
+  hash_t node_hash(node_idx n) const noexcept {
+    hash_t h = combine(hash_t{Nd}, payload_hash(n));
+    for (auto&& c : children(n)) { h = combine(h, hashes_[*c]); }
+    return h;
+  }
+
+  /// Sets the hash of the leaf node \p n (and resets its payload hash)
+  void reset_hash(node_idx n) noexcept {
+    if (has_payload_hashes()) { payload_hashes_[*n] = hash_t{0}; }
+    hashes_[*n] = node_hash(n);
+  }
+
+  /// Computes the hashes of the sub-tree of \p n bottom-up
+  void compute_hashes(node_idx n) noexcept {
+    for (auto&& c : children(n)) { compute_hashes(c); }
+    hashes_[*n] = node_hash(n);
+  }
+
+  /// Updates the hashes of the path from node \p n to the root node
+  void update_hashes(node_idx n) noexcept {
+    while (n) {
+      hashes_[*n] = node_hash(n);
+      n = parent(n);
+    }
+  }
+
+  ///@}  // Sub-tree hashes
+
  public:
   tree() = default;
 
@@ -504,10 +787,14 @@ template <uint_t Nd> struct tree {
   /// with a root node
   tree(node_idx node_capacity)
    : sg_capacity_(no_sibling_groups(node_capacity))
-   , parents_(std::make_unique<node_idx[]>(*sibling_group_capacity()))
-   , first_children_(std::make_unique<node_idx[]>(*capacity())) {
+   , parents_(
+      std::make_unique<stored_node_idx[]>(*sibling_group_capacity()))
+   , first_children_(std::make_unique<stored_node_idx[]>(*capacity())) {
     HM3_ASSERT(capacity() > 0_n,
                "cannot construct tree with zero capacity ({})", capacity());
+    HM3_ASSERT(*capacity() < std::numeric_limits<Idx>::max(),
+               "capacity {} is not representable by the index type",
+               capacity());
     HM3_ASSERT(is_reseted(), "tree is not reseted");
     initialize_root_node();
   }
@@ -529,6 +816,16 @@ template <uint_t Nd> struct tree {
       auto o = first_children_.get();
       copy(b, e, o);
     }
+    if (other.has_hashes()) {  // copy hashes_
+      hashes_ = std::make_unique<hash_t[]>(*capacity());
+      auto b  = other.hashes_.get();
+      copy(b, b + *other.capacity(), hashes_.get());
+    }
+    if (other.has_payload_hashes()) {  // copy payload_hashes_
+      payload_hashes_ = std::make_unique<hash_t[]>(*capacity());
+      auto b          = other.payload_hashes_.get();
+      copy(b, b + *other.capacity(), payload_hashes_.get());
+    }
   }
 
   tree& operator=(tree other) {
@@ -541,9 +838,16 @@ template <uint_t Nd> struct tree {
 ///
 /// Two trees are equal if their parent-child graph is the same.
 ///
-template <uint_t Nd>
-bool operator==(tree<Nd> const& a, tree<Nd> const& b) noexcept {
+/// If both trees have sub-tree hashes (and no payload hashes) and their root
+/// hashes differ the trees are not equal: O(1).
+///
+template <uint_t Nd, typename Idx>
+bool operator==(tree<Nd, Idx> const& a, tree<Nd, Idx> const& b) noexcept {
   if (size(a) != size(b)) { return false; }
+  if (a.has_hashes() and b.has_hashes() and !a.has_payload_hashes()
+      and !b.has_payload_hashes() and a.hash() != b.hash()) {
+    return false;
+  }
 
   RANGES_FOR (auto&& np, view::zip(a.nodes(), b.nodes())) {
     auto&& an = get<0>(np);
@@ -554,8 +858,8 @@ bool operator==(tree<Nd> const& a, tree<Nd> const& b) noexcept {
   return true;
 }
 
-template <uint_t Nd>
-bool operator!=(tree<Nd> const& a, tree<Nd> const& b) noexcept {
+template <uint_t Nd, typename Idx>
+bool operator!=(tree<Nd, Idx> const& a, tree<Nd, Idx> const& b) noexcept {
   return !(a == b);
 }
 
@@ -568,10 +872,12 @@ using quad_tree = tree<2>;
 /// Oct-tree
 using oct_tree = tree<3>;
 
-template <uint_t Nd> string type(tree<Nd> const&) { return "tree"; }
+template <uint_t Nd, typename Idx> string type(tree<Nd, Idx> const&) {
+  return "tree";
+}
 
-template <uint_t Nd> string name(tree<Nd> const&) {
-  return type(tree<Nd>{}) + "_" + std::to_string(Nd) + "D";
+template <uint_t Nd, typename Idx> string name(tree<Nd, Idx> const&) {
+  return type(tree<Nd, Idx>{}) + "_" + std::to_string(Nd) + "D";
 }
 
 }  // namespace tree
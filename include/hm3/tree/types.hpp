@@ -10,11 +10,21 @@
 namespace hm3 {
 namespace tree {
 
+struct node_idx_tag;
+
+/// Node index stored using the integer type \p Idx
+///
+/// The interface of the trees always uses node_idx, but they can store node
+/// indices using a narrower integer type (e.g. std::uint32_t for trees with
+/// less than 2^32 - 1 nodes) to reduce their memory footprint and the memory
+/// bandwidth required to traverse them.
+template <typename Idx>
+using node_idx_storage
+ = compact_optional<empty_scalar_value<Idx, std::numeric_limits<Idx>::max()>,
+                    node_idx_tag>;
+
 /// Index of a node within a tree
-using node_idx
- = compact_optional<empty_scalar_value<idx_t,
-                                       std::numeric_limits<idx_t>::max()>,
-                    struct node_idx_tag>;
+using node_idx = node_idx_storage<idx_t>;
 
 constexpr node_idx operator"" _n(unsigned long long int i) {
   return node_idx{static_cast<idx_t>(i)};
@@ -40,8 +50,8 @@ constexpr level_idx operator"" _l(unsigned long long int i) {
   return level_idx{static_cast<suint_t>(i)};
 }
 
-/// nd-tree
-template <uint_t Nd> struct tree;
+/// nd-tree (storing node indices using the integer type Idx)
+template <uint_t Nd, typename Idx = idx_t> struct tree;
 
 /// Child positions
 template <uint_t Nd>
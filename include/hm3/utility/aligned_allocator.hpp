@@ -0,0 +1,57 @@
+#pragma once
+/// \file
+///
+/// Allocator for over-aligned memory
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace hm3 {
+namespace memory {
+
+/// Allocates memory aligned to \p Alignment bytes (e.g. a cache line)
+template <typename T, std::size_t Alignment = 64> struct aligned_allocator {
+  static_assert(Alignment >= alignof(T), "alignment too small for T");
+  static_assert((Alignment & (Alignment - 1)) == 0,
+                "alignment must be a power of two");
+  using value_type = T;
+
+  template <typename U> struct rebind {
+    using other = aligned_allocator<U, Alignment>;
+  };
+
+  aligned_allocator() noexcept = default;
+  template <typename U>
+  aligned_allocator(aligned_allocator<U, Alignment> const&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    void* p = nullptr;
+    if (n == 0) { return nullptr; }
+    if (posix_memalign(&p, Alignment < sizeof(void*) ? sizeof(void*) : Alignment,
+                       n * sizeof(T))
+        != 0) {
+      throw std::bad_alloc{};
+    }
+    return static_cast<T*>(p);
+  }
+  void deallocate(T* p, std::size_t) noexcept { std::free(p); }
+};
+
+template <typename T, typename U, std::size_t A>
+bool operator==(aligned_allocator<T, A> const&,
+                aligned_allocator<U, A> const&) noexcept {
+  return true;
+}
+template <typename T, typename U, std::size_t A>
+bool operator!=(aligned_allocator<T, A> const&,
+                aligned_allocator<U, A> const&) noexcept {
+  return false;
+}
+
+/// Vector whose memory is aligned to \p Alignment bytes
+template <typename T, std::size_t Alignment = 64>
+using aligned_vector = std::vector<T, aligned_allocator<T, Alignment>>;
+
+}  // namespace memory
+}  // namespace hm3
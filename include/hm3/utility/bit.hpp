@@ -184,6 +184,17 @@ constexpr int clz(UInt n) noexcept {
 #endif
 }
 
+/// Number of bits of \p x that are set
+constexpr uint_t popcount(uint64_t x) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(x);
+#else
+  uint_t r = 0;
+  for (; x != 0; x &= x - 1) { ++r; }
+  return r;
+#endif
+}
+
 #ifdef HM3_USE_BMI2
 namespace bmi2_detail {
 
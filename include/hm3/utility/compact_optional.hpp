@@ -11,6 +11,8 @@
 /// License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
 /// http://www.boost.org/LICENSE_1_0.txt)
 
+#include <limits>
+#include <type_traits>
 #include <utility>
 #include <hm3/utility/assert.hpp>
 #include <hm3/utility/range.hpp>
@@ -217,6 +219,60 @@ class compact_optional : public detail::compact_optional_base<N> {
 
 template <typename T> using get_tag_t = typename T::tag;
 
+/// Converts the compact optional \p v into the compact optional type \p To
+///
+/// Empty values are converted into empty values. Useful to convert between
+/// optional indices stored with different widths.
+///
+/// \pre the value of \p v must be representable by To
+template <typename To, typename N, typename Tag>
+constexpr To compact_optional_cast(compact_optional<N, Tag> const& v) noexcept {
+  using to_t = typename To::value_type;
+  HM3_ASSERT(!v || (*v >= std::numeric_limits<to_t>::min()
+                    and *v < std::numeric_limits<to_t>::max()),
+             "value {} is not representable by the target type", *v);
+  return v ? To{static_cast<to_t>(*v)} : To{};
+}
+
+/// Reference to a compact optional of type \p Stored that is accessed as a
+/// compact optional of type \p T (e.g. an index stored with a narrower width
+/// than the one of its interface)
+template <typename T, typename Stored> struct compact_optional_ref {
+  Stored& value_;
+
+  constexpr compact_optional_ref(Stored& v) noexcept : value_(v) {}
+  compact_optional_ref(compact_optional_ref const&) = default;
+
+  constexpr operator T() const noexcept {
+    return compact_optional_cast<T>(value_);
+  }
+  constexpr explicit operator bool() const noexcept {
+    return static_cast<bool>(value_);
+  }
+  constexpr typename T::value_type operator*() const noexcept {
+    return *static_cast<T>(*this);
+  }
+  compact_optional_ref& operator=(T const& v) noexcept {
+    value_ = compact_optional_cast<Stored>(v);
+    return *this;
+  }
+  compact_optional_ref& operator=(compact_optional_ref const& o) noexcept {
+    return (*this) = static_cast<T>(o);
+  }
+
+  friend void swap(compact_optional_ref a, compact_optional_ref b) noexcept {
+    using std::swap;
+    swap(a.value_, b.value_);
+  }
+};
+
+/// Mutable reference to a compact optional of type \p T stored as \p Stored:
+/// T& if both types are the same, compact_optional_ref<T, Stored> otherwise.
+template <typename T, typename Stored>
+using compact_optional_ref_t
+ = std::conditional_t<std::is_same<T, Stored>{}, T&,
+                      compact_optional_ref<T, Stored>>;
+
 }  // namespace hm3
 
 namespace std {
@@ -0,0 +1,58 @@
+#pragma once
+/// \file
+///
+/// Parallel algorithms
+///
+/// These run in parallel using OpenMP if it is enabled (HM3_ENABLE_OPENMP), and
+/// serially otherwise.
+#include <hm3/types.hpp>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace hm3 {
+
+/// Parallel algorithms
+namespace parallel {
+
+/// Number of threads available for parallel algorithms
+inline uint_t no_threads() noexcept {
+#ifdef _OPENMP
+  return static_cast<uint_t>(omp_get_max_threads());
+#else
+  return 1;
+#endif
+}
+
+/// Index of the calling thread within a parallel region
+inline uint_t thread_idx() noexcept {
+#ifdef _OPENMP
+  return static_cast<uint_t>(omp_get_thread_num());
+#else
+  return 0;
+#endif
+}
+
+/// Executes \p f(i) for all i in [\p from, \p to) in parallel
+///
+/// \warning the iterations must be independent of each other
+template <typename F> void for_each(int_t from, int_t to, F&& f) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int_t i = from; i < to; ++i) { f(i); }
+}
+
+/// Executes \p f(i) for all i in [\p from, \p to) in parallel using a static
+/// schedule (one contiguous chunk per thread)
+///
+/// \warning the iterations must be independent of each other
+template <typename F> void for_each_static(int_t from, int_t to, F&& f) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int_t i = from; i < to; ++i) { f(i); }
+}
+
+}  // namespace parallel
+}  // namespace hm3
@@ -0,0 +1,85 @@
+#pragma once
+/// \file
+///
+/// Parallel radix sort
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include <hm3/types.hpp>
+#include <hm3/utility/assert.hpp>
+#include <hm3/utility/parallel.hpp>
+
+namespace hm3 {
+namespace parallel {
+
+/// Sorts the unsigned integer \p keys (and the \p values along with them) in
+/// ascending order of their lowest \p no_bits bits
+///
+/// Least-significant-digit radix sort with 8-bit digits: each pass computes
+/// per-thread digit histograms and scatters the keys in parallel. The sort is
+/// stable. Passes in which all keys have the same digit are skipped.
+///
+/// Time complexity: O(N * no_bits / 8 / no_threads)
+///
+/// Memory requirements: a copy of \p keys and \p values.
+template <typename Key, typename Value>
+void radix_sort(std::vector<Key>& keys, std::vector<Value>& values,
+                uint_t no_bits = 8 * sizeof(Key)) {
+  static_assert(std::is_unsigned<Key>{}, "keys must be unsigned integers");
+  HM3_ASSERT(keys.size() == values.size(), "{} keys but {} values",
+             keys.size(), values.size());
+  HM3_ASSERT(no_bits <= 8 * sizeof(Key), "{} bits exceed the key width",
+             no_bits);
+  constexpr uint_t digit_bits = 8;
+  constexpr idx_t radix       = idx_t{1} << digit_bits;
+
+  const idx_t n = keys.size();
+  if (n < 2) { return; }
+  const idx_t no_blocks = std::min(n, idx_t(no_threads()));
+  auto block_begin      = [&](idx_t b) { return n * b / no_blocks; };
+
+  std::vector<Key> keys_tmp(n);
+  std::vector<Value> values_tmp(n);
+  // digit histogram (and then scatter offsets) of each block:
+  std::vector<idx_t> counts(no_blocks * radix);
+
+  for (uint_t shift = 0; shift < no_bits; shift += digit_bits) {
+    auto digit = [&](Key k) { return idx_t((k >> shift) & Key(radix - 1)); };
+
+    std::fill(begin(counts), end(counts), idx_t{0});
+    parallel::for_each_static(0, no_blocks, [&](int_t b) {
+      idx_t* c = counts.data() + b * radix;
+      for (idx_t i = block_begin(b), e = block_begin(b + 1); i != e; ++i) {
+        ++c[digit(keys[i])];
+      }
+    });
+
+    // exclusive prefix sum in (digit, block) order:
+    idx_t offset = 0;
+    bool sorted  = false;
+    for (idx_t d = 0; d != radix; ++d) {
+      const idx_t first = offset;
+      for (idx_t b = 0; b != no_blocks; ++b) {
+        const idx_t c         = counts[b * radix + d];
+        counts[b * radix + d] = offset;
+        offset += c;
+      }
+      if (offset - first == n) { sorted = true; }
+    }
+    if (sorted) { continue; }  // all keys have the same digit
+
+    parallel::for_each_static(0, no_blocks, [&](int_t b) {
+      idx_t* c = counts.data() + b * radix;
+      for (idx_t i = block_begin(b), e = block_begin(b + 1); i != e; ++i) {
+        const idx_t j = c[digit(keys[i])]++;
+        keys_tmp[j]   = keys[i];
+        values_tmp[j] = values[i];
+      }
+    });
+    keys.swap(keys_tmp);
+    values.swap(values_tmp);
+  }
+}
+
+}  // namespace parallel
+}  // namespace hm3
@@ -0,0 +1,158 @@
+/// \file
+///
+/// Forest of hierarchical Cartesian grids tests
+#include <hm3/grid/hc/forest.hpp>
+#include <hm3/grid/hc/serialization/forest_fio.hpp>
+#include <hm3/grid/adaptor/multi.hpp>
+#include <hm3/grid/serialization/fio.hpp>
+#include <hm3/tree/algorithm/dfs_sort.hpp>
+#include <hm3/utility/test.hpp>
+
+using namespace hm3;
+using grid::tree_node_idx;
+using grid::grid_node_idx;
+using grid::operator"" _g;
+using tree::operator"" _n;
+using tree::operator"" _l;
+
+/// Explicit instantiate it
+template struct hm3::grid::hc::forest<3>;
+
+using forest_t = grid::hc::forest<3>;
+using point_t  = geometry::point<3>;
+
+/// Number of nodes of \p g outside of the brick
+template <typename Forest> idx_t no_nodes_outside(Forest const& g) {
+  idx_t r = 0;
+  RANGES_FOR (auto&& n, g.nodes()) {
+    if (!g.in_domain(n)) { ++r; }
+  }
+  return r;
+}
+
+/// Does the neighbor set \p ns contain node \p n?
+template <typename Neighbors>
+bool contains(Neighbors const& ns, tree_node_idx n) {
+  return any_of(ns, [&](tree_node_idx i) { return i == n; });
+}
+
+int main() {
+  // channel with aspect ratio 8:1:1
+  forest_t g(1000, point_t::constant(0.), 1., {{8, 1, 1}});
+
+  CHECK(g.no_total_roots() == 8_u);
+  CHECK(g.root_level() == 3_l);
+  CHECK(g.root_length() == 1.);
+  CHECK(g.x_max() == point_t{8., 1., 1.});
+  // 7 nodes above the roots are refined:
+  CHECK(g.size() == tree_node_idx{1 + 7 * 8});
+  CHECK(no_nodes_outside(g) == 49);
+  CHECK(distance(g.roots()) == 8);
+
+  {  // root connectivity
+    for (uint_t i = 0; i != 8; ++i) {
+      auto r = g.root_at({{i, 0, 0}});
+      CHECK(r);
+      CHECK(g.is_tree_root(r));
+      CHECK(g.root(r) == r);
+      CHECK((g.root_coordinates(r) == forest_t::root_coordinates_t{{i, 0, 0}}));
+      CHECK(g.coordinates(r) == point_t{i + .5, .5, .5});
+      CHECK(g.length(r) == 1.);
+    }
+    CHECK(!g.root_at({{0, 1, 0}}));
+    CHECK(!g.root_at({{8, 0, 0}}));
+
+    auto r3 = g.root_at({{3, 0, 0}});
+    CHECK(g.root_neighbor(r3, {{1, 0, 0}}) == g.root_at({{4, 0, 0}}));
+    CHECK(g.root_neighbor(r3, {{-1, 0, 0}}) == g.root_at({{2, 0, 0}}));
+    CHECK(!g.root_neighbor(r3, {{0, 1, 0}}));
+    CHECK(!g.root_neighbor(g.root_at({{0, 0, 0}}), {{-1, 0, 0}}));
+    CHECK(!g.root_neighbor(g.root_at({{7, 0, 0}}), {{1, 0, 0}}));
+
+    // neighbor queries only return nodes inside the brick:
+    auto ns = g.neighbors(r3);
+    CHECK(ns.size() == 2_u);
+    CHECK(contains(ns, g.root_at({{2, 0, 0}})));
+    CHECK(contains(ns, g.root_at({{4, 0, 0}})));
+  }
+
+  {  // nodes outside the brick are never refined
+    auto r0 = g.root_at({{0, 0, 0}});
+    auto o  = g.child(g.parent(r0), forest_t::child_pos{2});
+    CHECK(!g.in_domain(o));
+    CHECK(!g.is_tree_root(o));
+    CHECK(!g.refine(o));
+    CHECK(!g.in_domain(0_n));
+    auto size = g.size();
+    g.coarsen(0_n);
+    CHECK(g.size() == size);
+  }
+
+  {  // neighbor queries cross the boundaries between roots
+    std::vector<tree_node_idx> roots;
+    RANGES_FOR (auto&& r, g.roots()) { roots.push_back(r); }
+    for (auto&& r : roots) { g.refine(r); }
+    CHECK(no_nodes_outside(g) == 49);
+    auto r3 = g.root_at({{3, 0, 0}});
+    auto r4 = g.root_at({{4, 0, 0}});
+    auto c3 = g.child(r3, forest_t::child_pos{1});  // +x child of r3
+    auto c4 = g.child(r4, forest_t::child_pos{0});  // -x child of r4
+    CHECK(contains(g.neighbors(c3), c4));
+    CHECK(contains(g.neighbors(c4), c3));
+    CHECK(g.root(c3) == r3);
+    CHECK(g.root(c4) == r4);
+    // y-neighbors of c3 lie outside the brick:
+    CHECK(g.neighbors(c3).size() == 11_u);
+  }
+
+  {  // depth-first sort orders the roots along the Morton curve
+    tree::dfs_sort(g);
+    CHECK(tree::dfs_sort.is(g));
+    uint_t i = 0;
+    RANGES_FOR (auto&& r, g.roots()) {
+      CHECK(g.root_coordinates(r)[0] == i);
+      ++i;
+    }
+    CHECK(i == 8_u);
+  }
+
+  {  // file i/o
+    auto file_name = "forest_io";
+    auto comm      = mpi::comm::world();
+    io::session::remove(file_name, comm);
+    grid::to_file(g, file_name);
+    auto h = grid::from_file(forest_t{}, file_name);
+    CHECK(h == g);
+    CHECK(h.no_roots() == g.no_roots());
+  }
+
+  {  // as a multi grid
+    grid::adaptor::multi<forest_t> m(1000, 1, point_t::constant(0.), 1.,
+                                     forest_t::root_coordinates_t{{8, 1, 1}});
+    grid_node_idx c = 0;
+    RANGES_FOR (auto&& r, m.roots()) { m.node(r, 0_g) = c++; }
+    CHECK(distance(m.nodes(0_g)) == 8);
+
+    auto r3 = m.root_at({{3, 0, 0}});
+    auto r4 = m.root_at({{4, 0, 0}});
+    CHECK(contains(m.neighbors(r3, 0_g), r4));
+
+    // balanced refinement never refines nodes outside of the brick:
+    auto cs = m.refine(r3);
+    m.refine(*(begin(cs) + 3));  // +x+y child of r3 (touches the outside)
+    CHECK(!m.is_leaf(r4));
+    CHECK(no_nodes_outside(m) == 49);
+
+    // removing roots from the grid never coarsens the nodes above the roots
+    auto r0   = m.root_at({{0, 0, 0}});
+    auto r1   = m.root_at({{1, 0, 0}});
+    auto size = m.size();
+    m.remove(r1, 0_g);
+    m.remove(r0, 0_g);
+    CHECK(m.size() == size);
+    CHECK(m.is_tree_root(r0));
+    CHECK(m.is_tree_root(r1));
+  }
+
+  return test::result();
+}
@@ -0,0 +1,86 @@
+/// \file
+///
+/// Hierarchical Cartesian grid geometry cache tests
+#include <hm3/grid/hc/single.hpp>
+#include <hm3/tree/algorithm/dfs_sort.hpp>
+#include <hm3/utility/test.hpp>
+
+using namespace hm3;
+using grid::tree_node_idx;
+using tree::operator"" _n;
+using tree::operator"" _l;
+
+using grid_t = grid::hc::single<3>;
+
+/// Checks that the cached geometry of \p g matches the uncached geometry of
+/// \p ref
+void check_cache(grid_t const& g, grid_t const& ref) {
+  CHECK(g.has_geometry_cache());
+  CHECK(!ref.has_geometry_cache());
+  CHECK(g.size() == ref.size());
+  RANGES_FOR (auto&& n, g.nodes()) {
+    CHECK(g.level(n) == ref.level(n));
+    CHECK(g.length(n) == ref.length(n));
+    CHECK(g.coordinates(n) == ref.coordinates(n));
+    CHECK(g.node(n) == ref.node(n));
+    for (auto&& d : g.dimensions()) {
+      CHECK(g.cached_centers(d)[*n] == ref.coordinates(n)(d));
+    }
+    CHECK(g.cached_levels()[*n] == *ref.level(n));
+  }
+}
+
+int main() {
+  // both grids share the same refinement, only g caches its geometry:
+  grid_t g(tree_node_idx{2000},
+           geometry::square<3>{geometry::point<3>::constant(2.), 4.});
+  g.refine(0_n);
+  g.refine(3_n);
+  g.enable_geometry_cache();
+
+  grid_t ref(g);
+  ref.disable_geometry_cache();
+  check_cache(g, ref);
+
+  auto refine = [&](tree_node_idx n) {
+    g.refine(n);
+    ref.refine(n);
+  };
+  auto coarsen = [&](tree_node_idx n) {
+    g.coarsen(n);
+    ref.coarsen(n);
+  };
+
+  // refine
+  refine(5_n);
+  refine(12_n);
+  refine(17_n);
+  check_cache(g, ref);
+
+  // coarsen and refine again (reusing the free sibling group)
+  coarsen(12_n);
+  check_cache(g, ref);
+  refine(2_n);
+  check_cache(g, ref);
+
+  // sort
+  tree::dfs_sort(g);
+  tree::dfs_sort(ref);
+  CHECK(tree::dfs_sort.is(g));
+  check_cache(g, ref);
+
+  // copies keep the cache
+  grid_t h(g);
+  CHECK(h.has_geometry_cache());
+  check_cache(h, ref);
+
+  // direct uniform construction fills the cache
+  grid_t u(tree_node_idx{600}, geometry::square<3>::unit());
+  u.enable_geometry_cache();
+  u.refine_uniformly(3_l);
+  grid_t uref(u);
+  uref.disable_geometry_cache();
+  check_cache(u, uref);
+
+  return test::result();
+}
@@ -0,0 +1,137 @@
+/// \file
+///
+/// Multi hierarchical Cartesian grid interface tests
+#include <algorithm>
+#include <tuple>
+#include <hm3/grid/adaptor/interface.hpp>
+#include <hm3/grid/adaptor/multi.hpp>
+#include <hm3/grid/generation/uniform.hpp>
+#include <hm3/grid/hc/single.hpp>
+#include <hm3/tree/algorithm/normalized_coordinates.hpp>
+#include <hm3/utility/test.hpp>
+
+using namespace hm3;
+using grid::tree_node_idx;
+using grid::grid_node_idx;
+using grid::grid_idx;
+using grid::operator"" _g;
+using tree::operator"" _n;
+
+using multi_t     = grid::adaptor::multi<grid::hc::single<2>>;
+using interface_t = grid::adaptor::interface<multi_t>;
+using pair_t      = std::tuple<tree_node_idx, tree_node_idx, grid_node_idx,
+                          grid_node_idx, uint_t>;
+
+/// Sorted pairs of \p ps
+std::vector<pair_t> sorted(grid::adaptor::node_pairs const& ps) {
+  std::vector<pair_t> r;
+  for (idx_t i = 0; i != ps.size(); ++i) {
+    r.emplace_back(ps.tree_nodes_a[i], ps.tree_nodes_b[i], ps.grid_nodes_a[i],
+                   ps.grid_nodes_b[i], ps.manifolds[i]);
+  }
+  std::sort(begin(r), end(r));
+  return r;
+}
+
+/// Adjacent pairs of the grids \p a and \p b found with multi::neighbors
+std::vector<pair_t> brute_force(multi_t const& m, grid_idx a, grid_idx b) {
+  std::vector<pair_t> r;
+  RANGES_FOR (auto&& n, m.nodes(a)) {
+    std::vector<tree_node_idx> found;
+    auto push = [&](auto&& ns, uint_t manifold) {
+      for (auto&& i : ns) {
+        if (std::find(begin(found), end(found), i) != end(found)) { continue; }
+        found.push_back(i);
+        r.emplace_back(n, i, m.node(n, a), m.node(i, b), manifold);
+      }
+    };
+    push(m.neighbors(n, b, tree::manifold_neighbors<2, 1>{}), 1);
+    push(m.neighbors(n, b, tree::manifold_neighbors<2, 2>{}), 2);
+  }
+  std::sort(begin(r), end(r));
+  return r;
+}
+
+/// Number of pairs across \p manifold
+idx_t count(grid::adaptor::node_pairs const& ps, uint_t manifold) {
+  return std::count(begin(ps.manifolds), end(ps.manifolds), manifold);
+}
+
+/// Leaf node containing the point (\p x, \p y)
+tree_node_idx leaf(multi_t const& m, num_t x, num_t y) {
+  tree_node_idx n = 0_n;
+  while (!m.is_leaf(n)) {
+    const auto x_n = tree::normalized_coordinates(m, n);
+    const uint_t p = (x > x_n(0) ? 1 : 0) + (y > x_n(1) ? 2 : 0);
+    n              = m.child(n, multi_t::child_pos{p});
+  }
+  return n;
+}
+
+/// The interface updated incrementally equals the interface rebuilt
+void check_update(multi_t const& m, interface_t& i,
+                  std::vector<tree_node_idx> const& dirty) {
+  i.update(m, dirty);
+  interface_t r(m, i.a, i.b);
+  CHECK(sorted(i.adjacent) == sorted(r.adjacent));
+  CHECK(sorted(i.overlapping) == sorted(r.overlapping));
+  CHECK(sorted(i.adjacent) == brute_force(m, i.a, i.b));
+}
+
+int main() {
+  multi_t m(tree_node_idx{400}, grid_idx{2}, geometry::square<2>::unit());
+  grid::generation::uniform(m, 3);
+  m.sort();
+
+  // grid 0: leafs with x < 0.5, grid 1: leafs with x > 0.5
+  idx_t c0 = 0, c1 = 0;
+  RANGES_FOR (auto&& n, m.nodes() | m.leaf()) {
+    if (tree::normalized_coordinates(m, n)(0) < 0.5) {
+      m.node(n, 0_g) = grid_node_idx{c0++};
+    } else {
+      m.node(n, 1_g) = grid_node_idx{c1++};
+    }
+  }
+
+  interface_t i(m, 0_g, 1_g);
+  CHECK(i.adjacent.size() == 22);
+  CHECK(count(i.adjacent, 1) == 8);
+  CHECK(count(i.adjacent, 2) == 14);
+  CHECK(i.overlapping.empty());
+  CHECK(sorted(i.adjacent) == brute_force(m, 0_g, 1_g));
+  for (idx_t j = 0; j != i.adjacent.size(); ++j) {
+    CHECK(tree::normalized_coordinates(m, i.adjacent.tree_nodes_a[j])(0)
+          < tree::normalized_coordinates(m, i.adjacent.tree_nodes_b[j])(0));
+  }
+
+  // overlapping nodes: a node in both grids, and a coarse node of grid 1
+  // covering four nodes of grid 0
+  const auto both = leaf(m, 0.4, 0.9);
+  m.node(both, 1_g) = grid_node_idx{c1++};
+  const auto coarse = m.parent(leaf(m, 0.1, 0.1));
+  m.node(coarse, 1_g) = grid_node_idx{c1++};
+  check_update(m, i, {both, coarse});
+  CHECK(i.overlapping.size() == 5);
+  CHECK(count(i.overlapping, 0) == 5);
+
+  // refining a node of grid 1 at the interface:
+  const auto n         = leaf(m, 0.6, 0.55);
+  const idx_t no_faces = count(i.adjacent, 1);
+  std::vector<tree_node_idx> dirty{n};
+  for (auto&& ch : m.refine(n)) {
+    m.node(ch, 1_g) = grid_node_idx{c1++};
+    dirty.push_back(ch);
+  }
+  m.node(n, 1_g) = grid_node_idx{};
+  check_update(m, i, dirty);
+  CHECK(count(i.adjacent, 1) == no_faces + 1);
+
+  // coarsening it again:
+  for (auto&& ch : m.children(n)) { m.node(ch, 1_g) = grid_node_idx{}; }
+  m.node(n, 1_g) = grid_node_idx{c1++};
+  m.coarsen(n);
+  check_update(m, i, dirty);
+  CHECK(count(i.adjacent, 1) == no_faces);
+
+  return test::result();
+}
@@ -0,0 +1,154 @@
+/// \file
+///
+/// Multi hierarchical Cartesian grid with sparse grid membership tests
+#include <hm3/grid/hc/single.hpp>
+#include <hm3/grid/hc/serialization/single_fio.hpp>
+#include <hm3/grid/adaptor/multi.hpp>
+#include <hm3/grid/adaptor/serialization/multi_fio.hpp>
+#include <hm3/utility/test.hpp>
+
+using namespace hm3;
+using grid::tree_node_idx;
+using grid::grid_node_idx;
+using grid::grid_idx;
+using grid::operator"" _g;
+using tree::operator"" _n;
+
+using single_t = grid::hc::single<2>;
+using sparse_t = grid::adaptor::sparse_membership<idx_t>;
+using dense_t  = grid::adaptor::dense_membership<idx_t>;
+template <typename Membership>
+using multi_t = grid::adaptor::multi<single_t, Membership>;
+
+/// Multi grid with 5 grids: node n belongs to grid g if n % (g + 2) == 0
+template <typename Membership> multi_t<Membership> make_multi() {
+  multi_t<Membership> m(tree_node_idx{100}, grid_idx{5},
+                        geometry::square<2>::unit());
+  m.refine(0_n);
+  for (auto&& n : m.children(0_n)) { m.refine(n); }
+  for (auto&& g : m.grids()) {
+    idx_t c = 0;
+    RANGES_FOR (auto&& n, m.nodes()) {
+      if (*n % (*g + 2) == 0) { m.node(n, g) = grid_node_idx{c++}; }
+    }
+  }
+  return m;
+}
+
+/// Do the multi grids \p a and \p b contain the same grid nodes?
+template <typename A, typename B> bool same_grid_nodes(A const& a, B const& b) {
+  if (a.size() != b.size() or a.no_grids() != b.no_grids()) { return false; }
+  for (auto&& g : a.grids()) {
+    RANGES_FOR (auto&& n, a.nodes()) {
+      if (a.node(n, g) != b.node(n, g)) { return false; }
+      if (a.in_grid(n, g) != b.in_grid(n, g)) { return false; }
+    }
+  }
+  return true;
+}
+
+int main() {
+  {  // insertion and removal in all orders
+    sparse_t m(tree_node_idx{2}, grid_idx{64});
+    sparse_t const& cm = m;
+    const std::vector<idx_t> gs{5, 0, 63, 7, 6, 1, 32, 2, 9, 3, 4};
+    idx_t c = 0;
+    for (auto&& g : gs) {
+      m(1_n, grid_idx{g}) = grid_node_idx{100 + g};
+      ++c;
+      for (idx_t i = 0; i != c; ++i) {
+        CHECK(cm(1_n, grid_idx{gs[i]}) == grid_node_idx{100 + gs[i]});
+      }
+    }
+    CHECK(bit::popcount(m.mask(1_n)) == gs.size());
+    CHECK(m.empty(0_n));
+    CHECK(!m.contains(1_n, grid_idx{8}));
+    CHECK(!cm(1_n, grid_idx{8}));
+
+    m(1_n, grid_idx{7}) = grid_node_idx{3};  // overwrite
+    CHECK(cm(1_n, grid_idx{7}) == grid_node_idx{3});
+    m(1_n, grid_idx{7}) = grid_node_idx{107};
+
+    for (auto&& g : gs) {
+      m(1_n, grid_idx{g}) = grid_node_idx{};
+      --c;
+      CHECK(!m.contains(1_n, grid_idx{g}));
+      for (idx_t i = gs.size() - c; i != idx_t(gs.size()); ++i) {
+        CHECK(cm(1_n, grid_idx{gs[i]}) == grid_node_idx{100 + gs[i]});
+      }
+    }
+    CHECK(m.empty(1_n));
+
+    m.swap(0_n, 1_n);
+    m(0_n, 3_g) = grid_node_idx{1};
+    m.swap(0_n, 1_n);
+    CHECK(cm(1_n, 3_g) == grid_node_idx{1});
+    CHECK(m.empty(0_n));
+  }
+
+  {  // sparse and dense layouts behave the same
+    auto s = make_multi<sparse_t>();
+    auto d = make_multi<dense_t>();
+    CHECK(same_grid_nodes(s, d));
+    CHECK(distance(s.nodes(0_g)) == distance(d.nodes(0_g)));
+    CHECK(distance(s.grid_nodes(4_g)) == distance(d.grid_nodes(4_g)));
+
+    // removing grid nodes coarsens the tree identically
+    std::vector<tree_node_idx> children;
+    for (auto&& n : d.children(1_n)) { children.push_back(n); }
+    for (auto&& n : children) {
+      for (auto&& g : d.grids()) {
+        if (d.in_grid(n, g)) {
+          d.remove(n, g);
+          s.remove(n, g);
+        }
+      }
+    }
+    CHECK(d.is_leaf(1_n));
+    CHECK(s.is_leaf(1_n));
+    CHECK(same_grid_nodes(s, d));
+
+    s.sort();
+    d.sort();
+    CHECK(tree::dfs_sort.is(s));
+    CHECK(same_grid_nodes(s, d));
+
+    // the sparse layout only stores the indices of the grid nodes
+    auto memory = [](auto const& m) {
+      for (auto&& e : m.stats().memory) {
+        if (e.name == "grids") { return e.used; }
+      }
+      return uint_t{0};
+    };
+    CHECK(memory(s) < memory(d));
+  }
+
+  {  // file i/o: both layouts share the same file format
+    auto s = make_multi<sparse_t>();
+    s.sort();
+    auto file_name = "multi_sparse_io";
+    auto comm      = mpi::comm::world();
+    io::session::remove(file_name, comm);
+    {
+      io::session ss(io::create, file_name, comm);
+      io::client c(ss, name(s), type(s));
+      auto f = c.new_file();
+      to_file_unwritten(f, s);
+      c.write(f);
+    }
+    io::session ss(io::restart, file_name, comm);
+    io::client c(ss, name(s), type(s));
+    {
+      auto f = c.get_file();
+      auto h = from_file(multi_t<sparse_t>{}, f);
+      CHECK(same_grid_nodes(h, s));
+    }
+    {
+      auto f = c.get_file();
+      auto h = from_file(multi_t<dense_t>{}, f);
+      CHECK(same_grid_nodes(h, s));
+    }
+  }
+
+  return test::result();
+}
@@ -0,0 +1,129 @@
+/// \file
+///
+/// Multi hierarchical Cartesian grid node lists tests
+#include <algorithm>
+#include <vector>
+#include <hm3/grid/hc/single.hpp>
+#include <hm3/grid/adaptor/multi.hpp>
+#include <hm3/utility/test.hpp>
+
+using namespace hm3;
+using grid::tree_node_idx;
+using grid::grid_node_idx;
+using grid::grid_idx;
+using grid::operator"" _g;
+using tree::operator"" _n;
+
+using single_t = grid::hc::single<2>;
+
+/// Nodes of grid \p g found by scanning the whole tree
+template <typename Multi>
+std::vector<tree_node_idx> scan(Multi const& m, grid_idx g) {
+  std::vector<tree_node_idx> r;
+  RANGES_FOR (auto&& n, m.nodes()) {
+    if (m.in_grid(n, g)) { r.push_back(n); }
+  }
+  return r;
+}
+
+/// Nodes of grid \p g
+template <typename Multi>
+std::vector<tree_node_idx> nodes(Multi const& m, grid_idx g) {
+  std::vector<tree_node_idx> r;
+  RANGES_FOR (auto&& n, m.nodes(g)) { r.push_back(n); }
+  return r;
+}
+
+template <typename Membership> void test_node_lists() {
+  grid::adaptor::multi<single_t, Membership> m(tree_node_idx{200}, grid_idx{3},
+                                               geometry::square<2>::unit());
+  CHECK(m.has_node_list(0_g));
+  CHECK(m.node_list(0_g).empty());
+
+  m.refine(0_n);
+  for (auto&& n : m.children(0_n)) { m.refine(n); }
+  m.sort();
+
+  // pushing the nodes in memory order keeps the lists up-to-date:
+  idx_t c = 0;
+  RANGES_FOR (auto&& n, m.nodes() | m.leaf()) {
+    m.node(n, 0_g) = grid_node_idx{c++};
+    if (*n % 2 == 0) { m.node(n, 1_g) = grid_node_idx{*n}; }
+  }
+  CHECK(m.has_node_list(0_g));
+  CHECK(m.has_node_list(1_g));
+  CHECK(m.has_node_list(2_g));
+  CHECK(m.node_list(0_g).size() == 16_u);
+  CHECK(m.node_list(1_g).size() == 8_u);
+  CHECK(nodes(m, 0_g) == scan(m, 0_g));
+  CHECK(nodes(m, 1_g) == scan(m, 1_g));
+  CHECK(nodes(m, 2_g).empty());
+
+  // overwriting an index does not change the lists:
+  m.node(m.node_list(0_g).back(), 0_g) = grid_node_idx{100};
+  CHECK(m.has_node_list(0_g));
+
+  // removing nodes records a pending change that update_node_lists merges:
+  const tree_node_idx r{m.node_list(1_g).front()};
+  m.node(r, 1_g) = grid_node_idx{};
+  CHECK(!m.has_node_list(1_g));
+  CHECK(m.has_node_list(0_g));
+  CHECK(nodes(m, 1_g) == scan(m, 1_g));
+  CHECK(nodes(m, 1_g).size() == 7_u);
+  m.update_node_lists();
+  CHECK(m.has_node_list(1_g));
+  CHECK(nodes(m, 1_g) == scan(m, 1_g));
+
+  // adding nodes out of memory order is sorted by update_node_lists:
+  m.node(r, 1_g) = grid_node_idx{*r};
+  CHECK(!m.has_node_list(1_g));
+  CHECK(nodes(m, 1_g) == scan(m, 1_g));
+  m.update_node_lists();
+  CHECK(m.has_node_list(1_g));
+  CHECK(nodes(m, 1_g) == scan(m, 1_g));
+  CHECK(std::is_sorted(begin(m.node_list(1_g)), end(m.node_list(1_g))));
+
+  // removing and adding back a node before merging keeps it once:
+  m.node(r, 1_g) = grid_node_idx{};
+  m.node(r, 1_g) = grid_node_idx{*r};
+  m.update_node_lists();
+  CHECK(nodes(m, 1_g) == scan(m, 1_g));
+  CHECK(nodes(m, 1_g).size() == 8_u);
+
+  // removing a range of nodes only modifies the list of its grid:
+  m.remove(std::vector<tree_node_idx>{r, tree_node_idx{m.node_list(1_g)[2]}},
+           1_g);
+  CHECK(m.has_node_list(0_g));
+  CHECK(m.has_node_list(1_g));
+  CHECK(nodes(m, 1_g) == scan(m, 1_g));
+  CHECK(nodes(m, 1_g).size() == 6_u);
+
+  // invalidated lists are rebuilt by update_node_lists:
+  m.invalidate_node_lists();
+  CHECK(!m.has_node_list(1_g));
+  CHECK(nodes(m, 1_g) == scan(m, 1_g));
+  m.update_node_lists();
+  CHECK(m.has_node_list(1_g));
+  CHECK(nodes(m, 1_g) == scan(m, 1_g));
+
+  // refining adds new nodes and sorting rebuilds the lists in dfs order:
+  const tree_node_idx l{m.node_list(0_g).front()};
+  for (auto&& n : m.refine(l)) { m.node(n, 2_g) = grid_node_idx{*n}; }
+  m.sort();
+  for (auto&& g : m.grids()) {
+    CHECK(m.has_node_list(g));
+    CHECK(nodes(m, g) == scan(m, g));
+  }
+  CHECK(m.node_list(2_g).size() == 4_u);
+  CHECK(std::is_sorted(begin(m.node_list(0_g)), end(m.node_list(0_g))));
+
+  // the memory of the lists is reported:
+  CHECK(any_of(m.stats().memory,
+               [](auto&& e) { return e.name == "node_lists" and e.used > 0; }));
+}
+
+int main() {
+  test_node_lists<grid::adaptor::dense_membership<idx_t>>();
+  test_node_lists<grid::adaptor::sparse_membership<idx_t>>();
+  return test::result();
+}
@@ -0,0 +1,109 @@
+/// \file
+///
+/// Periodic hierarchical Cartesian grid tests
+#include <hm3/grid/hc/single.hpp>
+#include <hm3/grid/hc/serialization/single_fio.hpp>
+#include <hm3/grid/serialization/fio.hpp>
+#include <hm3/tree/algorithm/balanced_coarsen.hpp>
+#include <hm3/tree/algorithm/balanced_refine.hpp>
+#include <hm3/tree/algorithm/dfs_sort.hpp>
+#include <hm3/tree/algorithm/node_at.hpp>
+#include <hm3/utility/test.hpp>
+
+using namespace hm3;
+using grid::tree_node_idx;
+using tree::operator"" _n;
+
+using grid_t = grid::hc::single<2>;
+
+/// Grid uniformly refined up to level 2 (periodic along \p periodicity)
+grid_t uniform_grid(grid_t::periodicity_t periodicity) {
+  grid_t g(tree_node_idx{200}, geometry::square<2>::unit(), periodicity);
+  g.refine(0_n);
+  for (auto&& n : g.children(0_n)) { g.refine(n); }
+  return g;
+}
+
+/// Node at level \p l containing the point \p x
+tree_node_idx node_at(grid_t const& g, num_t x, num_t y, uint_t l) {
+  return tree::node_at(g, tree::loc_t<2>(std::array<num_t, 2>{{x, y}},
+                                         tree::level_idx{l}));
+}
+
+/// Does the neighbor set \p ns contain node \p n?
+template <typename Neighbors>
+bool contains(Neighbors const& ns, tree_node_idx n) {
+  return any_of(ns, [&](tree_node_idx i) { return i == n; });
+}
+
+int main() {
+  {  // periodic along x, not along y
+    auto g = uniform_grid({{true, false}});
+    CHECK(g.is_periodic(0));
+    CHECK(!g.is_periodic(1));
+
+    // interior along y: wraps across faces and corners
+    auto a  = node_at(g, .125, .375, 2);
+    auto ns = g.neighbors(a);
+    CHECK(ns.size() == 8_u);
+    CHECK(contains(ns, node_at(g, .875, .375, 2)));  // face
+    CHECK(contains(ns, node_at(g, .875, .125, 2)));  // corner
+    CHECK(contains(ns, node_at(g, .875, .625, 2)));  // corner
+    CHECK(contains(g.neighbors(node_at(g, .875, .375, 2)), a));
+
+    // at the non-periodic y boundary
+    auto b = node_at(g, .125, .125, 2);
+    CHECK(g.neighbors(b).size() == 5_u);
+    CHECK(contains(g.neighbors(b), node_at(g, .875, .125, 2)));
+    CHECK(contains(g.neighbors(b), node_at(g, .875, .375, 2)));
+
+    // the same grid without periodicity
+    auto h = uniform_grid({{false, false}});
+    CHECK(h.neighbors(node_at(h, .125, .375, 2)).size() == 5_u);
+    CHECK(g != h);
+  }
+
+  {  // fully periodic: every node has all neighbors
+    auto g = uniform_grid({{true, true}});
+    RANGES_FOR (auto&& n, g.nodes() | g.leaf()) {
+      CHECK(g.neighbors(n).size() == 8_u);
+    }
+    // corner wraps around both axes
+    CHECK(contains(g.neighbors(node_at(g, .125, .125, 2)),
+                   node_at(g, .875, .875, 2)));
+  }
+
+  {  // 2:1 balance across the periodic boundary
+    auto g = uniform_grid({{true, false}});
+    auto a = node_at(g, .125, .375, 2);
+    auto w = node_at(g, .875, .375, 2);  // periodic neighbor of a
+    tree::balanced_refine(g, a);
+    // child of a at the periodic boundary:
+    auto c = node_at(g, .0625, .3125, 3);
+    CHECK(g.parent(c) == a);
+    tree::balanced_refine(g, c);
+    CHECK(!g.is_leaf(w));
+
+    // w cannot be coarsened while c is refined
+    tree::balanced_coarsen(g, w);
+    CHECK(!g.is_leaf(w));
+    tree::balanced_coarsen(g, c);
+    CHECK(g.is_leaf(c));
+    tree::balanced_coarsen(g, w);
+    CHECK(g.is_leaf(w));
+  }
+
+  {  // file i/o
+    auto g = uniform_grid({{true, false}});
+    tree::dfs_sort(g);
+    auto file_name = "periodic_io";
+    auto comm      = mpi::comm::world();
+    io::session::remove(file_name, comm);
+    grid::to_file(g, file_name);
+    auto h = grid::from_file(grid_t{}, file_name);
+    CHECK(h == g);
+    CHECK(h.periodicity() == g.periodicity());
+  }
+
+  return test::result();
+}
@@ -0,0 +1,110 @@
+/// \file
+///
+/// Bottom-up tree construction from point clouds tests
+#include <random>
+#include <hm3/grid/generation/point_cloud.hpp>
+#include <hm3/tree/algorithm/node_level.hpp>
+#include <hm3/tree/algorithm/node_neighbors.hpp>
+#include <hm3/tree/algorithm/normalized_coordinates.hpp>
+#include <hm3/utility/test.hpp>
+
+using namespace hm3;
+using tree::node_idx;
+
+using point_t = geometry::point<2>;
+using tree_t  = tree::tree<2>;
+
+/// Serially refines node \p n (of center \p x and length \p h) until it
+/// contains at most \p k points
+void refine(tree_t& t, node_idx n, point_t x, num_t h,
+            std::vector<point_t> const& ps, uint_t k) {
+  if (ps.size() <= k) { return; }
+  t.refine(n);
+  for (auto&& p : tree_t::child_positions()) {
+    const auto rcp = tree::relative_child_position<2>(p);
+    point_t x_c    = x;
+    for (auto&& d : dimensions(2)) { x_c(d) += rcp[d] * h / 4.; }
+    std::vector<point_t> ps_c;
+    for (auto&& y : ps) {
+      bool inside = true;
+      for (auto&& d : dimensions(2)) {
+        inside = inside and ((y(d) > x(d)) == (rcp[d] > 0));
+      }
+      if (inside) { ps_c.push_back(y); }
+    }
+    refine(t, t.child(n, p), x_c, h / 2., ps_c, k);
+  }
+}
+
+int main() {
+  // clustered points:
+  std::mt19937 gen(7);
+  std::normal_distribution<num_t> cluster(0.3, 0.05);
+  std::uniform_real_distribution<num_t> uniform(0.001, 0.999);
+  std::vector<point_t> points;
+  for (int i = 0; i != 20000; ++i) {
+    point_t x;
+    for (auto&& d : dimensions(2)) {
+      x(d) = i % 4 == 0 ? uniform(gen) : cluster(gen);
+      x(d) = std::min(std::max(x(d), 0.001), 0.999);
+    }
+    points.push_back(x);
+  }
+  const uint_t k   = 10;
+  const auto cap   = node_idx{40000};
+  const auto bbox  = geometry::square<2>::unit();
+  auto r = grid::generation::point_cloud(cap, points, bbox, k);
+  auto const& t = r.tree;
+
+  CHECK(t.capacity() == cap);
+  CHECK(t.is_compact());
+  CHECK(tree::dfs_sort.is(t));
+  CHECK(r.leafs.size() == points.size());
+
+  // each point is inside its leaf node, and leaf nodes have <= k points:
+  std::vector<uint_t> no_points(*t.size(), 0);
+  for (std::size_t i = 0; i != points.size(); ++i) {
+    const auto n = r.leafs[i];
+    CHECK(t.is_leaf(n));
+    ++no_points[*n];
+    const auto x_n = tree::normalized_coordinates(t, n);
+    const auto h   = tree::node_length_at_level(tree::node_level(t, n));
+    for (auto&& d : dimensions(2)) {
+      CHECK(std::abs(points[i](d) - x_n(d)) <= h / 2.);
+    }
+  }
+  for (auto&& n : t.nodes()) { CHECK(no_points[*n] <= k); }
+
+  // the tree is balanced:
+  RANGES_FOR (auto&& n, t.nodes() | t.leaf()) {
+    const auto l = *tree::node_level(t, n);
+    for (auto&& m : tree::node_neighbors(t, n)) {
+      const auto l_m = *tree::node_level(t, m);
+      CHECK((l_m + 1 >= l) and (l + 1 >= l_m));
+    }
+  }
+
+  // same tree as refining serially, balancing, and sorting:
+  tree_t ref(*cap);
+  refine(ref, node_idx{0}, point_t::constant(0.5), 1., points, k);
+  tree::balance(ref);
+  tree::dfs_sort(ref);
+  CHECK(t == ref);
+
+  // same tree from the Morton keys:
+  std::vector<grid::generation::morton_key_t> keys;
+  for (auto&& x : points) {
+    keys.push_back(grid::generation::morton_key(x, bbox));
+  }
+  auto rk = grid::generation::point_cloud<2>(cap, keys, k);
+  CHECK(rk.tree == t);
+  CHECK(rk.leafs == r.leafs);
+
+  // maximum level:
+  auto rl = grid::generation::point_cloud<2>(cap, keys, 1, 4);
+  RANGES_FOR (auto&& n, rl.tree.nodes()) {
+    CHECK(tree::node_level(rl.tree, n) <= tree::level_idx{4});
+  }
+
+  return test::result();
+}
@@ -0,0 +1,101 @@
+/// \file
+///
+/// Grid generation from signed-distance functions tests
+#include <hm3/grid/hc/single.hpp>
+#include <hm3/grid/generation/signed_distance.hpp>
+#include <hm3/geometry/sd.hpp>
+#include <hm3/tree/algorithm/dfs_sort.hpp>
+#include <hm3/utility/test.hpp>
+
+using namespace hm3;
+using grid::tree_node_idx;
+using tree::operator"" _n;
+
+using grid_t = grid::hc::single<2>;
+using grid::generation::distance_band;
+
+const auto sphere
+ = geometry::sd::fixed_sphere<2>{geometry::point<2>::constant(0.4), 0.2};
+
+/// Empty grid caching its geometry
+grid_t make_grid() {
+  grid_t g(tree_node_idx{20000}, geometry::square<2>::unit());
+  g.enable_geometry_cache();
+  return g;
+}
+
+/// Does node \p n intersect a band coarser than its level?
+bool needs_refinement(grid_t const& g, tree_node_idx n,
+                      std::vector<distance_band> const& bands) {
+  const auto d = std::abs(sphere(g.coordinates(n)));
+  return any_of(
+   bands, [&](auto&& b) { return *g.level(n) < b.level and d < b.distance; });
+}
+
+/// Generates the grid serially by refining the leaf nodes that intersect a
+/// band until no leaf node does, and balancing the result
+grid_t iterative(std::vector<distance_band> const& bands) {
+  auto g    = make_grid();
+  bool done = false;
+  while (!done) {
+    done = true;
+    std::vector<tree_node_idx> leafs;
+    RANGES_FOR (auto&& n, g.nodes() | g.leaf()) { leafs.push_back(n); }
+    for (auto&& n : leafs) {
+      if (needs_refinement(g, n, bands)) {
+        g.refine(n);
+        done = false;
+      }
+    }
+  }
+  tree::balance(g);
+  return g;
+}
+
+/// Are the levels of all neighboring leaf nodes at most one apart?
+bool is_balanced(grid_t const& g) {
+  RANGES_FOR (auto&& n, g.nodes() | g.leaf()) {
+    for (auto&& m : g.neighbors(n)) {
+      if (!g.is_leaf(m)) { continue; }
+      if (std::abs(idx_t(*g.level(n)) - idx_t(*g.level(m))) > 1) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main() {
+  auto g     = make_grid();
+  auto bands = grid::generation::cell_distance_bands(
+   g, {{10000, 3}, {2, 5}, {2, 6}, {2, 7}});
+  CHECK(bands.size() == 4_u);
+  CHECK(bands[0].level == 7_u);
+  CHECK(bands[3].level == 3_u);
+  CHECK(bands[0].distance == 2 * g.length(tree::level_idx{7}));
+
+  // exact node center test: same grid as the iterative refinement
+  grid::generation::signed_distance(g, sphere, bands, 0.);
+  CHECK(is_balanced(g));
+  RANGES_FOR (auto&& n, g.nodes() | g.leaf()) {
+    CHECK(!needs_refinement(g, n, bands));
+    CHECK(g.level(n) >= tree::level_idx{3});
+  }
+
+  auto ref = iterative(bands);
+  tree::dfs_sort(g);
+  tree::dfs_sort(ref);
+  CHECK(g == ref);
+
+  // Lipschitz bound: refines every node that might intersect a band
+  auto h = make_grid();
+  h.enable_hashes();
+  grid::generation::signed_distance(h, sphere, bands, 1.);
+  CHECK(is_balanced(h));
+  CHECK(h.size() > ref.size());
+  auto h_ref = h;
+  h_ref.enable_hashes();  // recompute the hashes
+  CHECK(h.hash() == h_ref.hash());
+
+  return test::result();
+}
@@ -1,6 +1,7 @@
 /// \file
 ///
 /// I/O session tests
+#include <vector>
 #include <hm3/io/client.hpp>
 #include <hm3/utility/test.hpp>
 
@@ -84,6 +85,22 @@ int main() {
     write(g, "grid_2", 3, "");
     check_dep_idx(l, 1);
     check_dep_idx(d, 5);
+
+    {  // write a batch of files at once: the files are registered in order
+      for (auto&& p : {"grid_3", "level_set_0_6", "dynamic_geometry_6"}) {
+        fs::remove(p, comm_world);
+      }
+      std::vector<io::file> files{g.new_file(), l.new_file(), d.new_file()};
+      s.write(files);
+      CHECK(s[g.name()].size() == io::file::index_t{4});
+      CHECK(s[l.name()].size() == io::file::index_t{7});
+      CHECK(s[d.name()].size() == io::file::index_t{7});
+      check_dep_idx(l, 3);
+      check_dep_idx(d, 6);
+      for (auto&& p : {"grid_3", "level_set_0_6", "dynamic_geometry_6"}) {
+        CHECK(fs::exists(p, comm_world));
+      }
+    }
     CHECK(s.size() == std::size_t{3});
   }
 
@@ -107,6 +107,10 @@ int main(int argc, char* argv[]) {
   ls1.set_node_values(sphere1);
   solver::write(g, ls0, ls1);
 
+  // Only the cells created during adaptation need to be updated:
+  ls0.g.enable_journal();
+  ls1.g.enable_journal();
+
   /// Main loop:
   uint_t count_ = 0;
   RANGES_FOR (auto&& t, time_steps) {
@@ -117,6 +121,7 @@ int main(int argc, char* argv[]) {
     ls0.set_node_values(sphere0);
     ls1.set_node_values(sphere1);
 
+    auto m0          = ls0.g.journal_marker();
     int iter_counter = 0;
     while (amr_handler0.adapt(amr_action0, [&]() {
 #ifdef HM3_ENABLE_VTK
@@ -128,10 +133,17 @@ int main(int argc, char* argv[]) {
 #endif
       iter_counter++;
     })) {
-      ls0.set_node_values(sphere0);
+      ls0.set_node_values(sphere0, ls0.g.created_since(m0));
+      m0 = ls0.g.journal_marker();
     }
+    ls0.g.discard_changes_before(m0);
 
-    while (amr_handler1.adapt(amr_action1)) { ls1.set_node_values(sphere1); }
+    auto m1 = ls1.g.journal_marker();
+    while (amr_handler1.adapt(amr_action1)) {
+      ls1.set_node_values(sphere1, ls1.g.created_since(m1));
+      m1 = ls1.g.journal_marker();
+    }
+    ls1.g.discard_changes_before(m1);
 
     solver::sort(g, ls0, ls1);
     solver::write(g, ls0, ls1);
@@ -0,0 +1,111 @@
+/// \file
+///
+/// Solver grid CSR neighbors tests
+#include <hm3/utility/test.hpp>
+#include <hm3/solver/state/csr_neighbors.hpp>
+#include <hm3/grid/generation/uniform.hpp>
+
+using namespace hm3;
+
+using namespace grid;
+
+int main(int argc, char* argv[]) {
+  /// \name Setup
+  ///@{
+  /// Initialize MPI
+  mpi::env env(argc, argv);
+  auto comm = env.world();
+
+  /// Initialize I/O session
+  io::session::remove("state_csr_neighbors", comm);
+  io::session s(io::create, "state_csr_neighbors", comm);
+
+  /// Grid parameters
+  constexpr uint_t nd = 2;
+  auto max_grid_level = 3;
+  auto node_capacity
+   = tree_node_idx{tree::no_nodes_until_uniform_level(nd, max_grid_level)};
+  auto bounding_box = geometry::square<2>::unit();
+  auto no_grids     = 1;
+
+  /// Create the grid
+  grid::mhc<nd> g(s, node_capacity, no_grids, bounding_box);
+
+  /// Refine the grid up to the maximum leaf node level
+  grid::generation::uniform(g, max_grid_level);
+  ///@}  // Setup
+
+  solver::state::grid<nd> gs(g, 0_g, *node_capacity);
+  RANGES_FOR (auto&& n, g.nodes() | g.leaf()) { gs.push(n); }
+  const idx_t no_nodes = *gs.size();
+  CHECK(no_nodes == 64);
+
+  solver::state::csr_neighbors ns(gs.capacity(), 2, true);
+  ns.build(gs);
+
+  // same neighbors as the solver grid, symmetric, and with manifold ranks:
+  idx_t no_faces = 0, no_corners = 0;
+  RANGES_FOR (auto&& n, gs()) {
+    auto ref = gs.neighbors(n);
+    CHECK(ns.size(n) == static_cast<idx_t>(ref.size()));
+    for (auto&& m : ref) { CHECK(ns.has_neighbor(n, m)); }
+    for (auto&& m : ns(n)) { CHECK(ns.has_neighbor(m, n)); }
+    for (auto&& m : ns.manifolds(n)) {
+      CHECK(m == 1 or m == 2);
+      (m == 1 ? no_faces : no_corners)++;
+    }
+  }
+  // 8x8 cells: 2 * 2 * 7 * 8 face and 2 * 2 * 7 * 7 corner neighbors
+  CHECK(no_faces == 224);
+  CHECK(no_corners == 196);
+  // rows are stored in order:
+  CHECK(ns.offset(0_gn) == 0);
+  CHECK(ns.offset(1_gn) == ns.size(0_gn) + ns.slack());
+
+  // patching within the slack and beyond:
+  const auto a = 0_gn;
+  std::vector<grid_node_idx> extra;
+  for (idx_t i = 1; extra.size() != 5; ++i) {
+    if (!ns.has_neighbor(a, grid_node_idx{i})) {
+      extra.push_back(grid_node_idx{i});
+    }
+  }
+  const auto offset_1 = ns.offset(1_gn);
+  ns.push(a, extra[0]);
+  ns.push(a, extra[1]);
+  CHECK(ns.offset(1_gn) == offset_1);  // within the slack
+  for (idx_t i = 2; i != 5; ++i) { ns.push(a, extra[i]); }
+  CHECK(ns.offset(1_gn) != offset_1);  // repacked
+  for (auto&& m : extra) {
+    CHECK(ns.has_neighbor(a, m));
+    CHECK(ns.has_neighbor(m, a));
+  }
+  for (auto&& m : extra) { ns.pop(a, m); }
+  for (auto&& m : extra) {
+    CHECK(!ns.has_neighbor(a, m));
+    CHECK(!ns.has_neighbor(m, a));
+  }
+  CHECK(ns.size(a) == static_cast<idx_t>(gs.neighbors(a).size()));
+
+  // reordering with a permutation (here: reversing the nodes):
+  std::vector<grid_node_idx> p;
+  for (idx_t i = no_nodes - 1; i >= 0; --i) { p.push_back(grid_node_idx{i}); }
+  auto old = ns;
+  ns.permute(p);
+  for (idx_t i = 0; i != no_nodes; ++i) {
+    const grid_node_idx n{i};
+    CHECK(ns.size(n) == old.size(p[i]));
+    for (auto&& m : old(p[i])) {
+      CHECK(ns.has_neighbor(n, grid_node_idx{no_nodes - 1 - *m}));
+    }
+  }
+
+  // removing a node:
+  ns.pop(0_gn);
+  CHECK(ns.size(0_gn) == 0);
+  for (idx_t i = 1; i != no_nodes; ++i) {
+    CHECK(!ns.has_neighbor(grid_node_idx{i}, 0_gn));
+  }
+
+  return test::result();
+}
@@ -0,0 +1,155 @@
+/// \file
+///
+/// Solver grid faces tests
+#include <tuple>
+#include <hm3/utility/test.hpp>
+#include <hm3/solver/state/faces.hpp>
+#include <hm3/solver/state/grid.hpp>
+#include <hm3/grid/generation/uniform.hpp>
+
+using namespace hm3;
+
+using namespace grid;
+
+int main(int argc, char* argv[]) {
+  /// \name Setup
+  ///@{
+  /// Initialize MPI
+  mpi::env env(argc, argv);
+  auto comm = env.world();
+
+  /// Initialize I/O session
+  io::session::remove("state_faces", comm);
+  io::session s(io::create, "state_faces", comm);
+
+  /// Grid parameters
+  constexpr uint_t nd = 2;
+  auto max_grid_level = 3;
+  auto node_capacity
+   = tree_node_idx{tree::no_nodes_until_uniform_level(nd, max_grid_level)};
+  auto bounding_box = geometry::square<2>::unit();
+  auto no_grids     = 1;
+
+  /// Create the grid
+  grid::mhc<nd> g(s, node_capacity, no_grids, bounding_box);
+
+  /// Refine the grid up to level 2 (4x4 leaf nodes)
+  grid::generation::uniform(g, 2);
+  ///@}  // Setup
+
+  solver::state::grid<nd> gs(g, 0_g, *node_capacity);
+  RANGES_FOR (auto&& n, g.nodes() | g.leaf()) { gs.push(n); }
+
+  using solver::state::faces;
+  faces fs;
+  fs.build(gs);
+
+  auto sorted_faces = [](faces const& f) {
+    std::vector<std::tuple<idx_t, idx_t, uint_t, num_t>> r;
+    for (idx_t i = 0; i != f.size(); ++i) {
+      r.emplace_back(*f.left(i), *f.right(i), f.axis(i), f.area_fraction(i));
+    }
+    std::sort(begin(r), end(r));
+    return r;
+  };
+  auto check_faces = [&](faces const& f) {
+    // the faces of a color share no cell:
+    for (uint_t c = 0; c != f.no_colors(); ++c) {
+      std::vector<char> touched(*gs.capacity(), 0);
+      for (auto&& i : f.faces_of_color(c)) {
+        CHECK(f.color(i) == c);
+        CHECK(!touched[*f.left(i)]);
+        CHECK(!touched[*f.right(i)]);
+        touched[*f.left(i)] = touched[*f.right(i)] = 1;
+      }
+    }
+    for (idx_t i = 0; i != f.size(); ++i) {
+      // the normal points from left to right:
+      const auto d = f.axis(i);
+      CHECK(gs.coordinates(f.left(i))(d) < gs.coordinates(f.right(i))(d));
+      auto ns = gs.neighbors(f.left(i));
+      CHECK(find(ns, f.right(i)) != end(ns));
+      CHECK(f.area(gs, i)
+            == std::min(gs.tree().length(gs.tree_node(f.left(i))),
+                        gs.tree().length(gs.tree_node(f.right(i)))));
+    }
+    // each face is stored once:
+    auto r = sorted_faces(f);
+    CHECK(std::adjacent_find(begin(r), end(r), [](auto&& a, auto&& b) {
+            return std::get<0>(a) == std::get<0>(b)
+                   and std::get<1>(a) == std::get<1>(b);
+          })
+          == end(r));
+  };
+
+  // 4x4 cells: 2 * 4 * 3 faces
+  CHECK(fs.size() == 24);
+  CHECK(fs.no_colors() <= 7_u);
+  check_faces(fs);
+  for (idx_t i = 0; i != fs.size(); ++i) { CHECK(fs.area_fraction(i) == 1.); }
+
+  // refining an interior cell: its 4 faces are replaced by 4 faces between
+  // the children and 8 hanging faces
+  gs.enable_journal();
+  const auto m = gs.journal_marker();
+  grid_node_idx middle{};
+  RANGES_FOR (auto&& n, gs()) {
+    auto x = gs.coordinates(n);
+    if (x(0) > 0.25 and x(0) < 0.5 and x(1) > 0.25 and x(1) < 0.5) {
+      middle = n;
+      break;
+    }
+  }
+  CHECK(middle);
+  { auto b = gs.refine(std::vector<grid_node_idx>{middle}); }
+  fs.update(gs, gs.created_since(m));
+  CHECK(fs.size() == 32);
+  check_faces(fs);
+  idx_t no_hanging = 0;
+  for (idx_t i = 0; i != fs.size(); ++i) {
+    if (fs.area_fraction(i) == 0.5) { ++no_hanging; }
+  }
+  CHECK(no_hanging == 8);
+
+  faces ref;
+  ref.build(gs);
+  CHECK(sorted_faces(fs) == sorted_faces(ref));
+
+  // coarsening the children restores the initial faces:
+  const auto m2 = gs.journal_marker();
+  grid_node_idx child{};
+  RANGES_FOR (auto&& n, gs()) {
+    if (gs.level(n) == level_idx{3}) {
+      child = n;
+      break;
+    }
+  }
+  { auto b = gs.coarsen(std::vector<grid_node_idx>{child}); }
+  CHECK(gs.is_free(child));
+  fs.update(gs, gs.created_since(m2));
+  CHECK(fs.size() == 24);
+  check_faces(fs);
+  ref.build(gs);
+  CHECK(sorted_faces(fs) == sorted_faces(ref));
+
+  // sorting the grid renumbers the cells of the faces:
+  gs.sort([&](std::vector<grid_node_idx> const& p) { fs.permute(p); });
+  check_faces(fs);
+  ref.build(gs);
+  CHECK(sorted_faces(fs) == sorted_faces(ref));
+
+  // scatter without races:
+  std::vector<idx_t> no_faces(*gs.capacity(), 0);
+  fs.for_each([&](idx_t i) {
+    ++no_faces[*fs.left(i)];
+    ++no_faces[*fs.right(i)];
+  });
+  idx_t total = 0;
+  RANGES_FOR (auto&& n, gs()) {
+    CHECK(no_faces[*n] >= 2 and no_faces[*n] <= 4);  // corners: 2
+    total += no_faces[*n];
+  }
+  CHECK(total == 2 * fs.size());
+
+  return test::result();
+}
@@ -0,0 +1,139 @@
+/// \file
+///
+/// Solver field registry tests
+#include <cstdint>
+#include <hm3/solver/state/fields.hpp>
+#include <hm3/utility/test.hpp>
+
+using namespace hm3;
+using namespace solver::state;
+using solver::grid_node_idx;
+using solver::operator"" _gn;
+
+using density_t = field<num_t, prolongation::copy, restriction::average>;
+using mass_t    = field<idx_t, prolongation::none, restriction::sum>;
+
+/// Batch of sibling groups of 4 children (see grid::coarsen(range))
+struct batch_t {
+  std::vector<grid_node_idx> parents_;
+  std::vector<std::vector<grid_node_idx>> children_;
+  static constexpr uint_t no_children() noexcept { return 4; }
+  idx_t size() const noexcept { return parents_.size(); }
+  grid_node_idx parent(idx_t i) const noexcept { return parents_[i]; }
+  auto const& children(idx_t i) const noexcept { return children_[i]; }
+};
+
+int main() {
+  fields<density_t, mass_t> fs(density_t("density", grid_node_idx{10}, 1.),
+                               mass_t("mass", grid_node_idx{10}, 0));
+  static_assert(decltype(fs)::size() == 2, "");
+  auto& rho = fs.get<0>();
+  auto& m   = fs.get<1>();
+  CHECK(rho.name == "density");
+  CHECK(m.name == "mass");
+  CHECK(reinterpret_cast<std::uintptr_t>(rho.data()) % 64 == 0);
+  CHECK(reinterpret_cast<std::uintptr_t>(m.data()) % 64 == 0);
+
+  // refine node 0 into nodes 1-4:
+  const std::vector<grid_node_idx> children{1_gn, 2_gn, 3_gn, 4_gn};
+  rho(0_gn) = 2.;
+  m(0_gn)   = 8;
+  fs.interpolate_from_parent_to_children(0_gn, children);
+  for (auto&& c : children) {
+    CHECK(rho(c) == 2.);
+    CHECK(m(c) == 0);  // not prolongated
+  }
+
+  // coarsen nodes 1-4 into node 5:
+  idx_t i = 1;
+  for (auto&& c : children) {
+    rho(c) = i;
+    m(c)   = i;
+    ++i;
+  }
+  fs.interpolate_from_children_to_parent(5_gn, children);
+  CHECK(rho(5_gn) == 2.5);
+  CHECK(m(5_gn) == 10);
+
+  // swap and permute all fields:
+  fs.swap(1_gn, 4_gn);
+  CHECK(rho(1_gn) == 4. and m(1_gn) == 4);
+  CHECK(rho(4_gn) == 1. and m(4_gn) == 1);
+  const std::vector<grid_node_idx> p{5_gn, 4_gn, 3_gn, 2_gn, 1_gn, 0_gn};
+  fs.permute(p);
+  CHECK(rho(0_gn) == 2.5 and m(0_gn) == 10);
+  CHECK(rho(1_gn) == 1. and m(1_gn) == 1);
+  CHECK(rho(4_gn) == 4. and m(4_gn) == 4);
+  CHECK(rho(5_gn) == 2. and m(5_gn) == 8);
+
+  // memory statistics:
+  tree::statistics s;
+  fs.add_memory_stats(s, grid_node_idx{6});
+  CHECK(s.memory.size() == 2_u);
+  CHECK(s.memory[0].name == "density");
+  CHECK(s.memory[0].used == 6 * sizeof(num_t));
+  CHECK(s.memory[1].reserved == 10 * sizeof(idx_t));
+
+  // sibling group kernels (contiguous and scattered children):
+  {
+    fields<density_t, mass_t> gs(density_t("density", grid_node_idx{12}, 0.),
+                                 mass_t("mass", grid_node_idx{12}, 0));
+    batch_t b{{0_gn, 1_gn},
+              {{2_gn, 3_gn, 4_gn, 5_gn}, {11_gn, 6_gn, 9_gn, 7_gn}}};
+    for (idx_t i = 2; i != 12; ++i) {
+      gs.get<0>()(grid_node_idx{i}) = i;
+      gs.get<1>()(grid_node_idx{i}) = i;
+    }
+    idx_t no_calls = 0;
+    gs.for_each_sibling_group(b,
+                              [&](auto&, idx_t, auto&, auto* cv) {
+                                ++no_calls;
+                                cv[0] = cv[0] + 100;  // written back
+                              },
+                              [&](auto&, idx_t) { CHECK(false); });
+    CHECK(no_calls == 4);  // 2 groups x 2 fields
+    CHECK(gs.get<0>()(2_gn) == 102.);
+    CHECK(gs.get<1>()(11_gn) == 111);
+    gs.interpolate_from_children_to_parents(b);
+    CHECK(gs.get<0>()(0_gn) == (102. + 3. + 4. + 5.) / 4.);
+    CHECK(gs.get<1>()(1_gn) == 111 + 6 + 9 + 7);
+
+    // sibling groups partially in the grid use the per-node rules:
+    batch_t pb{{0_gn}, {{2_gn, 3_gn, 4_gn}}};
+    gs.interpolate_from_children_to_parents(pb);
+    CHECK(gs.get<0>()(0_gn) == (102. + 3. + 4.) / 3.);
+    CHECK(gs.get<1>()(0_gn) == 102 + 3 + 4);
+  }
+
+  // averaging integral values:
+  {
+    std::array<idx_t, 4> cs{{2, 4, 6, 8}};
+    idx_t p = 0;
+    restriction::average::apply_group<4>(cs.data(), p);
+    CHECK(p == 5);
+  }
+
+  // linear prolongation rules:
+  {
+    slopes<num_t, 2> s{{{1., 2.}}, {{3., -1.}}};
+    std::array<num_t, 4> cs;
+    prolongation::linear::apply_group<4>(1., cs.data(), s);
+    // central slopes: (2, 0.5)
+    CHECK(cs[0] == 1. - 0.5 - 0.125);
+    CHECK(cs[1] == 1. + 0.5 - 0.125);
+    CHECK(cs[2] == 1. - 0.5 + 0.125);
+    CHECK(cs[3] == 1. + 0.5 + 0.125);
+    CHECK(cs[0] + cs[1] + cs[2] + cs[3] == 4.);  // conservative
+    prolongation::limited_linear::apply_group<4>(1., cs.data(), s);
+    // minmod slopes: (1, 0)
+    CHECK(cs[0] == 0.75 and cs[2] == 0.75);
+    CHECK(cs[1] == 1.25 and cs[3] == 1.25);
+  }
+
+  auto copy = fs;
+  CHECK(copy == fs);
+  copy.get<1>()(0_gn) = 0;
+  CHECK(copy != fs);
+
+  return test::result();
+}
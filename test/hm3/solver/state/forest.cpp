@@ -0,0 +1,98 @@
+/// \file
+///
+/// Solver grid on a forest of hierarchical Cartesian grids tests
+#include <cmath>
+#include <vector>
+#include <hm3/solver/level_set/amr.hpp>
+#include <hm3/solver/level_set/state.hpp>
+#include <hm3/solver/state/grid.hpp>
+#include <hm3/utility/test.hpp>
+
+using namespace hm3;
+
+using namespace grid;
+
+int main(int argc, char* argv[]) {
+  /// \name Setup
+  ///@{
+  /// Initialize MPI
+  mpi::env env(argc, argv);
+  auto comm = env.world();
+
+  /// Initialize I/O session
+  io::session::remove("state_forest", comm);
+  io::session s(io::create, "state_forest", comm);
+
+  constexpr uint_t nd = 2;
+  using forest_t      = hc::forest<nd>;
+  using tree_grid_t   = mhc_forest<nd>;
+  using point_t       = geometry::point<nd>;
+
+  /// Channel with aspect ratio 4:1 (4 roots of length 0.25)
+  tree_grid_t g(s, tree_grid_t::base_t(
+                    2_g, forest_t(tree_node_idx{200}, point_t::constant(0.),
+                                  0.25, {{4, 1}})));
+
+  /// Refine the roots once (8x2 leaf nodes)
+  std::vector<tree_node_idx> roots;
+  RANGES_FOR (auto&& r, g.roots()) { roots.push_back(r); }
+  CHECK(roots.size() == 4_u);
+  for (auto&& r : roots) { g.refine(r); }
+  ///@}  // Setup
+
+  solver::state::grid<nd, idx_t, tree_grid_t> gs(g, 0_g, grid_node_idx{100});
+  RANGES_FOR (auto&& n, g.nodes() | g.leaf() | g.in_domain()) { gs.push(n); }
+  CHECK(gs.size() == 16_gn);
+
+  // neighbors cross the boundaries between the roots and stay in the brick:
+  idx_t no_neighbors = 0, no_across_roots = 0;
+  RANGES_FOR (auto&& n, gs()) {
+    for (auto&& m : gs.neighbors(n)) {
+      CHECK(m);
+      CHECK(g.in_domain(gs.tree_node(m)));
+      ++no_neighbors;
+      no_across_roots += g.root(gs.tree_node(m)) != g.root(gs.tree_node(n));
+    }
+  }
+  // 8x2 cells: 2 * (14 + 8) face and 2 * 14 corner neighbors
+  CHECK(no_neighbors == 72);
+  // 3 root boundaries with 2 face and 2 corner neighbor pairs each
+  CHECK(no_across_roots == 24);
+
+  // refinement and coarsening:
+  { auto b = gs.refine(std::vector<grid_node_idx>{0_gn}); }
+  CHECK(gs.size() == 19_gn);
+  std::vector<grid_node_idx> children;
+  RANGES_FOR (auto&& n, gs()) {
+    if (gs.level(n) == level_idx{4}) { children.push_back(n); }
+  }
+  CHECK(children.size() == 4_u);
+  { auto b = gs.coarsen(children); }
+  CHECK(gs.size() == 16_gn);
+
+  // sorting orders the cells of all roots along the Morton curve:
+  g.sort();
+  gs.sort([](std::vector<grid_node_idx> const&) {});
+  CHECK(gs.is_compact());
+  idx_t prev = -1;
+  RANGES_FOR (auto&& n, gs()) {
+    CHECK(*gs.tree_node(n) > prev);
+    prev = *gs.tree_node(n);
+  }
+
+  // the level-set solver and its AMR target run on the forest:
+  solver::level_set::state<nd, tree_grid_t> ls(g, 1_g, grid_node_idx{100}, s);
+  RANGES_FOR (auto&& n, g.nodes() | g.leaf() | g.in_domain()) { ls.push(n); }
+  ls.set_node_values([](auto&& x) { return x(0) - 0.5; });
+  auto amr_handler = solver::level_set::make_amr(ls);
+  // refine the 2x2 cells next to the zero level-set:
+  CHECK(amr_handler.adapt([&](grid_node_idx n) {
+    return std::abs(ls.signed_distance(n)) < 0.125
+            and ls.g.level(n) < level_idx{4}
+            ? ::hm3::amr::action::refine
+            : ::hm3::amr::action::none;
+  }));
+  CHECK(ls.g.size() == grid_node_idx{16 - 4 + 16});
+
+  return test::result();
+}
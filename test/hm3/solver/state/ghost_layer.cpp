@@ -0,0 +1,146 @@
+/// \file
+///
+/// Solver grid ghost layer tests
+#include <hm3/utility/test.hpp>
+#include <hm3/solver/state/ghost_layer.hpp>
+#include <hm3/solver/state/grid.hpp>
+#include <hm3/grid/generation/uniform.hpp>
+
+using namespace hm3;
+
+using namespace grid;
+
+int main(int argc, char* argv[]) {
+  /// \name Setup
+  ///@{
+  /// Initialize MPI
+  mpi::env env(argc, argv);
+  auto comm = env.world();
+
+  /// Initialize I/O session
+  io::session::remove("state_ghost_layer", comm);
+  io::session s(io::create, "state_ghost_layer", comm);
+
+  /// Grid parameters
+  constexpr uint_t nd = 2;
+  auto max_grid_level = 3;
+  auto node_capacity
+   = tree_node_idx{tree::no_nodes_until_uniform_level(nd, max_grid_level)};
+  auto bounding_box = geometry::square<2>::unit();
+  auto no_grids     = 1;
+
+  /// Create the grid
+  grid::mhc<nd> g(s, node_capacity, no_grids, bounding_box);
+
+  /// Refine the grid up to level 2 (4x4 leaf nodes)
+  grid::generation::uniform(g, 2);
+  ///@}  // Setup
+
+  using solver::state::boundary_kind;
+  using solver::state::ghost_layer;
+
+  // the solver grid covers the left half of the domain:
+  solver::state::grid<nd> gs(g, 0_g, *node_capacity);
+  RANGES_FOR (auto&& n, g.nodes() | g.leaf()) {
+    if (g.coordinates(n)(0) < 0.5) { gs.push(n); }
+  }
+  CHECK(gs.size() == 8_gn);
+
+  ghost_layer gl(2);
+  gl.build(gs);
+  // 4 left, 2 bottom, 2 top domain boundary faces, and 4 grid boundary faces
+  CHECK(gl.size() == 2 * 12);
+  CHECK(gs.size() == grid_node_idx{8 + 2 * 12});
+  CHECK(gl.is_contiguous(gs));
+  idx_t no_domain = 0, no_grid = 0;
+  for (auto&& gh : gl()) {
+    CHECK(!gs.tree_node(gh.node));
+    CHECK(gs.tree_node(gh.owner));
+    CHECK(gs.tree_node(gh.source));
+    CHECK(gl(gh.owner, gh.position, gh.layer) == gh.node);
+    CHECK(gh.layer == 1 or gh.layer == 2);
+    CHECK((gh.layer == 1) == (gh.source == gh.owner));
+    if (gh.layer == 2) {
+      auto ns = gs.neighbors(gh.owner);
+      CHECK(find(ns, gh.source) != end(ns));
+    }
+    (gh.kind == boundary_kind::domain ? no_domain : no_grid)++;
+    // the ghosts lie outside of the solver grid:
+    auto x = ghost_layer::coordinates(gs, gh);
+    CHECK(x(0) < 0. or x(0) > 0.5 or x(1) < 0. or x(1) > 1.);
+  }
+  CHECK(no_domain == 2 * 8);
+  CHECK(no_grid == 2 * 4);
+  for (auto&& n : gs.tree_nodes()) {
+    if (!n) { continue; }  // ghost
+    CHECK(gs.in_tree(n));  // interior cells are untouched
+  }
+
+  // incremental update after refining a cell at the left boundary:
+  gs.enable_journal();
+  auto m = gs.journal_marker();
+  grid_node_idx left{};
+  RANGES_FOR (auto&& n, gs()) {
+    if (gs.tree_node(n) and gs.coordinates(n)(0) < 0.25
+        and gs.coordinates(n)(1) > 0.25 and gs.coordinates(n)(1) < 0.75) {
+      left = n;
+      break;
+    }
+  }
+  CHECK(left);
+  { auto b = gs.refine(std::vector<grid_node_idx>{left}); }
+  gl.update(gs, gs.created_since(m));
+  // the parent ghosts are replaced by 2 left ghosts for 2 children:
+  CHECK(gl.size() == 2 * 13);
+  for (auto&& gh : gl()) {
+    CHECK(!gs.is_free(gh.node));
+    CHECK(!gs.tree_node(gh.node));
+    CHECK(gs.tree_node(gh.owner));
+    CHECK(ghost_layer::boundary(gs, gh.owner, gh.position) == gh.kind);
+  }
+
+  // sorting the grid moves the ghosts to the end:
+  gs.sort([&](std::vector<grid_node_idx> const& p) { gl.permute(p); });
+  CHECK(gl.is_contiguous(gs));
+  for (auto&& gh : gl()) {
+    CHECK(!gs.tree_node(gh.node));
+    CHECK(gs.tree_node(gh.owner));
+  }
+
+  // coarsening the children and refining another cell reuses the freed grid
+  // nodes, the ghosts must not keep them as their source:
+  m = gs.journal_marker();
+  std::vector<grid_node_idx> children;
+  grid_node_idx right{};
+  RANGES_FOR (auto&& n, gs()) {
+    if (!gs.tree_node(n)) { continue; }
+    if (gs.level(n) == level_idx{3}) {
+      children.push_back(n);
+    } else if (gs.coordinates(n)(0) > 0.25 and gs.coordinates(n)(1) < 0.25) {
+      right = n;
+    }
+  }
+  CHECK(children.size() == 4_u);
+  CHECK(right);
+  { auto b = gs.coarsen(children); }
+  { auto b = gs.refine(std::vector<grid_node_idx>{right}); }
+  gl.update(gs, gs.created_since(m));
+  // the bottom and grid boundary faces of right are split in two:
+  CHECK(gl.size() == 2 * 14);
+  for (auto&& gh : gl()) {
+    CHECK(!gs.is_free(gh.source));
+    CHECK(gs.tree_node(gh.source));
+    CHECK(ghost_layer::boundary(gs, gh.owner, gh.position) == gh.kind);
+    if (gh.source != gh.owner) {
+      CHECK(gs.level(gh.source) == gs.level(gh.owner));
+      auto ns = gs.neighbors(gh.owner);
+      CHECK(find(ns, gh.source) != end(ns));
+    }
+  }
+
+  gl.clear(gs);
+  CHECK(gl.size() == 0);
+  CHECK(gs.size() == grid_node_idx{8 - 1 + 4});
+
+  return test::result();
+}
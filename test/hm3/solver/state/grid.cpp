@@ -1,6 +1,7 @@
 /// \file
 ///
 /// Solver grid state tests
+#include <algorithm>
 #include <hm3/utility/test.hpp>
 #include <hm3/solver/state/grid.hpp>
 #include <hm3/grid/generation/uniform.hpp>
@@ -64,6 +65,173 @@ int main(int argc, char* argv[]) {
   //  grid_state1.nodes(),
   //  boxed_ints<tree_node_idx>(no_leaf_nodes / 2, no_leaf_nodes));
 
+  // push / pop without holes:
+  {
+    const auto s0 = grid_state0.size();
+    CHECK(grid_state0.is_compact());
+    auto a = grid_state0.push(tree_node_idx{});
+    auto b = grid_state0.push(tree_node_idx{});
+    auto c = grid_state0.push(tree_node_idx{});
+    CHECK(a == s0);
+    CHECK(*b == *a + 1);
+    CHECK(*c == *b + 1);
+    CHECK(grid_state0.is_compact());
+
+    // popping creates a hole that is reused by the next push:
+    grid_state0.pop(b);
+    CHECK(!grid_state0.is_compact());
+    CHECK(distance(grid_state0.in_use()) == *grid_state0.size());
+    CHECK(ranges::none_of(grid_state0.in_use(),
+                          [&](grid_node_idx n) { return n == b; }));
+    CHECK(grid_state0.push(tree_node_idx{}) == b);
+    CHECK(grid_state0.is_compact());
+
+    // batch pushes are contiguous past the last node in use:
+    grid_state0.pop(b);
+    std::vector<tree_node_idx> siblings(4);
+    auto sns = grid_state0.push(siblings);
+    CHECK(sns.size() == 4_u);
+    for (idx_t i = 0; i != 4; ++i) { CHECK(*sns[i] == *c + 1 + i); }
+    CHECK(distance(grid_state0.in_use()) == *grid_state0.size());
+
+    for (auto&& n : sns) { grid_state0.pop(n); }
+    grid_state0.pop(c);
+    grid_state0.pop(a);
+    CHECK(grid_state0.size() == s0);
+    CHECK(grid_state0.is_compact());
+  }
+
+  // sorting with a permutation:
+  {
+    auto& gs = grid_state1;
+    dense::vector<idx_t, dense::dynamic, grid_node_idx> data(*gs.capacity());
+    RANGES_FOR (auto&& n, gs()) { data(n) = *gs.tree_node(n); }
+    // scramble the grid nodes:
+    const idx_t no_nodes = *gs.size();
+    for (idx_t i = 0; i < no_nodes / 2; ++i) {
+      const grid_node_idx a{i}, b{no_nodes - 1 - i};
+      std::swap(data(a), data(b));
+      gs.swap(a, b);
+    }
+    CHECK(*gs.tree_node(0_gn) == data(0_gn));
+    CHECK(gs.tree_node(0_gn) != tree_node_idx{no_leaf_nodes / 2});
+
+    idx_t no_calls = 0;
+    gs.sort([&](std::vector<grid_node_idx> const& p) {
+      CHECK(static_cast<idx_t>(p.size()) == no_nodes);
+      ++no_calls;
+      gs.permute(data, p);
+    });
+    CHECK(no_calls == 1);
+    CHECK(gs.is_compact());
+    CHECK(gs.size() == grid_node_idx{no_nodes});
+    test::check_equal(gs.tree_nodes(), boxed_ints<tree_node_idx>(
+                                        no_leaf_nodes / 2, no_leaf_nodes));
+    RANGES_FOR (auto&& n, gs()) {
+      CHECK(data(n) == *gs.tree_node(n));
+      CHECK(gs.in_tree(gs.tree_node(n)) == n);
+    }
+  }
+
+  // batched refinement and coarsening:
+  {
+    grid::mhc<nd> t(
+     s, tree_node_idx{tree::no_nodes_until_uniform_level(nd, 3)}, 1,
+     bounding_box);
+    grid::generation::uniform(t, 1);
+    solver::state::grid<nd> gs(t, 0_g, grid_node_idx{100});
+    RANGES_FOR (auto&& n, t.nodes() | t.leaf()) { gs.push(n); }
+    CHECK(gs.size() == 4_gn);
+
+    const auto p0 = gs.tree_node(0_gn), p1 = gs.tree_node(2_gn);
+    {
+      auto b = gs.refine(std::vector<grid_node_idx>{0_gn, 2_gn});
+      CHECK(b.size() == 2);
+      CHECK(gs.size() == 12_gn);  // the parents are still alive
+      CHECK(b.parent(0) == 0_gn);
+      CHECK(b.parent(1) == 2_gn);
+      for (idx_t i = 0; i != b.size(); ++i) {
+        idx_t j = 0;
+        for (auto&& c : b.children(i)) {
+          CHECK(*c == 4 + 4 * i + j++);  // contiguous children
+          CHECK(gs.parent(c) == gs.tree_node(b.parent(i)));
+        }
+      }
+    }
+    CHECK(gs.size() == 10_gn);
+    CHECK(distance(gs.in_use()) == 10);
+    CHECK(!t.is_leaf(p0));
+    CHECK(!t.is_leaf(p1));
+
+    {
+      // two siblings of the first group, and one of the second one:
+      auto b = gs.coarsen(std::vector<grid_node_idx>{4_gn, 5_gn, 8_gn});
+      CHECK(b.size() == 2);
+      CHECK(gs.size() == 12_gn);  // the children are still alive
+      for (idx_t i = 0; i != b.size(); ++i) {
+        CHECK(distance(b.children(i)) == 4);
+      }
+    }
+    CHECK(gs.size() == 4_gn);
+    CHECK(distance(gs.in_use()) == 4);
+    CHECK(t.is_leaf(p0));
+    CHECK(t.is_leaf(p1));
+  }
+
+  // change journal:
+  {
+    grid::mhc<nd> t(
+     s, tree_node_idx{tree::no_nodes_until_uniform_level(nd, 3)}, 1,
+     bounding_box);
+    grid::generation::uniform(t, 1);
+    solver::state::grid<nd> gs(t, 0_g, grid_node_idx{100});
+    RANGES_FOR (auto&& n, t.nodes() | t.leaf()) { gs.push(n); }
+    CHECK(!gs.has_journal());
+    gs.enable_journal();
+    const auto m = gs.journal_marker();
+    CHECK(distance(gs.changed_since(m)) == 0);
+
+    const auto p0 = gs.tree_node(0_gn);
+    { auto b = gs.refine(std::vector<grid_node_idx>{0_gn}); }
+    // 4 children created and the parent removed:
+    CHECK(distance(gs.changed_since(m)) == 5);
+    auto is_child_of_p0 = [&](grid_node_idx n) {
+      return gs.parent(n) == p0;
+    };
+    auto created = gs.created_since(m);
+    CHECK(created.size() == 4_u);
+    for (auto&& n : created) { CHECK(is_child_of_p0(n)); }
+    CHECK(gs.changed_tree_nodes_since(m).size() == 5_u);
+
+    // the created nodes are tracked through swaps and sorts:
+    gs.swap(created[0], 1_gn);
+    gs.sort([](std::vector<grid_node_idx> const&) {});
+    created = gs.created_since(m);
+    CHECK(created.size() == 4_u);
+    for (auto&& n : created) { CHECK(is_child_of_p0(n)); }
+    idx_t no_children = 0;
+    RANGES_FOR (auto&& n, gs()) { no_children += is_child_of_p0(n); }
+    CHECK(no_children == 4);
+
+    // two sorts in a row are replayed one after the other:
+    const auto before = created;
+    solver::state::grid<nd>::sort_plan_t reversed;
+    RANGES_FOR (auto&& n, t.nodes(0_g)) { reversed.push_back(gs, n); }
+    std::reverse(begin(reversed.tree_nodes), end(reversed.tree_nodes));
+    std::reverse(begin(reversed.permutation), end(reversed.permutation));
+    gs.sort(std::move(reversed), [](std::vector<grid_node_idx> const&) {});
+    gs.sort([](std::vector<grid_node_idx> const&) {});
+    created = gs.created_since(m);
+    CHECK(created == before);
+
+    const auto m2 = gs.journal_marker();
+    gs.discard_changes_before(m2);
+    CHECK(gs.created_since(m2).empty());
+    gs.disable_journal();
+    gs.pop(0_gn);
+    CHECK(gs.journal_marker() == m2);
+  }
+
   // test neighbors
   // test children
   // test refine / coarsen
@@ -0,0 +1,122 @@
+/// \file
+///
+/// Solver grid stencil geometry tests
+#include <hm3/utility/test.hpp>
+#include <hm3/solver/state/grid.hpp>
+#include <hm3/solver/state/stencil_geometry.hpp>
+#include <hm3/grid/generation/uniform.hpp>
+
+using namespace hm3;
+
+using namespace grid;
+
+int main(int argc, char* argv[]) {
+  /// \name Setup
+  ///@{
+  /// Initialize MPI
+  mpi::env env(argc, argv);
+  auto comm = env.world();
+
+  /// Initialize I/O session
+  io::session::remove("state_stencil_geometry", comm);
+  io::session s(io::create, "state_stencil_geometry", comm);
+
+  /// Grid parameters
+  constexpr uint_t nd = 2;
+  auto max_grid_level = 4;
+  auto node_capacity
+   = tree_node_idx{tree::no_nodes_until_uniform_level(nd, max_grid_level)};
+  auto bounding_box = geometry::square<2>::unit();
+  auto no_grids     = 1;
+
+  /// Create the grid
+  grid::mhc<nd> g(s, node_capacity, no_grids, bounding_box);
+
+  /// Refine the grid up to level 3 (8x8 leaf nodes)
+  grid::generation::uniform(g, 3);
+  ///@}  // Setup
+
+  solver::state::grid<nd> gs(g, 0_g, *node_capacity);
+  RANGES_FOR (auto&& n, g.nodes() | g.leaf()) { gs.push(n); }
+
+  using geometry_t = solver::state::stencil_geometry<nd>;
+  geometry_t sg;
+  sg.build(gs);
+  // the cells at the domain boundary miss some neighbors:
+  CHECK(sg.structured().size() == 36_u);
+  CHECK(sg.unstructured().size() == 28_u);
+  CHECK(sg.row(sg.structured()[0]) == geometry_t::no_row);
+
+  auto check_rows = [&](geometry_t const& sg_) {
+    for (idx_t i = 0, e = sg_.unstructured().size(); i != e; ++i) {
+      const auto n = sg_.unstructured()[i];
+      CHECK(sg_.row(n) == i);
+      CHECK(distance(sg_.neighbors(i)) == distance(gs.neighbors(n)));
+      RANGES_FOR (auto&& p, view::zip(sg_.neighbors(i), sg_.distances(i))) {
+        geometry_t::vector_t dx
+         = gs.coordinates(std::get<0>(p)) - gs.coordinates(n);
+        CHECK(std::get<1>(p) == dx);
+      }
+    }
+  };
+  check_rows(sg);
+
+  // refining a cell in the middle makes it and its neighbors unstructured:
+  gs.enable_journal();
+  const auto m = gs.journal_marker();
+  grid_node_idx middle{};
+  RANGES_FOR (auto&& n, gs()) {
+    auto x = gs.coordinates(n);
+    if (x(0) > 0.375 and x(0) < 0.5 and x(1) > 0.375 and x(1) < 0.5) {
+      middle = n;
+      break;
+    }
+  }
+  CHECK(middle);
+  { auto b = gs.refine(std::vector<grid_node_idx>{middle}); }
+  sg.update(gs, gs.created_since(m));
+  check_rows(sg);
+  // 35 structured cells minus 8 neighbors, 28 boundary cells, 8 neighbors, and
+  // 4 children
+  CHECK(sg.structured().size() == 27_u);
+  CHECK(sg.unstructured().size() == 40_u);
+
+  geometry_t ref;
+  ref.build(gs);
+  CHECK(sg.structured() == ref.structured());
+  CHECK(sg.unstructured() == ref.unstructured());
+
+  // sorting the grid renumbers the cells:
+  gs.sort([&](std::vector<grid_node_idx> const& p) { sg.permute(p); });
+  check_rows(sg);
+  ref.build(gs);
+  CHECK(sg.structured() == ref.structured());
+  CHECK(sg.unstructured() == ref.unstructured());
+
+  std::vector<char> visited(*gs.capacity(), 0);
+  sg.for_each_structured([&](grid_node_idx n) { visited[*n] = 1; });
+  sg.for_each_unstructured([&](grid_node_idx n, auto&&, auto&&) {
+    visited[*n] = 2;
+  });
+  CHECK(ranges::count(visited, 1) == 27);
+  CHECK(ranges::count(visited, 2) == 40);
+
+  // coarsening the children again frees their grid nodes:
+  const auto m2 = gs.journal_marker();
+  std::vector<grid_node_idx> children;
+  RANGES_FOR (auto&& n, gs()) {
+    if (gs.level(n) == level_idx{4}) { children.push_back(n); }
+  }
+  CHECK(children.size() == 4_u);
+  { auto b = gs.coarsen(children); }
+  for (auto&& c : children) { CHECK(gs.is_free(c)); }
+  sg.update(gs, gs.created_since(m2));
+  check_rows(sg);
+  CHECK(sg.structured().size() == 36_u);
+  CHECK(sg.unstructured().size() == 28_u);
+  ref.build(gs);
+  CHECK(sg.structured() == ref.structured());
+  CHECK(sg.unstructured() == ref.unstructured());
+
+  return test::result();
+}
@@ -0,0 +1,153 @@
+/// \file
+///
+/// Solver grid data transfer tests
+#include <cmath>
+#include <vector>
+#include <hm3/utility/test.hpp>
+#include <hm3/solver/state/grid.hpp>
+#include <hm3/solver/state/transfer.hpp>
+#include <hm3/grid/generation/uniform.hpp>
+
+using namespace hm3;
+
+using namespace grid;
+
+int main(int argc, char* argv[]) {
+  /// \name Setup
+  ///@{
+  /// Initialize MPI
+  mpi::env env(argc, argv);
+  auto comm = env.world();
+
+  /// Initialize I/O session
+  io::session::remove("state_transfer", comm);
+  io::session s(io::create, "state_transfer", comm);
+
+  /// Grid parameters
+  constexpr uint_t nd = 2;
+  auto max_grid_level = 3;
+  auto node_capacity
+   = tree_node_idx{tree::no_nodes_until_uniform_level(nd, max_grid_level)};
+  auto bounding_box = geometry::square<2>::unit();
+  auto no_grids     = 2;
+
+  /// Create the grid
+  grid::mhc<nd> g(s, node_capacity, no_grids, bounding_box);
+
+  /// Refine the grid up to level 2 (4x4 leaf nodes)
+  grid::generation::uniform(g, 2);
+  ///@}  // Setup
+
+  using solver::state::transfer;
+
+  // the fine grid contains the 4x4 leaf nodes, the coarse grid the 2x2 nodes
+  // at level 1:
+  solver::state::grid<nd> fine(g, 0_g, *node_capacity);
+  solver::state::grid<nd> coarse(g, 1_g, *node_capacity);
+  RANGES_FOR (auto&& n, g.nodes()) {
+    if (g.is_leaf(n)) { fine.push(n); }
+    if (*g.level(n) == 1) { coarse.push(n); }
+  }
+  CHECK(fine.size() == 16_gn);
+  CHECK(coarse.size() == 4_gn);
+
+  transfer fine_to_coarse, coarse_to_fine;
+  fine_to_coarse.build(fine, coarse);
+  coarse_to_fine.build(coarse, fine);
+
+  CHECK(fine_to_coarse.size() == 4);
+  for (idx_t i = 0; i != fine_to_coarse.size(); ++i) {
+    CHECK(distance(fine_to_coarse.sources(i)) == 4);
+    for (auto&& w : fine_to_coarse.weights(i)) { CHECK(w == 0.25); }
+    CHECK(fine_to_coarse.coverage(i) == 1.);
+    const auto c = fine_to_coarse.targets()[i];
+    for (auto&& f : fine_to_coarse.sources(i)) {
+      CHECK(g.parent(fine.tree_node(f)) == coarse.tree_node(c));
+    }
+  }
+  CHECK(coarse_to_fine.size() == 16);
+  for (idx_t i = 0; i != coarse_to_fine.size(); ++i) {
+    CHECK(distance(coarse_to_fine.sources(i)) == 1);
+    CHECK(coarse_to_fine.weights(i)[0] == 1.);
+  }
+  CHECK(fine_to_coarse.row(grid_node_idx{3}) == 3);
+  CHECK(fine_to_coarse.row(grid_node_idx{4}) == transfer::no_row());
+
+  // the transfer is conservative:
+  std::vector<num_t> vf(*node_capacity), vc(*node_capacity);
+  RANGES_FOR (auto&& n, fine()) { vf[*n] = fine.coordinates(n)(0); }
+  auto fine_data   = [&](grid_node_idx n) -> num_t& { return vf[*n]; };
+  auto coarse_data = [&](grid_node_idx n) -> num_t& { return vc[*n]; };
+  fine_to_coarse.apply(fine_data, coarse_data);
+  num_t int_f = 0., int_c = 0.;
+  RANGES_FOR (auto&& n, fine()) { int_f += vf[*n] / 16.; }
+  RANGES_FOR (auto&& n, coarse()) {
+    int_c += vc[*n] / 4.;
+    CHECK(std::abs(vc[*n] - coarse.coordinates(n)(0)) < 1e-14);
+  }
+  CHECK(std::abs(int_f - int_c) < 1e-14);
+
+  coarse_to_fine.apply(coarse_data, fine_data);
+  RANGES_FOR (auto&& n, fine()) {
+    CHECK(vf[*n] == vc[*coarse.in_tree(g.parent(fine.tree_node(n)))]);
+  }
+
+  // incremental update after refining a fine cell:
+  auto check_rebuilt = [&](transfer const& t, auto const& src,
+                           auto const& dst) {
+    transfer r;
+    r.build(src, dst);
+    CHECK(t.targets_ == r.targets_);
+    CHECK(t.offsets_ == r.offsets_);
+    CHECK(t.sources_ == r.sources_);
+    CHECK(t.weights_ == r.weights_);
+  };
+
+  fine.enable_journal();
+  auto m = fine.journal_marker();
+  { auto b = fine.refine(std::vector<grid_node_idx>{grid_node_idx{5}}); }
+  CHECK(fine.size() == grid_node_idx{16 - 1 + 4});
+  fine_to_coarse.update(fine, coarse, fine.created_since(m),
+                        std::vector<grid_node_idx>{});
+  coarse_to_fine.update(coarse, fine, std::vector<grid_node_idx>{},
+                        fine.created_since(m));
+  check_rebuilt(fine_to_coarse, fine, coarse);
+  check_rebuilt(coarse_to_fine, coarse, fine);
+  idx_t no_finer = 0;
+  for (idx_t i = 0; i != fine_to_coarse.size(); ++i) {
+    CHECK(fine_to_coarse.coverage(i) == 1.);
+    for (auto&& w : fine_to_coarse.weights(i)) { no_finer += w == 0.0625; }
+  }
+  CHECK(no_finer == 4);
+
+  // sorting the fine grid:
+  fine.sort([&](std::vector<grid_node_idx> const& p) {
+    fine_to_coarse.permute_sources(p);
+    coarse_to_fine.permute_targets(p);
+  });
+  for (idx_t i = 0; i != fine_to_coarse.size(); ++i) {
+    for (auto&& f : fine_to_coarse.sources(i)) {
+      CHECK(fine.tree_node(f));
+    }
+  }
+  check_rebuilt(coarse_to_fine, coarse, fine);
+
+  // coarsening the refined fine cell frees the children:
+  const auto m2 = fine.journal_marker();
+  std::vector<grid_node_idx> children;
+  RANGES_FOR (auto&& n, fine()) {
+    if (fine.level(n) == level_idx{3}) { children.push_back(n); }
+  }
+  CHECK(children.size() == 4_u);
+  { auto b = fine.coarsen(children); }
+  for (auto&& c : children) { CHECK(fine.is_free(c)); }
+  fine_to_coarse.update(fine, coarse, fine.created_since(m2),
+                        std::vector<grid_node_idx>{});
+  coarse_to_fine.update(coarse, fine, std::vector<grid_node_idx>{},
+                        fine.created_since(m2));
+  check_rebuilt(fine_to_coarse, fine, coarse);
+  check_rebuilt(coarse_to_fine, coarse, fine);
+  CHECK(coarse_to_fine.size() == 16);
+
+  return test::result();
+}
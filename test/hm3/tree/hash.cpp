@@ -0,0 +1,73 @@
+/// \file
+///
+/// Tree sub-tree hashes tests
+#include "tree.hpp"
+
+using namespace hm3;
+using namespace test;
+
+int main() {
+  tree<2> a(29);
+  CHECK(!a.has_hashes());
+  a.enable_hashes();
+  CHECK(a.has_hashes());
+  CHECK(!a.has_payload_hashes());
+
+  tree<2> b(29);
+  b.enable_hashes();
+  CHECK(a.hash() == b.hash());
+  CHECK(a == b);
+
+  // refine updates the hashes along the path to the root:
+  a.refine(0_n);
+  CHECK(a.hash() != b.hash());
+  CHECK(a != b);
+  b.refine(0_n);
+  CHECK(a.hash() == b.hash());
+
+  // hashes are independent of the memory layout:
+  a.refine(1_n);
+  a.refine(4_n);
+  b.refine(4_n);
+  b.refine(1_n);
+  CHECK(a.hash() == b.hash());
+  CHECK(a.hash(1_n) == b.hash(1_n));
+  CHECK(a.hash(2_n) == b.hash(2_n));
+  dfs_sort(b);
+  CHECK(a.hash() == b.hash());
+  CHECK(a == b);
+
+  // recomputing the hashes gives the same result as updating them:
+  {
+    tree<2> c(b);
+    CHECK(c.has_hashes());
+    c.enable_hashes();
+    CHECK(c.hash() == b.hash());
+  }
+
+  // coarsen restores the previous hash:
+  const auto h = b.hash();
+  b.refine(2_n);
+  CHECK(b.hash() != h);
+  auto changes = diff(a, b);
+  CHECK(changes.size() == 1_z);
+  CHECK(changes[0].old_node == 2_n);
+  CHECK(changes[0].new_node == 2_n);
+  b.coarsen(2_n);
+  CHECK(b.hash() == h);
+  CHECK(diff(a, b).size() == 0_z);
+
+  // payload hashes:
+  b.set_payload_hash(3_n, 42);
+  CHECK(b.has_payload_hashes());
+  CHECK(b.payload_hash(3_n) == 42_u);
+  CHECK(b.hash() != a.hash());
+  changes = diff(a, b);
+  CHECK(changes.size() == 1_z);
+  CHECK(changes[0].new_node == 3_n);
+
+  // the structural equality ignores the payload:
+  CHECK(a == b);
+
+  return test::result();
+}
@@ -0,0 +1,112 @@
+/// \file
+///
+/// Trees with 32-bit node indices tests (see
+/// benchmark/hm3/tree/neighbor_sweep.cpp for the bandwidth benchmark)
+#include "tree.hpp"
+#include <cstdint>
+
+using namespace hm3;
+using namespace test;
+
+template <uint_t Nd, typename Idx>
+using tree_t = hm3::tree::tree<Nd, Idx>;
+
+/// Tree uniformly refined up to \p level (breadth-first order)
+template <uint_t Nd, typename Idx>
+tree_t<Nd, Idx> uniform_tree(uint_t level) {
+  tree_t<Nd, Idx> t(no_nodes_until_uniform_level(Nd, level));
+  RANGES_FOR (auto&& n, t.nodes() | t.leaf()) {
+    if (node_level(t, n) < level) { t.refine(n); }
+  }
+  return t;
+}
+
+/// Do the trees \p a and \p b have the same parent-child graph?
+template <typename TreeA, typename TreeB>
+bool same_graph(TreeA const& a, TreeB const& b) {
+  if (a.size() != b.size()) { return false; }
+  RANGES_FOR (auto&& np, view::zip(a.nodes(), b.nodes())) {
+    auto&& an = get<0>(np);
+    auto&& bn = get<1>(np);
+    if (an != bn or a.parent(an) != b.parent(bn)) { return false; }
+    if (!equal(a.children(an), b.children(bn))) { return false; }
+  }
+  return true;
+}
+
+/// Checksum of the neighbor indices of all nodes of the tree \p t
+template <typename Tree> idx_t neighbor_checksum(Tree const& t) {
+  idx_t checksum = 0;
+  RANGES_FOR (auto&& n, t.nodes()) {
+    for (auto&& m : node_neighbors(t, n)) { checksum += *m; }
+  }
+  return checksum;
+}
+
+/// Memory footprint of the tree \p t in bytes
+template <typename Tree> uint_t memory(Tree const& t) {
+  using stored_t = typename Tree::stored_node_idx;
+  return sizeof(stored_t) * (*t.capacity() + *t.sibling_group_capacity());
+}
+
+int main() {
+  using t64 = tree_t<3, idx_t>;
+  using t32 = tree_t<3, std::uint32_t>;
+  static_assert(sizeof(t32::stored_node_idx) == 4, "");
+  static_assert(sizeof(t64::stored_node_idx) == 8, "");
+
+  {  // construction, refine, coarsen
+    auto a = uniform_tree<3, idx_t>(2);
+    auto b = uniform_tree<3, std::uint32_t>(2);
+    CHECK(same_graph(a, b));
+    CHECK(memory(b) * 2 == memory(a));
+
+    a.coarsen(9_n);
+    b.coarsen(9_n);
+    CHECK(same_graph(a, b));
+    CHECK(!b.is_compact());
+    dfs_sort(a);
+    dfs_sort(b);
+    CHECK(same_graph(a, b));
+    CHECK(dfs_sort.is(b));
+
+    // copies
+    t32 c(b);
+    CHECK(c == b);
+  }
+
+  {  // set operations
+    auto a = uniform_tree<3, std::uint32_t>(2);
+    auto b = uniform_tree<3, std::uint32_t>(3);
+    dfs_sort(b);
+    CHECK(tree_union(a, b) == b);
+    CHECK(tree_intersection(a, b).size() == a.size());
+  }
+
+  {  // file i/o with width conversion
+    auto a = uniform_tree<3, std::uint32_t>(3);
+    dfs_sort(a);
+    auto b = check_io(a, "index_width_32");
+    CHECK(same_graph(a, b));
+
+    // read the 32-bit tree into a 64-bit tree:
+    auto file_name = "index_width_32_to_64";
+    auto comm      = mpi::comm::world();
+    io::session::remove(file_name, comm);
+    grid::to_file(a, file_name);
+    auto c = grid::from_file(t64{}, file_name);
+    CHECK(same_graph(a, c));
+  }
+
+  {  // neighbors and memory footprint
+    const uint_t level = 3;
+    auto a = uniform_tree<3, idx_t>(level);
+    auto b = uniform_tree<3, std::uint32_t>(level);
+    dfs_sort(a);
+    dfs_sort(b);
+    CHECK(neighbor_checksum(a) == neighbor_checksum(b));
+    CHECK(memory(b) * 2 == memory(a));
+  }
+
+  return test::result();
+}
@@ -89,6 +89,15 @@ void test_location(Loc) {
         std::cout << "  after shift (" << d << "): " << as << std::endl;
 #endif
         CHECK(!as);
+
+        // periodic shifts wrap around:
+        std::array<bool, Nd> periodic{};
+        periodic[d] = true;
+        auto ps     = shift(b, offset, periodic);
+        CHECK(ps);
+        using loc_int = loc_int_t<Loc>;
+        CHECK(static_cast<std::array<loc_int, Nd>>(*ps)[d]
+              == bit::max_value(*b.level()));
       }
 #ifdef HM3_TEST_DEBUG_OUTPUT
       std::cout << "[min end] Nd: " << Nd << " max_lvl: " << a.max_level()
@@ -133,6 +142,14 @@ void test_location(Loc) {
         std::cout << "  after shift (" << d << "): " << as << std::endl;
 #endif
         CHECK(!as);
+
+        // periodic shifts wrap around:
+        std::array<bool, Nd> periodic{};
+        periodic[d] = true;
+        auto ps     = shift(b, offset, periodic);
+        CHECK(ps);
+        using loc_int = loc_int_t<Loc>;
+        CHECK(static_cast<std::array<loc_int, Nd>>(*ps)[d] == 0_u);
       }
 #ifdef HM3_TEST_DEBUG_OUTPUT
       std::cout << "[max end] Nd: " << Nd << " max_lvl: " << a.max_level()
@@ -208,6 +225,28 @@ template <template <hm3::uint_t, class...> class Loc> void test_location_2() {
     CHECK(ar[1] == 2_u);
     CHECK(a == Loc<2>({2, 0}));
   }
+  {  // periodic shifts across faces, edges, and corners
+    using loc_int = loc_int_t<Loc<2>>;
+    const auto a  = Loc<2>({0, 0});  // (0, 0) at level 2
+    std::array<bool, 2> x_periodic{{true, false}};
+    std::array<bool, 2> periodic{{true, true}};
+
+    auto k = shift(a, std::array<int_t, 2>{{-1, 0}}, x_periodic);
+    CHECK(k);
+    auto ar = static_cast<std::array<loc_int, 2>>(*k);
+    CHECK(ar[0] == 3_u);
+    CHECK(ar[1] == 0_u);
+
+    CHECK(!shift(a, std::array<int_t, 2>{{-1, -1}}, x_periodic));
+    CHECK(!shift(a, std::array<int_t, 2>{{0, -1}}, x_periodic));
+
+    k = shift(a, std::array<int_t, 2>{{-1, -1}}, periodic);
+    CHECK(k);
+    ar = static_cast<std::array<loc_int, 2>>(*k);
+    CHECK(ar[0] == 3_u);
+    CHECK(ar[1] == 3_u);
+    CHECK((*k).level() == 2_u);
+  }
   {  // test to_int coordinate-wise
     auto a        = Loc<2>({3, 0, 0});
     using loc_int = loc_int_t<Loc<2>>;
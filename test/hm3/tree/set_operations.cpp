@@ -0,0 +1,95 @@
+/// \file
+///
+/// Tree set operations tests
+#include "tree.hpp"
+
+using namespace hm3;
+using namespace test;
+
+int main() {
+  // a: root and node 1 refined
+  tree<2> a(13);
+  a.refine(0_n);
+  a.refine(1_n);
+
+  // b: root and node 4 refined
+  tree<2> b(13);
+  b.refine(0_n);
+  b.refine(4_n);
+
+  {  // union: root, node 1, and node 4 refined
+    tree<2> ref(13);
+    ref.refine(0_n);
+    ref.refine(1_n);
+    ref.refine(4_n);
+
+    std::vector<node_idx> to_a(13), to_b(13);
+    auto u = tree_union(a, b, [&](node_idx o, node_idx na, node_idx nb) {
+      to_a[*o] = na;
+      to_b[*o] = nb;
+    });
+    CHECK(u.size() == 13_n);
+    CHECK(u == ref);
+    CHECK(u.is_compact());
+    CHECK(dfs_sort.is(u));
+    check_is_balanced(u);
+
+    CHECK(to_a[0] == 0_n);
+    CHECK(to_b[0] == 0_n);
+    // children of node 1 are only in a
+    for (auto&& c : u.children(1_n)) {
+      CHECK(to_a[*c]);
+      CHECK(!to_b[*c]);
+    }
+    // children of node 4 are only in b
+    for (auto&& c : u.children(4_n)) {
+      CHECK(!to_a[*c]);
+      CHECK(to_b[*c]);
+    }
+
+    // union is commutative
+    CHECK(tree_union(b, a) == ref);
+    // union with itself is the identity
+    CHECK(tree_union(a, a) == a);
+  }
+
+  {  // intersection: only the root is refined
+    tree<2> ref(5);
+    ref.refine(0_n);
+    auto i = tree_intersection(a, b);
+    CHECK(i.size() == 5_n);
+    CHECK(i == ref);
+    CHECK(tree_intersection(b, a) == ref);
+    CHECK(tree_intersection(a, a) == a);
+  }
+
+  {  // difference: refinement of a where a is finer than b
+    auto d = tree_difference(a, b);
+    CHECK(d == a);
+    CHECK(tree_difference(b, a) == b);
+
+    // difference with itself is the root node only
+    auto e = tree_difference(a, a);
+    CHECK(e.size() == 1_n);
+    CHECK(e.is_leaf(0_n));
+  }
+
+  {  // uniform trees
+    auto u2 = uniformly_refined_tree<3>(2, 2);
+    auto u3 = uniformly_refined_tree<3>(3, 3);
+    // the output trees are depth-first sorted:
+    dfs_sort(u3);
+    CHECK(tree_union(u2, u3) == u3);
+    CHECK(tree_intersection(u2, u3) == u2);
+    CHECK(tree_difference(u3, u2) == u3);
+    CHECK(tree_difference(u2, u3).size() == 1_n);
+
+    // minimum capacity is respected
+    auto c = tree_union(u2, u2, set_operations_detail::ignore_nodes_fn{},
+                        node_idx{*u3.capacity()});
+    CHECK(c.capacity() == u3.capacity());
+    CHECK(c == u2);
+  }
+
+  return test::result();
+}
@@ -0,0 +1,70 @@
+/// \file
+///
+/// Tree structure statistics tests
+#include "tree.hpp"
+
+using namespace hm3;
+using namespace test;
+
+int main() {
+  {  // uniform tree: counts per level, compact, no violations
+    auto t = uniformly_refined_tree<2>(2, 2);
+    auto s = stats(t);
+    CHECK(s.dimension == 2_u);
+    CHECK(s.no_nodes == 21);
+    CHECK(s.no_leaf_nodes == 16);
+    CHECK(s.no_nodes_per_level == std::vector<idx_t>{1, 4, 16});
+    CHECK(s.no_leaf_nodes_per_level == std::vector<idx_t>{0, 0, 16});
+    CHECK(s.no_sibling_groups == 6);
+    CHECK(s.no_holes() == 0);
+    CHECK(s.no_hole_runs == 0);
+    CHECK(s.density() == 1.);
+    CHECK(s.no_parent_child_pairs == 20);
+    CHECK(s.no_2to1_violations == 0);
+    CHECK(s.memory_used() > 0_u);
+    CHECK(s.memory_used() <= s.memory_reserved());
+  }
+
+  {  // coarsening leaves holes that dfs_sort removes
+    auto t = uniformly_refined_tree<2>(2, 2);
+    t.coarsen(1_n);
+    auto s = stats(t);
+    CHECK(s.no_nodes == 17);
+    CHECK(s.no_holes() == 1);
+    CHECK(s.no_hole_runs == 1);
+    CHECK(s.density() < 1.);
+    idx_t no_free = 0;
+    for (auto&& b : s.free_sibling_groups_per_bin) { no_free += b; }
+    CHECK(no_free == s.sibling_group_capacity - s.no_sibling_groups);
+
+    dfs_sort(t);
+    s = stats(t);
+    CHECK(s.no_holes() == 0);
+    CHECK(s.density() == 1.);
+  }
+
+  {  // 2:1 violations
+    // root, node 1 and node 6 (child of 1 sharing a face with node 2) refined
+    tree<2> t(13);
+    t.refine(0_n);
+    t.refine(1_n);
+    t.refine(6_n);
+    auto s = stats(t);
+    CHECK(s.no_nodes_per_level == std::vector<idx_t>{1, 4, 4, 4});
+    CHECK(s.no_2to1_violations > 0);
+
+    auto u = uniformly_refined_tree<2>(2, 2);
+    CHECK(stats(u).no_2to1_violations == 0);
+  }
+
+  {  // json
+    auto j = to_json(stats(uniformly_refined_tree<3>(1, 1)));
+    CHECK(j["no_nodes"] == 9);
+    CHECK(j["sibling_groups"]["no_in_use"] == 2);
+    CHECK(j["memory"].count("parents") == 1_u);
+    CHECK(j["memory"].count("first_children") == 1_u);
+    CHECK(j["memory"].count("total") == 1_u);
+  }
+
+  return test::result();
+}
@@ -0,0 +1,49 @@
+/// \file
+///
+/// Direct uniform tree construction tests
+#include "tree.hpp"
+
+using namespace hm3;
+using namespace test;
+
+template <uint_t Nd> void test_uniform(uint_t level) {
+  tree<Nd> a(no_nodes_until_uniform_level(Nd, level + 1));
+  a.refine_uniformly(level_idx{static_cast<suint_t>(level)});
+  CHECK(size(a) == no_nodes_until_uniform_level(Nd, level));
+  CHECK(a.is_compact());
+  CHECK(dfs_sort.is(a));
+  RANGES_FOR (auto&& n, a.nodes() | a.leaf()) {
+    CHECK(node_level(a, n) == level);
+  }
+
+  // same tree as refining the nodes one by one and sorting:
+  auto b = uniformly_refined_tree<Nd>(level, level + 1);
+  dfs_sort(b);
+  CHECK(a == b);
+
+  // the tree can be refined and coarsened further:
+  if (level > 0) {
+    const node_idx n{*a.size() - 1};
+    CHECK(a.is_leaf(n));
+    a.refine(n);
+    CHECK(size(a) == no_nodes_until_uniform_level(Nd, level) + a.no_children());
+    a.coarsen(n);
+    CHECK(a == b);
+  }
+
+  // hashes are computed:
+  tree<Nd> h(no_nodes_until_uniform_level(Nd, level));
+  h.enable_hashes();
+  h.refine_uniformly(level_idx{static_cast<suint_t>(level)});
+  b.enable_hashes();
+  CHECK(h.hash() == b.hash());
+}
+
+int main() {
+  for (uint_t l = 0; l != 6; ++l) {
+    test_uniform<1>(l);
+    test_uniform<2>(l);
+  }
+  for (uint_t l = 0; l != 4; ++l) { test_uniform<3>(l); }
+  return test::result();
+}
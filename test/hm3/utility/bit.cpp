@@ -153,5 +153,12 @@ int main() {
     check_overflows_on_add<unsigned int, unsigned int>();
     check_overflows_on_add<unsigned int, int>();
   }
+
+  {  // check popcount
+    CHECK(bit::popcount(0) == 0_u);
+    CHECK(bit::popcount(1) == 1_u);
+    CHECK(bit::popcount(0b1011) == 3_u);
+    CHECK(bit::popcount(~uint64_t{0}) == 64_u);
+  }
   return test::result();
 }
@@ -0,0 +1,38 @@
+#include <hm3/utility/test.hpp>
+#include <hm3/types.hpp>
+#include <hm3/utility/radix_sort.hpp>
+#include <random>
+
+using namespace hm3;
+
+int main() {
+  std::mt19937_64 gen(42);
+  for (auto&& n : {0, 1, 2, 17, 1000, 100000}) {
+    std::vector<std::uint64_t> keys(n);
+    std::vector<idx_t> values(n);
+    for (int i = 0; i != n; ++i) {
+      keys[i]   = gen() >> 4;  // 60 bits
+      values[i] = i;
+    }
+    // some duplicated keys to check stability:
+    for (int i = 1; i < n; i += 3) { keys[i] = keys[i - 1]; }
+    auto ref = keys;
+
+    parallel::radix_sort(keys, values, 60);
+    CHECK(std::is_sorted(begin(keys), end(keys)));
+    for (int i = 0; i != n; ++i) { CHECK(ref[values[i]] == keys[i]); }
+    for (int i = 1; i < n; ++i) {
+      if (keys[i] == keys[i - 1]) { CHECK(values[i - 1] < values[i]); }
+    }
+  }
+
+  {  // keys that only differ in some digits
+    std::vector<std::uint32_t> keys{0x300, 0x100, 0x200, 0x100};
+    std::vector<int> values{0, 1, 2, 3};
+    parallel::radix_sort(keys, values);
+    CHECK(keys == (std::vector<std::uint32_t>{0x100, 0x100, 0x200, 0x300}));
+    CHECK(values == (std::vector<int>{1, 3, 2, 0}));
+  }
+
+  return test::result();
+}